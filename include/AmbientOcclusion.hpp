@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Per-voxel visibility baked from occupancy: every solid voxel stores the
+// fraction of empty cells in the (2 * radius + 1)^3 cube around it, so
+// creases and cavities come out darker than open faces. Baked in 32^3 tiles
+// with separable box sums; an edit only re-bakes the tiles within radius.
+class AmbientOcclusion {
+  public:
+    static constexpr int radius = 2;
+    static constexpr int tileSize = 32;
+
+  private:
+    glm::ivec3 size = {0, 0, 0};
+    std::vector<uint8_t> values; // 0 fully occluded .. 255 fully open
+
+    void BakeTile(const std::vector<float>& voxels, const glm::ivec3& tile);
+    void BakeTiles(const std::vector<float>& voxels, const glm::ivec3& min,
+                   const glm::ivec3& max);
+
+  public:
+    AmbientOcclusion();
+    ~AmbientOcclusion();
+
+    void Build(const std::vector<float>& voxels, const glm::ivec3& size);
+    // Re-bakes every voxel whose neighborhood overlaps [min, max)
+    void Update(const std::vector<float>& voxels, const glm::ivec3& min,
+                const glm::ivec3& max);
+
+    inline const std::vector<uint8_t>& getValues() const { return values; }
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "UploadScheduler.hpp"
+#include "VoxelIndex.hpp"
+#include <bgfx/bgfx.h>
+#include <cstdint>
+#include <deque>
+#include <glm/glm.hpp>
+#include <vector>
+
+// GPU representation of the volume as 8^3 bricks. A page table texture maps
+// every brick to a slot in a fixed-size atlas texture. Only non-empty bricks
+// get a slot, so VRAM scales with occupancy instead of the grid extent. When
+// there are more occupied bricks than slots, the ones closest to the viewer
+// stay resident and the rest fall back to the LOD chain in the shader.
+// Brick data is streamed through the UploadScheduler; a brick only turns
+// Resident in the page table once its slot has actually been uploaded. The
+// baked ambient occlusion shares the slot layout in a second R8 atlas.
+// Voxels are packed to R8 or R16 palette indices, per the index format.
+class BrickAtlas {
+  public:
+    static constexpr int brickSize = 8;
+    enum PageState : uint8_t { Empty = 0, NonResident = 1, Resident = 2 };
+
+  private:
+    glm::ivec3 gridSize = {0, 0, 0};
+    glm::ivec3 brickGrid = {0, 0, 0};
+    int slotsPerAxis = 32;
+    IndexFormat indexFormat = IndexFormat::U8;
+
+    std::vector<uint8_t> occupied;   // per brick
+    std::vector<int32_t> brickSlot;  // per brick, -1 when not resident
+    std::vector<int32_t> slotBrick;  // per slot, -1 when free
+    std::vector<int32_t> freeSlots;  // stack of free slot indices
+    std::vector<uint32_t> pageTable; // per brick, RGBA8: slot xyz + state
+    std::deque<int32_t> pendingBricks; // resident bricks awaiting upload
+    std::vector<uint8_t> queued;       // per brick, in pendingBricks
+
+    // Page table region changed since the last Flush(), [min, max)
+    glm::ivec3 pageDirtyMin = {0, 0, 0};
+    glm::ivec3 pageDirtyMax = {0, 0, 0};
+    bool pagesDirty = false;
+
+    glm::vec3 viewer = {0.0f, 0.0f, 0.0f}; // in voxels
+    glm::vec3 residencyViewer = {0.0f, 0.0f, 0.0f};
+    bool oversubscribed = false;
+    bool residencyDirty = false;
+
+    bgfx::TextureHandle atlasTexture = {bgfx::kInvalidHandle};
+    bgfx::TextureHandle occlusionTexture = {bgfx::kInvalidHandle};
+    bgfx::TextureHandle pageTexture = {bgfx::kInvalidHandle};
+    bgfx::UniformHandle s_pageTable = {bgfx::kInvalidHandle};
+    bgfx::UniformHandle s_occlusionTexture = {bgfx::kInvalidHandle};
+
+    inline size_t BrickIndex(const glm::ivec3& brick) const {
+        return (size_t(brick.z) * brickGrid.y + brick.y) * brickGrid.x +
+               brick.x;
+    }
+    inline glm::ivec3 BrickCoord(size_t index) const {
+        return glm::ivec3(index % brickGrid.x,
+                          (index / brickGrid.x) % brickGrid.y,
+                          index / (size_t(brickGrid.x) * brickGrid.y));
+    }
+    bool ScanBrick(const std::vector<float>& voxels,
+                   const glm::ivec3& brick) const;
+    bool MakeResident(size_t brick);
+    void Evict(size_t brick);
+    void QueueBrick(size_t brick);
+    // Copies a brick of source into the slot, packing floats to indices
+    template <typename T, typename S>
+    void UploadBrick(bgfx::TextureHandle texture, const std::vector<S>& source,
+                     size_t brick, const bgfx::Memory* mem);
+    void CreateAtlasTexture();
+    void MarkPages(const glm::ivec3& min, const glm::ivec3& max);
+    void UploadPages();
+    void SetPage(size_t brick, PageState state);
+
+  public:
+    BrickAtlas();
+    ~BrickAtlas();
+
+    void Init(int slotsPerAxis = 32);
+    void Destroy();
+    // Recreates the atlas texture, Build() has to follow to refill it
+    void setIndexFormat(IndexFormat format);
+
+    void Build(const std::vector<float>& voxels, const glm::ivec3& size);
+    // Re-evaluates the bricks overlapping [min, max) after an edit
+    void Update(const std::vector<float>& voxels, const glm::ivec3& min,
+                const glm::ivec3& max);
+    // Swaps bricks in and out by distance once the viewer moved enough
+    void UpdateResidency();
+    // Uploads queued bricks within the scheduler's budget, then the page
+    // table entries that changed
+    void Flush(const std::vector<float>& voxels,
+               const std::vector<uint8_t>& occlusion,
+               UploadScheduler& scheduler);
+
+    inline void setViewer(const glm::vec3& voxelPos) { viewer = voxelPos; }
+    PageState getPageState(const glm::ivec3& brick) const;
+
+    inline int getSlotCount() const {
+        return slotsPerAxis * slotsPerAxis * slotsPerAxis;
+    }
+    inline int getResidentCount() const {
+        return getSlotCount() - static_cast<int>(freeSlots.size());
+    }
+    inline size_t getPendingCount() const { return pendingBricks.size(); }
+    inline const glm::ivec3& getBrickGrid() const { return brickGrid; }
+    inline int getAtlasSize() const { return slotsPerAxis * brickSize; }
+    inline bgfx::TextureHandle& getAtlasTexture() { return atlasTexture; }
+    inline bgfx::TextureHandle& getOcclusionTexture() {
+        return occlusionTexture;
+    }
+    inline bgfx::TextureHandle& getPageTexture() { return pageTexture; }
+    inline bgfx::UniformHandle& getPageTableUniform() { return s_pageTable; }
+    inline bgfx::UniformHandle& getOcclusionUniform() {
+        return s_occlusionTexture;
+    }
+};
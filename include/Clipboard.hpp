@@ -0,0 +1,53 @@
+#pragma once
+
+#include "SelectionMask.hpp"
+#include "VoxelManager.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Copied region stored as run-length encoded 8^3 bricks. Bricks without a
+// solid voxel are dropped and empty voxels are transparent on paste, so a
+// sparse or masked copy costs a fraction of the dense float box.
+class Clipboard {
+  public:
+    static constexpr int brickSize = 8;
+
+  private:
+    struct Run {
+        uint16_t length;
+        uint16_t value; // palette index, 0 is empty
+    };
+    struct Brick {
+        glm::ivec3 offset; // first voxel, relative to the region
+        uint32_t firstRun;
+        uint32_t runCount;
+    };
+
+    glm::ivec3 size = {0, 0, 0};
+    std::vector<Brick> bricks;
+    std::vector<Run> runs;
+    uint64_t voxelCount = 0;
+
+  public:
+    Clipboard();
+    ~Clipboard();
+
+    // Copies the voxels of [min, max), restricted to selection if given
+    void Copy(const std::vector<float>& voxels, const glm::ivec3& volumeSize,
+              const glm::ivec3& min, const glm::ivec3& max,
+              const SelectionMask* selection = nullptr);
+    // Writes the solid voxels with the region's corner at origin, as one
+    // edit of the voxel manager
+    void Paste(VoxelManager& voxelManager, const glm::ivec3& origin) const;
+    // Dense palette indices of the whole region, x fastest
+    void Decode(std::vector<uint16_t>& values) const;
+    void Clear();
+
+    inline bool isEmpty() const { return voxelCount == 0; }
+    inline const glm::ivec3& getSize() const { return size; }
+    inline uint64_t getVoxelCount() const { return voxelCount; }
+    inline size_t getByteSize() const {
+        return bricks.size() * sizeof(Brick) + runs.size() * sizeof(Run);
+    }
+};
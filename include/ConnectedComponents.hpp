@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Labels the 6-connected islands of solid voxels. Tiles of 32^3 are joined
+// in parallel with a lock-free union-find, then the tile borders are merged
+// and the roots compacted to labels 1..N; 0 marks empty voxels. The result
+// is cached against the voxel revision it was computed for.
+class ConnectedComponents {
+  public:
+    static constexpr int tileSize = 32;
+
+  private:
+    glm::ivec3 size = {0, 0, 0};
+    std::vector<uint32_t> labels;
+    std::vector<uint32_t> sizes; // voxel count per label, [0] unused
+    uint32_t largest = 0;
+    uint64_t revision = ~0ull;
+
+  public:
+    ConnectedComponents();
+    ~ConnectedComponents();
+
+    // Does nothing when the labels are already up to date for revision
+    void Label(const std::vector<float>& voxels, const glm::ivec3& size,
+               uint64_t revision);
+
+    uint32_t getLabel(const glm::ivec3& voxel) const;
+    inline const std::vector<uint32_t>& getLabels() const { return labels; }
+    inline const std::vector<uint32_t>& getSizes() const { return sizes; }
+    inline uint32_t getComponentCount() const {
+        return sizes.empty() ? 0 : static_cast<uint32_t>(sizes.size() - 1);
+    }
+    // Label of the component with the most voxels, 0 if there is none
+    inline uint32_t getLargest() const { return largest; }
+};
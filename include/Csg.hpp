@@ -0,0 +1,79 @@
+#pragma once
+
+#include "PaletteManager.hpp"
+#include "VoxelManager.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Boolean operations between the volume and an operand: a sphere, a
+// cylinder, a box, or a second volume read from a .nuum at an offset. The
+// grid is walked in bricks; a brick the operand misses, or one it covers
+// whole where that cannot change anything, is skipped before its voxels
+// are read. The remaining bricks run in parallel and the result goes in as
+// one edit: one usage delta per brick and a single dirty region.
+class Csg {
+  public:
+    enum class Op { Union, Subtract, Intersect };
+    enum class Operand { Sphere, Cylinder, Box, Volume };
+
+    static constexpr int brickSize = 16;
+
+  private:
+    // Where a brick lies against the operand
+    enum class Cover { Outside, Partial, Inside };
+
+    Op op = Op::Subtract;
+    Operand operand = Operand::Sphere;
+    glm::vec3 center = {32.0f, 32.0f, 32.0f}; // sphere and cylinder
+    float radius = 16.0f;
+    float height = 32.0f; // cylinder, along axis
+    int axis = 1;
+    glm::ivec3 boxMin = {0, 0, 0};
+    glm::ivec3 boxMax = {32, 32, 32};
+
+    // Second volume as stored in its file, matched to the current palette
+    // when applied. volumeBricks flags its bricks holding solid voxels.
+    std::string volumeName;
+    glm::ivec3 volumeSize = {0, 0, 0};
+    glm::ivec3 volumeBrickGrid = {0, 0, 0};
+    glm::ivec3 offset = {0, 0, 0};
+    std::vector<float> volume;
+    std::vector<glm::vec4> volumeColors;
+    std::vector<uint8_t> volumeBricks;
+    bool volumeRequested = false;
+
+    long long lastMilliseconds = -1;
+    uint64_t lastChanged = 0;
+
+    // Voxels [min, max) the operand can cover
+    void OperandBounds(glm::ivec3& min, glm::ivec3& max) const;
+    Cover Classify(const glm::ivec3& min, const glm::ivec3& max) const;
+    // Operand values for x in [x0, x0 + count), 0 outside of it; shapes
+    // are filled with value
+    void OperandRow(int x0, int y, int z, int count, float value,
+                    const std::vector<float>& remap, float* out) const;
+
+  public:
+    Csg();
+    ~Csg();
+
+    // Takes a volume read from a .nuum file, colors without the empty one
+    void SetVolume(std::string name, const glm::ivec3& size,
+                   std::vector<float>&& voxels,
+                   std::vector<glm::vec4>&& colors);
+    // Returns the number of voxels changed
+    uint64_t Apply(VoxelManager& voxelManager, PaletteManager& paletteManager);
+
+    // True once after the open button was pressed, the caller then picks
+    // and reads the file
+    inline bool TakeVolumeRequest() {
+        const bool requested = volumeRequested;
+        volumeRequested = false;
+        return requested;
+    }
+
+    void RenderWindow(bool* open, VoxelManager& voxelManager,
+                      PaletteManager& paletteManager);
+};
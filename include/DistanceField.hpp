@@ -0,0 +1,71 @@
+#pragma once
+
+#include "UploadScheduler.hpp"
+#include <bgfx/bgfx.h>
+#include <cstdint>
+#include <deque>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Signed Euclidean distance from every cell to the nearest surface:
+// positive outside (to the nearest solid voxel), negative inside (to the
+// nearest empty one), clamped to +-maxDistance and stored in fixed point,
+// stepsPerVoxel per voxel. Built with a separable exact distance transform,
+// one parallel pass per axis. The clamp bounds how far an edit can reach,
+// so updates stay local.
+//
+// The field only exists while sphere tracing is enabled; its GPU copy holds
+// the outside distance as R8 and lets the ray shader leap through empty
+// space. Grids larger than maxTextureEdge are stored coarser, a texel
+// keeping the least distance of its voxels.
+class DistanceField {
+  public:
+    static constexpr int maxDistance = 16;
+    static constexpr int stepsPerVoxel = 4;
+    static constexpr int maxTextureEdge = 256;
+
+  private:
+    struct Slice {
+        glm::ivec3 min, max;
+    };
+
+    glm::ivec3 size = {0, 0, 0};
+    std::vector<int8_t> distances;
+
+    bool gpuEnabled = false;
+    bool textureReady = false; // no slice waits for its upload
+    int textureScale = 1;      // voxels per texel along each axis
+    glm::ivec3 textureSize = {0, 0, 0};
+    bgfx::TextureHandle textureHandle = {bgfx::kInvalidHandle};
+    bgfx::UniformHandle s_distanceTexture = {bgfx::kInvalidHandle};
+    std::deque<Slice> pendingSlices;
+
+    void Transform(const std::vector<float>& voxels,
+                   const glm::ivec3& windowMin, const glm::ivec3& windowMax,
+                   const glm::ivec3& regionMin, const glm::ivec3& regionMax);
+    void CreateTexture();
+    void QueueUpload(const glm::ivec3& min, const glm::ivec3& max);
+
+  public:
+    DistanceField();
+    ~DistanceField();
+
+    void Init();
+    void Destroy();
+
+    // Both do nothing while disabled, enabling builds the field afresh
+    void Build(const std::vector<float>& voxels, const glm::ivec3& size);
+    // Recomputes the cells within maxDistance of [min, max)
+    void Update(const std::vector<float>& voxels, const glm::ivec3& min,
+                const glm::ivec3& max);
+    void Flush(UploadScheduler& scheduler);
+
+    void setGpuEnabled(bool enabled, const std::vector<float>& voxels);
+    inline bool isGpuEnabled() const { return gpuEnabled; }
+    inline bool isTextureReady() const { return textureReady; }
+    inline int getTextureScale() const { return textureScale; }
+    inline bgfx::TextureHandle& getTextureHandle() { return textureHandle; }
+    inline bgfx::UniformHandle& getTextureUniform() {
+        return s_distanceTexture;
+    }
+};
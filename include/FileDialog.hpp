@@ -26,6 +26,7 @@ class FileDialog {
     int OpenFileDialog(std::string& outPath,
                        const nfdu8filteritem_t* filter = nullptr,
                        const size_t filterCount = 0);
+    int PickFolderDialog(std::string& outPath);
     int SaveFileDialog(std::string& outPath, const std::string& defaultName = "Untitled.nuum",
                        const nfdu8filteritem_t* filter = nullptr,
                        const size_t filterCount = 0);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "PaletteManager.hpp"
+#include "VoxelManager.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Fills the volume, or a region of it, from parametric shapes: fBm noise
+// terrain and caves, and primitives fitted to the region. Bricks run in
+// parallel; inside a brick every x row is evaluated as a whole through
+// branch-free loops the compiler vectorizes, then written in one pass.
+class Generator {
+  public:
+    enum class Shape { Terrain, Caves, Box, Sphere, Cylinder, Torus };
+    enum class Noise { Perlin, Simplex };
+    // Fill only adds, Replace also empties the region outside the shape,
+    // Carve empties the inside
+    enum class Mode { Fill, Replace, Carve };
+    enum class Region { Volume, Selection, Custom };
+
+    static constexpr int brickSize = 32;
+
+  private:
+    Shape shape = Shape::Terrain;
+    Noise noise = Noise::Simplex;
+    Mode mode = Mode::Replace;
+    Region region = Region::Volume;
+    glm::ivec3 customMin = {0, 0, 0};
+    glm::ivec3 customMax = {64, 64, 64};
+
+    int seed = 1337;
+    float featureSize = 96.0f; // voxels per period of the first octave
+    int octaves = 5;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    float baseHeight = 0.35f; // terrain, fractions of the region height
+    float amplitude = 0.4f;
+    float caveThreshold = 0.2f;
+    float tubeRadius = 0.3f; // torus, fraction of the region half width
+
+    // Palette colors stacked bottom to top, else the selected color
+    bool banding = true;
+    int bandFirst = 1;
+    int bandCount = 4;
+
+    long long lastMilliseconds = -1;
+
+    // [min, max) the shape is fitted to, false when it is empty
+    bool RegionBounds(VoxelManager& voxelManager, glm::ivec3& min,
+                      glm::ivec3& max) const;
+    // fBm of the chosen noise for x in [x0, x0 + count), one row at a time
+    void FbmRow(float x0, float y, float z, int count, float* out) const;
+
+  public:
+    Generator();
+    ~Generator();
+
+    // Returns 1 if the region is empty
+    int Generate(VoxelManager& voxelManager, PaletteManager& paletteManager);
+
+    void RenderWindow(bool* open, VoxelManager& voxelManager,
+                      PaletteManager& paletteManager);
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "PaletteManager.hpp"
+#include "VoxelManager.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Builds volumes from images decoded with bimg: a folder of slices stacked
+// as Z layers, or a heightmap raised into columns along Y. Images are
+// decoded on all threads and written straight into the new voxel store,
+// colors are matched to the nearest entry of the current palette.
+class ImageImporter {
+  public:
+    static constexpr int maxSize = 2048;
+
+  private:
+    struct Image {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<glm::u8vec4> pixels; // rows top to bottom
+    };
+
+    // Slice pixels darker than this, or mostly transparent, stay empty
+    int threshold = 1;
+    // Voxels a white heightmap pixel rises to
+    int heightScale = 64;
+
+    static int Decode(const std::string& path, Image& image,
+                      std::string& error);
+
+  public:
+    ImageImporter();
+    ~ImageImporter();
+
+    // Every image in folder is one Z layer, in natural file name order
+    int ImportSlices(const std::string& folder, VoxelManager& voxelManager,
+                     PaletteManager& paletteManager, std::string& log,
+                     std::string& error);
+    // Gray images use the selected palette color for every column
+    int ImportHeightmap(const std::string& path, VoxelManager& voxelManager,
+                        PaletteManager& paletteManager, std::string& log,
+                        std::string& error);
+
+    inline int& GetThreshold() { return threshold; }
+    inline int& GetHeightScale() { return heightScale; }
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "PaletteManager.hpp"
+#include "VoxelManager.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Builds a greedy-meshed polygon surface of the voxel grid and streams it to
+// OBJ, PLY or glTF. Chunks are meshed in parallel; quads are then grouped by
+// palette color so every color becomes one contiguous group/primitive.
+class MeshExporter {
+  public:
+    enum class Format { OBJ, PLY, GLTF };
+    enum class ColorMode { Materials, VertexColors, PaletteTexture };
+
+  private:
+    static constexpr int chunkSize = 32;
+    static constexpr float voxelSize = 1 / 16.0f;
+
+    // One merged rectangle of faces. (x, y, z) is the corner on the face
+    // plane, w and h extend along the two axes following the normal axis.
+    struct Quad {
+        uint16_t x, y, z;
+        uint16_t w, h;
+        uint16_t color;
+        uint8_t face; // axis * 2 + (negative ? 1 : 0)
+    };
+
+    ColorMode colorMode = ColorMode::Materials;
+
+    std::vector<Quad> quads;            // sorted by color
+    std::vector<uint32_t> colorOffsets; // first quad of each color
+    std::vector<glm::vec4> colors;      // palette used for the export
+
+    void BuildQuads(VoxelManager& voxelManager,
+                    const SelectionMask* selection);
+    void QuadCorners(const Quad& quad, glm::vec3 corners[4]) const;
+
+    int WriteObj(const std::string& path, std::string& error);
+    int WritePly(const std::string& path, std::string& error);
+    int WriteGltf(const std::string& path, std::string& error);
+    int WritePaletteTexture(const std::string& path, std::string& error);
+
+  public:
+    MeshExporter();
+    ~MeshExporter();
+
+    // Only voxels inside selection are meshed when it is given
+    int Export(const std::string& path, Format format,
+               VoxelManager& voxelManager, PaletteManager& paletteManager,
+               std::string& log, std::string& error,
+               const SelectionMask* selection = nullptr);
+
+    inline ColorMode& GetColorMode() { return colorMode; }
+    inline size_t GetQuadCount() const { return quads.size(); }
+};
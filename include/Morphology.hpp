@@ -0,0 +1,55 @@
+#pragma once
+
+#include "SelectionMask.hpp"
+#include "VoxelManager.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Dilate, erode, open, close, majority smoothing and hollowing of the solid
+// voxels. Occupancy is packed one bit per voxel in the SelectionMask row
+// layout, and every operation is a chain of separable box passes along x,
+// y and z made of word-wide logic, run in parallel over z slices. The box
+// is the 26-neighborhood cube, the one shape that separates. Voxels that
+// appear take the most common color of their solid neighbors.
+class Morphology {
+  public:
+    enum class Op { Dilate, Erode, Open, Close, Smooth, Hollow };
+
+  private:
+    glm::ivec3 size = {0, 0, 0};
+    size_t wordsPerRow = 0;
+    uint64_t tailMask = 0;
+    // Outside the grid repeats the border voxels, else it is empty
+    bool clampEdges = true;
+    std::vector<uint64_t> bits;
+    std::vector<uint64_t> scratch;
+
+    inline size_t rowOffset(int y, int z) const {
+        return (size_t(z) * size.y + y) * wordsPerRow;
+    }
+
+    void Load(const std::vector<float>& voxels);
+    // Word w of a row with its x - 1 and x + 1 neighbors shifted in
+    void RowNeighbors(const uint64_t* row, size_t w, uint64_t& current,
+                      uint64_t& left, uint64_t& right) const;
+    // Box max (grow) or min of the given radius along one axis
+    void Pass(int axis, int radius, bool grow);
+    void Grow(int radius);
+    void Shrink(int radius);
+    // Keeps a voxel solid when at least 14 of the 27 around it are
+    void Majority();
+    // Writes the difference to before back, coloring new voxels
+    uint64_t Store(VoxelManager& voxelManager,
+                   const std::vector<uint64_t>& before);
+
+  public:
+    Morphology();
+    ~Morphology();
+
+    // radius is the box radius, the shell thickness for Hollow and the
+    // number of iterations for Smooth. Only voxels in region change when
+    // it is given. Returns the number of voxels changed.
+    uint64_t Apply(VoxelManager& voxelManager, Op op, int radius,
+                   const SelectionMask* region = nullptr);
+};
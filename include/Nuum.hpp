@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Camera.hpp"
+#include "Csg.hpp"
+#include "Generator.hpp"
+#include "PathTracer.hpp"
 #include "Serializer.hpp"
 #include "ToolBox.hpp"
 #include "VoxelManager.hpp"
@@ -26,10 +29,22 @@ class Nuum {
     bool openCameraWindow = false;
     bool openPaletteWindow = true;
     bool openToolBoxWindow = true;
+    bool openGeneratorWindow = false;
+    bool openCsgWindow = false;
+    bool openRenderWindow = false;
 
     bgfx::UniformHandle u_camPos;
     bgfx::UniformHandle u_camMat;
     bgfx::UniformHandle u_gridSize;
+    bgfx::UniformHandle u_lodParams;
+    bgfx::UniformHandle u_lodSize;
+    bgfx::UniformHandle u_atlasParams;
+    bgfx::UniformHandle u_aoParams;
+    bgfx::UniformHandle u_sdfParams;
+    bgfx::UniformHandle u_overlayParams;
+    bgfx::UniformHandle u_overlaySize;
+    bgfx::UniformHandle u_overlayTextureSize;
+    bgfx::UniformHandle u_indexParams;
 
     bgfx::ProgramHandle program;
     bgfx::FrameBufferHandle frameBuffer;
@@ -39,6 +54,10 @@ class Nuum {
     bgfx::IndexBufferHandle indexBuffer;
 
     glm::vec4 gridSize = {16.0f, 16.0f, 16.0f, 1.0f};
+    bool useLod = true;
+    float lodBias = 0.0f;
+    float aoStrength = 1.0f;
+    bool useSphereTracing = false;
     glm::vec2 viewportMousePos = {0.0f, 0.0f};
     bool isHoveringViewport;
     ImVec2 viewportSize = ImVec2(width * 0.5f, height * 0.5f);
@@ -49,6 +68,9 @@ class Nuum {
     Serializer serializer;
     PaletteManager paletteManager;
     ToolBox toolBox;
+    Generator generator;
+    Csg csg;
+    PathTracer pathTracer;
 
     void InitBgfx(SDL_Window* window, SDL_SysWMinfo& wmInfo);
     void InitImGui(SDL_Window* window);
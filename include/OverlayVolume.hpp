@@ -0,0 +1,59 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Small transient volume of palette indices the ray shader draws on top of
+// the model as a translucent ghost, for previews that must not touch the
+// voxel store. The R16 texture grows per axis and is only reallocated when
+// a preview outgrows it, so moving or resizing the preview is a sub-region
+// update of a few kilobytes. Previews past maxVoxels, or all of them with
+// outlineOnly, are drawn as the outline of their box without any upload.
+class OverlayVolume {
+  public:
+    static constexpr int granularity = 16;
+    static constexpr uint64_t maxVoxels = uint64_t(1) << 18; // 512 KB
+
+  private:
+    glm::ivec3 origin = {0, 0, 0};
+    glm::ivec3 size = {0, 0, 0};
+    glm::ivec3 capacity = {0, 0, 0}; // texture size
+    bool visible = false;
+    bool outline = false;     // the current preview is drawn as its box
+    bool outlineOnly = false; // user setting, never upload voxels
+
+    bgfx::TextureHandle textureHandle = {bgfx::kInvalidHandle};
+    bgfx::UniformHandle s_overlayTexture = {bgfx::kInvalidHandle};
+
+  public:
+    OverlayVolume();
+    ~OverlayVolume();
+
+    void Init();
+    void Destroy();
+
+    // False when a preview of this size is shown as an outline, callers
+    // check it before building the values for Set
+    bool showsVoxels(const glm::ivec3& size) const;
+    // values holds size.x * size.y * size.z palette indices, 0 is empty
+    void Set(const glm::ivec3& origin, const glm::ivec3& size,
+             const std::vector<uint16_t>& values);
+    // Outline of the box [origin, origin + size)
+    void SetOutline(const glm::ivec3& origin, const glm::ivec3& size);
+    // Moves the current contents without uploading anything
+    inline void setOrigin(const glm::ivec3& origin) { this->origin = origin; }
+    inline void Hide() { visible = false; }
+
+    inline bool isVisible() const { return visible; }
+    inline bool isOutline() const { return outline; }
+    inline bool& getOutlineOnly() { return outlineOnly; }
+    inline const glm::ivec3& getOrigin() const { return origin; }
+    inline const glm::ivec3& getSize() const { return size; }
+    inline const glm::ivec3& getCapacity() const { return capacity; }
+    inline bgfx::TextureHandle& getTextureHandle() { return textureHandle; }
+    inline bgfx::UniformHandle& getTextureUniform() {
+        return s_overlayTexture;
+    }
+};
@@ -28,12 +28,18 @@ class Palette {
     inline void RemoveColor(uint16_t index) {
         if (index < colors.size()) {
             colors.erase(colors.begin() + index);
+            if (selectedColorIndex > index) {
+                selectedColorIndex--;
+            }
             if (selectedColorIndex >= colors.size()) {
                 selectedColorIndex = colors.size() - 1;
             }
         }
     }
 
+    // Moves the entry at from to position to, shifting those in between
+    void MoveColor(uint16_t from, uint16_t to);
+
     inline void setSelectedColorIndex(uint16_t index) {
         if (index < colors.size()) {
             selectedColorIndex = index;
@@ -1,9 +1,23 @@
 #pragma once
 
 #include "Palette.hpp"
+#include "VoxelIndex.hpp"
 #include <bgfx/bgfx.h>
+#include <cstdint>
+#include <numeric>
 #include <vector>
 
+// Maps every storable palette index to a new one, [0] keeps empty space empty
+using PaletteRemap = std::vector<uint16_t>;
+// Voxel count per palette index, one entry per index of the volume's format
+using PaletteUsage = std::vector<uint64_t>;
+
+inline PaletteRemap IdentityRemap() {
+    PaletteRemap remap(VoxelIndex<uint16_t>::count);
+    std::iota(remap.begin(), remap.end(), uint16_t(0));
+    return remap;
+}
+
 class PaletteManager {
 private:
     std::vector<Palette> palettes;
@@ -11,10 +25,17 @@ private:
     int32_t paletteSize;
     bool shouldUpdate = true;
 
+    // Index changes the volume still has to follow, composed in order
+    PaletteRemap pendingRemap;
+    bool remapPending = false;
+    int replaceFrom = 1;
+    int replaceTo = 1;
+
     bgfx::DynamicVertexBufferHandle paletteBuffer;
     bgfx::VertexLayout paletteLayout;
 
     void AddDefualtPalette();
+    void QueueRemap(const PaletteRemap& remap);
 
 public:
     PaletteManager();
@@ -22,7 +43,8 @@ public:
     PaletteManager& operator=(const PaletteManager&) = delete;
     ~PaletteManager();
 
-    void RenderWindow(bool* open);
+    // Shows the voxel count of each color when usage is given
+    void RenderWindow(bool* open, const PaletteUsage* usage = nullptr);
     void UpdateColorData();
 
     void Init();
@@ -32,6 +54,17 @@ public:
     void RemovePalette(size_t index);
     void SetCurrentPalette(size_t index);
 
+    // Edits of the current palette that move indices; the volume is
+    // remapped to match on the next VoxelManager::Update()
+    void RemoveColor(uint16_t index);
+    void MoveColor(uint16_t from, uint16_t to);
+    void ReplaceColor(uint16_t from, uint16_t to);
+    // Drops every color no voxel uses, except the selected one, and packs
+    // the rest down in order
+    void RemoveUnusedColors(const PaletteUsage& usage);
+    // Hands out the composed remap since the last call, false if none
+    bool TakeRemap(PaletteRemap& remap);
+
     inline Palette& GetCurrentPalette() {
         return palettes[currentPaletteIndex];
     }
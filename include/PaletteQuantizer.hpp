@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Palette.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Reduces RGBA data to at most 255 palette colors. Colors are binned into a
+// 15 bit histogram, split by weighted median cut, refined with a few k-means
+// passes over the bins, and mapped back through a 32^3 nearest-color cube,
+// so the cost per input color is one histogram add and one table lookup.
+class PaletteQuantizer {
+  public:
+    static constexpr int cubeBits = 5;
+    static constexpr int cubeSize = 1 << cubeBits;
+
+  private:
+    struct Bin {
+        uint64_t count = 0;
+        uint64_t sum[3] = {0, 0, 0};
+    };
+
+    // cubeSize^3 bins, indexed like the lookup cube
+    std::vector<Bin> histogram;
+    std::vector<glm::vec3> centers;
+    std::vector<uint8_t> cube;
+
+    void MedianCut(std::vector<uint32_t>& used, int maxColors);
+    void Refine(const std::vector<uint32_t>& used, int iterations);
+    void BuildCube();
+    glm::vec3 BinColor(uint32_t bin) const;
+    int Nearest(const glm::vec3& color) const;
+
+  public:
+    PaletteQuantizer();
+    ~PaletteQuantizer();
+
+    void Clear();
+    // Accumulates colors into the histogram, alpha below 128 is skipped
+    void Add(const glm::u8vec4* colors, size_t count);
+    // Picks the palette, returns the number of colors chosen
+    int Build(int maxColors = 255, int iterations = 4);
+    // Index 0 is empty space, the chosen colors follow in order
+    Palette MakePalette(std::string name) const;
+    void Map(const glm::u8vec4* colors, size_t count, uint8_t* indices) const;
+
+    static inline uint32_t Key(const glm::u8vec4& color) {
+        return (uint32_t(color.r >> (8 - cubeBits)) << (2 * cubeBits)) |
+               (uint32_t(color.g >> (8 - cubeBits)) << cubeBits) |
+               uint32_t(color.b >> (8 - cubeBits));
+    }
+    // Palette index of a color, 0 for transparent ones
+    inline uint8_t Map(const glm::u8vec4& color) const {
+        if (color.a < 128 || cube.empty()) {
+            return 0;
+        }
+        return cube[Key(color)];
+    }
+    inline int getColorCount() const { return int(centers.size()); }
+};
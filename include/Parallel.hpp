@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+
+inline uint32_t ThreadCount() {
+    uint32_t count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+// Calls fn(i) for every i in [begin, end), spread over all hardware threads.
+// Work is handed out in chunks of `grain` through an atomic counter, so
+// uneven workloads (e.g. empty vs. full bricks) still balance well.
+template <typename Fn>
+void For(uint32_t begin, uint32_t end, Fn&& fn, uint32_t grain = 1) {
+    if (end <= begin) {
+        return;
+    }
+    grain = std::max(grain, 1u);
+    const uint32_t count = end - begin;
+    const uint32_t threads =
+        std::min(ThreadCount(), (count + grain - 1) / grain);
+    if (threads <= 1) {
+        for (uint32_t i = begin; i < end; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<uint32_t> next{begin};
+    auto worker = [&]() {
+        while (true) {
+            uint32_t start = next.fetch_add(grain);
+            if (start >= end) {
+                break;
+            }
+            uint32_t stop = std::min(start + grain, end);
+            for (uint32_t i = start; i < stop; ++i) {
+                fn(i);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (uint32_t t = 0; t < threads - 1; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+} // namespace Parallel
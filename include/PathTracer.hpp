@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "PaletteManager.hpp"
+#include "VoxelManager.hpp"
+#include <array>
+#include <atomic>
+#include <bgfx/bgfx.h>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Progressive Monte Carlo path tracer running on the CPU. The voxel grid is
+// snapshotted when the scene changes and traced by a background thread, which
+// accumulates one sample per pixel per pass over all hardware threads.
+class PathTracer {
+  private:
+    static constexpr int brickSize = 8;   // voxels per brick side
+    static constexpr int regionSize = 64; // voxels per region side
+
+    // Scene snapshot, owned by the worker while it is running
+    glm::ivec3 gridSize = {0, 0, 0};
+    glm::ivec3 brickCount = {0, 0, 0};
+    glm::ivec3 regionCount = {0, 0, 0};
+    std::vector<uint16_t> voxels;     // palette index per voxel
+    std::vector<uint8_t> brickMask;   // 1 if the 8^3 brick has any voxel
+    std::vector<uint8_t> regionMask;  // 1 if the 64^3 region has any voxel
+    std::vector<glm::vec3> albedo;    // linear, per palette index
+    std::vector<glm::vec4> paletteColors; // to detect palette edits
+    glm::vec3 gridMin = {0.0f, 0.0f, 0.0f};
+    float voxelSize = 0.125f;
+
+    glm::vec3 camPos = {0.0f, 0.0f, 0.0f};
+    glm::mat4 invViewProj = glm::mat4(0.0f);
+
+    struct Settings {
+        int maxBounces = 3;
+        int maxSamples = 1024;
+        float exposure = 1.0f;
+        float skyStrength = 1.0f;
+        float sunStrength = 3.0f;
+        glm::vec2 sunAngles = {0.8f, 0.6f}; // elevation, azimuth in radians
+        std::array<float, 256> emission{};  // per palette index
+    };
+    // Edited by the UI, copied into `active` whenever the worker restarts
+    Settings settings;
+    Settings active;
+    glm::vec3 sunDir = {0.0f, 1.0f, 0.0f};
+    float resolutionScale = 0.5f;
+    float lastVoxelScale = 0.0f;
+    bool enabled = false;
+    bool showInViewport = false;
+
+    // Film
+    uint32_t imageWidth = 0, imageHeight = 0;
+    std::vector<glm::vec3> accumulation;
+    std::vector<uint32_t> pixels; // RGBA8, guarded by pixelMutex
+    std::mutex pixelMutex;
+    std::atomic<uint32_t> sampleCount{0};
+    std::atomic<bool> running{false};
+    std::atomic<bool> frameReady{false};
+    std::thread worker;
+
+    bgfx::TextureHandle texture = {bgfx::kInvalidHandle};
+    uint16_t textureWidth = 0, textureHeight = 0;
+
+    uint64_t voxelRevision = UINT64_MAX;
+    std::atomic<uint64_t> renderTime{0}; // milliseconds spent tracing
+    bool sceneDirty = true;
+
+    void Start();
+    void Stop();
+    void WorkerLoop();
+    void Snapshot(VoxelManager& voxelManager, PaletteManager& paletteManager,
+                  float voxelScale);
+    void Resolve();
+
+    bool Intersect(const glm::vec3& origin, const glm::vec3& dir, float& tHit,
+                   glm::ivec3& hitNormal, uint16_t& hitIndex) const;
+    glm::vec3 TracePath(glm::vec3 origin, glm::vec3 dir, uint32_t& rng) const;
+    glm::vec3 Sky(const glm::vec3& dir) const;
+
+  public:
+    PathTracer();
+    PathTracer(const PathTracer&) = delete;
+    PathTracer& operator=(const PathTracer&) = delete;
+    ~PathTracer();
+
+    void Init();
+    void Destroy();
+
+    // Restarts accumulation when the camera, voxels or palette changed and
+    // uploads the latest resolved image. Called once per frame.
+    void Update(const Camera& camera, VoxelManager& voxelManager,
+                PaletteManager& paletteManager, const glm::vec2& viewportSize,
+                float voxelScale);
+    void RenderWindow(bool* open, PaletteManager& paletteManager);
+    inline void Invalidate() { sceneDirty = true; }
+
+    // Copy of the current tonemapped image as tightly packed RGBA8
+    void GetImage(std::vector<uint8_t>& rgba, uint32_t& w, uint32_t& h);
+
+    inline bool IsShownInViewport() const {
+        return enabled && showInViewport && bgfx::isValid(texture);
+    }
+    inline bgfx::TextureHandle& getTextureHandle() { return texture; }
+    inline uint32_t getSampleCount() const { return sampleCount; }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "PaletteManager.hpp"
+#include "VoxelManager.hpp"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Voxelizes colored point clouds from ASCII/binary PLY and XYZ files. The
+// file is streamed twice in fixed size blocks, once for the bounds and once
+// for binning, so clouds far larger than memory can be read. Each block is
+// decoded in parallel parts; every part bins into its own sparse partial
+// grid, the grids are merged shard by shard and the averaged voxel colors
+// are quantized to a new palette.
+class PointCloudImporter {
+  public:
+    static constexpr int maxResolution = 2048;
+
+  private:
+    enum class Encoding { Ascii, BinaryLittleEndian, BinaryBigEndian };
+    enum class Type {
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Float,
+        Double
+    };
+    // Vertex properties that are read, everything else is skipped
+    enum Field { X, Y, Z, Red, Green, Blue, FieldCount };
+
+    struct Property {
+        Type type;
+        int field; // Field, or -1 when unused
+        uint32_t offset;
+    };
+
+    // What the header says about the vertex records
+    struct Layout {
+        bool ply = false;
+        Encoding encoding = Encoding::Ascii;
+        uint64_t count = 0; // vertices, PLY only
+        uint32_t stride = 0;
+        std::vector<Property> properties;
+        bool hasColor = false;
+        std::streampos dataStart = 0;
+    };
+
+    struct Point {
+        glm::dvec3 position;
+        glm::vec3 color; // 0..255 for PLY, as written for XYZ
+    };
+
+    struct Cell {
+        uint64_t sum[3] = {0, 0, 0};
+        uint64_t count = 0;
+    };
+    static constexpr int shardBits = 6;
+    static constexpr uint32_t shardCount = 1 << shardBits;
+    // One sparse grid, split by voxel key so shards merge independently
+    using Grid = std::vector<std::unordered_map<uint64_t, Cell>>;
+
+    int resolution = 256;
+
+    Layout layout;
+    std::vector<char> block;
+    size_t carried = 0;     // unfinished text line kept at the block start
+    uint64_t remaining = 0; // records left to read
+    std::vector<std::vector<Point>> parts;
+
+    int ReadHeader(std::ifstream& file, const std::string& path,
+                   std::string& error);
+    void Rewind(std::ifstream& file);
+    // Reads the next block and decodes it into parts, false at the end
+    bool ReadBlock(std::ifstream& file);
+    void ParseText(const char* begin, const char* end,
+                   std::vector<Point>& points) const;
+    void DecodeBinary(const char* data, size_t count,
+                      std::vector<Point>& points) const;
+    // Brings a color property to 0..255 from the range of its type
+    static double ColorValue(Type type, double value);
+
+    static inline uint32_t Shard(uint64_t key) {
+        return uint32_t((key * 0x9E3779B97F4A7C15ull) >> (64 - shardBits));
+    }
+
+  public:
+    PointCloudImporter();
+    ~PointCloudImporter();
+
+    int Import(const std::string& path, VoxelManager& voxelManager,
+               PaletteManager& paletteManager, std::string& log,
+               std::string& error);
+
+    inline int& GetResolution() { return resolution; }
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// One bit per voxel, packed into 64-bit words. Every row along x starts on a
+// fresh word, so neighbors along y and z are whole words apart and all
+// operations run word-wide; the padding bits past size.x are kept clear.
+class SelectionMask {
+  public:
+    enum class Op { Replace, Add, Subtract, Intersect };
+
+  private:
+    glm::ivec3 size = {0, 0, 0};
+    size_t wordsPerRow = 0;
+    uint64_t tailMask = 0; // valid bits of the last word of a row
+    std::vector<uint64_t> words;
+    uint64_t count = 0;
+
+    void Recount();
+    void Morph(bool grow);
+    static void SetRange(uint64_t* row, int begin, int end);
+
+    // Builds each row of a shape with fill(y, z, row) into a zeroed buffer
+    // and merges it into the mask with op
+    template <typename Fill> void Apply(Op op, Fill&& fill) {
+        Parallel::For(0, size.z, [&](uint32_t z) {
+            std::vector<uint64_t> shape(wordsPerRow);
+            for (int y = 0; y < size.y; ++y) {
+                std::fill(shape.begin(), shape.end(), 0);
+                fill(y, int(z), shape.data());
+                uint64_t* row = &words[rowOffset(y, z)];
+                Merge(row, shape.data(), wordsPerRow, op);
+            }
+        });
+        Recount();
+    }
+    static void Merge(uint64_t* dst, const uint64_t* src, size_t count, Op op);
+
+  public:
+    SelectionMask();
+    ~SelectionMask();
+
+    // Clears the selection
+    void Resize(const glm::ivec3& size);
+    void Clear();
+    void SelectAll();
+    void Invert();
+    void Combine(const SelectionMask& other, Op op);
+    // Adds or removes the 6-connected outer layer, steps times
+    void Grow(int steps = 1);
+    void Shrink(int steps = 1);
+
+    void SelectBox(const glm::ivec3& min, const glm::ivec3& max, Op op);
+    void SelectSphere(const glm::vec3& center, float radius, Op op);
+    // Voxels whose palette index matches the one of value
+    void SelectColor(const std::vector<float>& voxels, float value, Op op);
+    // Voxels carrying label, from ConnectedComponents::getLabels()
+    void SelectLabel(const std::vector<uint32_t>& labels, uint32_t label,
+                     Op op);
+    // Voxels min + p with region[p] != 0, region being size voxels x fastest
+    void SelectRegion(const std::vector<uint8_t>& region, const glm::ivec3& min,
+                      const glm::ivec3& regionSize, Op op);
+
+    // Smallest box [min, max) around the selection, false if it is empty
+    bool getBounds(glm::ivec3& min, glm::ivec3& max) const;
+    inline bool test(const glm::ivec3& voxel) const {
+        if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) ||
+            glm::any(glm::greaterThanEqual(voxel, size))) {
+            return false;
+        }
+        return (words[rowOffset(voxel.y, voxel.z) + (voxel.x >> 6)] >>
+                (voxel.x & 63)) &
+               1;
+    }
+    inline size_t rowOffset(int y, int z) const {
+        return (size_t(z) * size.y + y) * wordsPerRow;
+    }
+    inline bool isEmpty() const { return count == 0; }
+    inline uint64_t getCount() const { return count; }
+    inline const glm::ivec3& getSize() const { return size; }
+    inline const std::vector<uint64_t>& getWords() const { return words; }
+};
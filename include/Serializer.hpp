@@ -1,8 +1,13 @@
 #pragma once
 
+#include "Csg.hpp"
+#include "MeshExporter.hpp"
 #include "PaletteManager.hpp"
+#include "PathTracer.hpp"
+#include "PointCloudImporter.hpp"
 #include "VoxelManager.hpp"
 #include "FileDialog.hpp"
+#include "ImageImporter.hpp"
 #include <array>
 #include <string>
 #include <glm/glm.hpp>
@@ -12,14 +17,28 @@ struct BoundingBox {
     glm::vec3 max;
 };
 
+// Contents of a .nuum file, colors without the empty entry
+struct NuumFile {
+    glm::ivec3 size = {0, 0, 0};
+    std::string paletteName;
+    uint16_t selectedIndex = 0;
+    std::vector<glm::vec4> colors;
+    std::vector<float> voxels;
+};
+
 class Serializer {
   private:
     std::string path = "";
     FileDialog fileDialog;
+    MeshExporter meshExporter;
+    PointCloudImporter pointCloudImporter;
+    ImageImporter imageImporter;
 
     bool showModal = false;
     std::string logString = "";
     std::string errorText = "";
+    // NUPR and mesh exports skip voxels outside a non-empty selection
+    bool exportSelectionOnly = false;
     SDL_Window* window = nullptr;
 
     BoundingBox CalculateTriangleBoundingBox(const glm::vec3& v0,
@@ -27,6 +46,9 @@ class Serializer {
                                              const glm::vec3& v2);
     int LoadObjFile(const std::string& path, BoundingBox& bbox,
                     std::vector<std::array<glm::vec3, 3>>& triangles);
+    const SelectionMask* ExportSelection(VoxelManager& voxelManager);
+    // Fills nuum from the file, errorText says what failed
+    int ReadNuum(const std::string& path, NuumFile& nuum);
 
   public:
     Serializer();
@@ -37,12 +59,32 @@ class Serializer {
                const bool save = false);
     int ImportFromObj(VoxelManager& voxelManager,
                       PaletteManager& paletteManager);
+    // Reads .nupr RGBA voxels back, matching or generating a palette
+    int ImportFromNUPR(VoxelManager& voxelManager,
+                       PaletteManager& paletteManager);
+    // Voxelizes a PLY or XYZ point cloud, picked by extension
+    int ImportPointCloud(VoxelManager& voxelManager,
+                         PaletteManager& paletteManager);
+    // Stacks the images of a picked folder as Z slices
+    int ImportImageSlices(VoxelManager& voxelManager,
+                          PaletteManager& paletteManager);
+    int ImportHeightmap(VoxelManager& voxelManager,
+                        PaletteManager& paletteManager);
+    // Reads a .nuum as the second volume of CSG operations
+    int ImportCsgVolume(Csg& csg);
     int ExportToNUPR(VoxelManager& voxelManager,
                         PaletteManager& paletteManager);
+    int ExportRender(PathTracer& pathTracer);
+    int ExportMesh(VoxelManager& voxelManager, PaletteManager& paletteManager,
+                   MeshExporter::Format format);
 
     void Init(SDL_Window* window);
     void Destroy();
     void RenderWindow();
 
     std::string& GetPath() { return path; }
+    MeshExporter& GetMeshExporter() { return meshExporter; }
+    PointCloudImporter& GetPointCloudImporter() { return pointCloudImporter; }
+    ImageImporter& GetImageImporter() { return imageImporter; }
+    bool& GetExportSelectionOnly() { return exportSelectionOnly; }
 };
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "VoxelManager.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Tool shapes as runs of voxels along x, the axis the voxel store is laid
+// out along. A shape is written in one pass over its spans with a single
+// dirty region, and its preview fills the overlay from the same spans.
+namespace SpanRaster {
+
+// Voxels [start.x, start.x + length) of the row at start.y, start.z
+struct Span {
+    glm::ivec3 start;
+    int length;
+    float value;
+
+    bool operator==(const Span&) const = default;
+};
+
+// 3D Bresenham from a to b, both ends included
+void Line(const glm::ivec3& a, const glm::ivec3& b, float value,
+          std::vector<Span>& spans);
+// Ball of the given diameter around center, the brush stamp
+void Sphere(const glm::ivec3& center, int diameter, float value,
+            std::vector<Span>& spans);
+// Box with corners a and b included, only its shell when hollow
+void Box(const glm::ivec3& a, const glm::ivec3& b, bool hollow, float value,
+         std::vector<Span>& spans);
+// The face under voxel: solid voxels of its plane connected through edges,
+// each with an empty voxel in front along normal. They are copied depth
+// layers outwards in their own colors, or with push the face and the
+// layers behind it are cleared. False when voxel is no such face.
+bool Extrude(const std::vector<float>& voxels, const glm::ivec3& size,
+             const glm::ivec3& voxel, const glm::ivec3& normal, int depth,
+             bool push, std::vector<Span>& spans);
+
+// Cuts the spans to the grid and returns their bounds [min, max), false
+// when nothing is left
+bool Clip(std::vector<Span>& spans, const glm::ivec3& size, glm::ivec3& min,
+          glm::ivec3& max);
+// Fills the empty voxels of clipped spans with their value, or clears the
+// solid ones when erasing. Returns the number of voxels changed.
+uint64_t Write(VoxelManager& voxelManager, const std::vector<Span>& spans,
+               bool erase);
+// Shows the voxels Write would change in the overlay, or the outline of
+// their bounds when the overlay takes no voxels of that size
+void Preview(VoxelManager& voxelManager, const std::vector<Span>& spans,
+             bool erase);
+
+// Scanline flood fill from seed over the voxels match accepts. Spans run
+// along spanAxis and spread to the neighbor rows along rowAxes. write has
+// to make match false, that is what keeps voxels from being visited twice.
+template <typename Match, typename Write>
+void FloodFill(const glm::ivec3& size, const glm::ivec3& seed, int spanAxis,
+               const std::vector<int>& rowAxes, Match match, Write write) {
+    std::vector<glm::ivec3> stack = {seed};
+    while (!stack.empty()) {
+        const glm::ivec3 start = stack.back();
+        stack.pop_back();
+        if (!match(start)) {
+            continue;
+        }
+        glm::ivec3 low = start;
+        glm::ivec3 high = start;
+        glm::ivec3 next = start;
+        for (next[spanAxis] = start[spanAxis] - 1;
+             next[spanAxis] >= 0 && match(next); --next[spanAxis]) {
+            low[spanAxis] = next[spanAxis];
+        }
+        for (next[spanAxis] = start[spanAxis] + 1;
+             next[spanAxis] < size[spanAxis] && match(next);
+             ++next[spanAxis]) {
+            high[spanAxis] = next[spanAxis];
+        }
+        for (glm::ivec3 voxel = low; voxel[spanAxis] <= high[spanAxis];
+             ++voxel[spanAxis]) {
+            write(voxel);
+        }
+        // One seed per run of matching voxels in each neighbor row
+        for (int axis : rowAxes) {
+            for (int step = -1; step <= 1; step += 2) {
+                glm::ivec3 row = low;
+                row[axis] += step;
+                if (row[axis] < 0 || row[axis] >= size[axis]) {
+                    continue;
+                }
+                bool inRun = false;
+                for (; row[spanAxis] <= high[spanAxis]; ++row[spanAxis]) {
+                    const bool matched = match(row);
+                    if (matched && !inRun) {
+                        stack.push_back(row);
+                    }
+                    inRun = matched;
+                }
+            }
+        }
+    }
+}
+
+} // namespace SpanRaster
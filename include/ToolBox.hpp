@@ -1,18 +1,76 @@
 #pragma once
 
+#include "Clipboard.hpp"
+#include "ConnectedComponents.hpp"
+#include "Morphology.hpp"
 #include "PaletteManager.hpp"
+#include "SpanRaster.hpp"
 #include "VoxelManager.hpp"
 #include <array>
 #include <cstddef>
+#include <optional>
 
 class ToolBox {
   private:
-    std::array<std::string, 3> toolNames = {"Pencil", "Bucket", "Brush"};
+    std::array<std::string, 9> toolNames = {
+        "Pencil", "Bucket", "Brush", "Island", "Select",
+        "Paste",  "Line",   "Box",   "Extrude"};
     size_t selectedTool = 0;
 
     int brushSize = 4;
     int brushSide = brushSize * 2 + 1;
     bool fillColor = false;
+    // Mirror planes through the volume center for Pencil, Bucket and
+    // Brush, bit i for axis i
+    int mirrorAxes = 0;
+
+    ConnectedComponents components;
+    glm::ivec3 islandSeed = {-1, -1, -1}; // any voxel of the selected island
+    uint32_t islandSize = 0;
+    int minComponentSize = 8;
+
+    enum class SelectMode { Box, Sphere, Color, Island };
+    SelectMode selectMode = SelectMode::Box;
+    SelectionMask::Op selectOp = SelectionMask::Op::Replace;
+    int selectRadius = 4;
+    int selectSteps = 1;
+    bool hasBoxAnchor = false; // first corner placed, next click closes it
+    glm::ivec3 boxAnchor = {0, 0, 0};
+
+    Clipboard clipboard;
+    bool ghostStale = true; // clipboard changed since the overlay upload
+
+    bool transformSelection = false;
+    glm::vec3 resampleScale = {2.0f, 2.0f, 2.0f};
+    ResampleFilter resampleFilter = ResampleFilter::Mode;
+
+    Morphology morphology;
+    Morphology::Op filterOp = Morphology::Op::Smooth;
+    int filterRadius = 1;
+    bool filterSelection = false;
+    long long filterChanged = -1; // voxels the last filter changed
+
+    // Line and Box follow the mouse from the press to the release, the
+    // spans of the shape so far are shown in the overlay
+    bool dragging = false;
+    bool dragErase = false;
+    glm::ivec3 dragStart = {0, 0, 0};
+    float dragValue = 0.0f;
+    std::vector<SpanRaster::Span> dragSpans;
+    // What the overlay shows for the tools other than Paste
+    std::vector<SpanRaster::Span> previewSpans;
+    bool previewErase = false;
+    uint64_t previewRevision = 0;
+    bool boxHollow = false;
+    int extrudeDepth = 1;
+    // The face the Extrude preview was flooded from; moves over the same
+    // voxel of an unchanged volume reuse its spans
+    glm::ivec3 extrudePos = {-1, -1, -1};
+    glm::ivec3 extrudeNormal = {0, 0, 0};
+    uint64_t extrudeRevision = 0;
+    int extrudeLayers = 0;
+    bool extrudeErase = false;
+    std::vector<SpanRaster::Span> extrudeSpans;
 
     int useBucket(const HitInfo& hit, VoxelManager& voxelManager, PaletteManager& paletteManager,
                   bool altAction = false);
@@ -20,6 +78,42 @@ class ToolBox {
                   bool altAction = false);
     int useBrush(const HitInfo& hit, VoxelManager& voxelManager, PaletteManager& paletteManager,
                  bool altAction = false);
+    int useIsland(const HitInfo& hit, VoxelManager& voxelManager, PaletteManager& paletteManager,
+                  bool altAction = false);
+    int useSelect(const HitInfo& hit, VoxelManager& voxelManager, PaletteManager& paletteManager,
+                  bool altAction = false);
+    int usePaste(const HitInfo& hit, VoxelManager& voxelManager, PaletteManager& paletteManager,
+                 bool altAction = false);
+    int useLine(const HitInfo& hit, VoxelManager& voxelManager, PaletteManager& paletteManager,
+                bool altAction = false);
+    int useBox(const HitInfo& hit, VoxelManager& voxelManager, PaletteManager& paletteManager,
+               bool altAction = false);
+    int useExtrude(const HitInfo& hit, VoxelManager& voxelManager, PaletteManager& paletteManager,
+                   bool altAction = false);
+    // Voxel a drag starts or ends at, the hit voxel when erasing
+    glm::ivec3 DragTarget(const HitInfo& hit, bool erase) const;
+    // Rasterizes the dragged shape up to target and shows it
+    void UpdateDrag(const glm::ivec3& target, VoxelManager& voxelManager);
+    // Shows spans in the overlay unless they are what it already shows
+    void ShowPreview(const std::vector<SpanRaster::Span>& spans, bool erase,
+                     VoxelManager& voxelManager);
+    // voxel and its images in the enabled mirror planes, without repeats
+    std::vector<glm::ivec3> MirrorImages(const glm::ivec3& voxel,
+                                         const glm::ivec3& size) const;
+    // Flip, rotate and swap buttons for the volume or the selection
+    void RenderTransform(VoxelManager& voxelManager);
+    // Morphological filters for the volume or the selection
+    void RenderFilters(VoxelManager& voxelManager);
+    // Clipboard corner for a paste resting on the hit face
+    glm::ivec3 PasteOrigin(const HitInfo& hit) const;
+    // Moves the clipboard ghost, decoding it again only when it changed
+    void PreviewPaste(const HitInfo& hit, VoxelManager& voxelManager);
+
+    // Labels the volume if it changed since the last call
+    void UpdateComponents(VoxelManager& voxelManager);
+    // Sets every voxel whose label is flagged in remove to value
+    void ReplaceComponents(VoxelManager& voxelManager,
+                           const std::vector<uint8_t>& remove, float value);
 
   public:
     ToolBox();
@@ -31,5 +125,22 @@ class ToolBox {
     int useTool(const HitInfo& hit, VoxelManager& voxelManager, PaletteManager& paletteManager,
                 bool altAction = false);
 
-    void RenderWindow(bool* open);
+    // Copy and cut take the current selection
+    int Copy(VoxelManager& voxelManager);
+    int Cut(VoxelManager& voxelManager);
+    void BeginPaste(VoxelManager& voxelManager);
+    // Writes the dragged shape when the mouse button is released
+    void EndDrag(VoxelManager& voxelManager);
+
+    // Updates the ghost of the selected tool for the hovered voxel, as the
+    // tool would apply with altAction
+    void Preview(const std::optional<HitInfo>& hit, VoxelManager& voxelManager,
+                 PaletteManager& paletteManager, bool altAction = false);
+    // Brush, Paste, Line, Box and Extrude
+    inline bool hasPreview() const {
+        return selectedTool == 2 || selectedTool >= 5 || dragging;
+    }
+
+    void RenderWindow(bool* open, VoxelManager& voxelManager,
+                      PaletteManager& paletteManager);
 };
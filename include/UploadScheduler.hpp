@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <bgfx/bgfx.h>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <vector>
+
+// Hands out staging memory for texture uploads from a recycled ring buffer,
+// capped by a per-frame byte budget. Large updates are queued by their owners
+// as brick-sized slices and drained a little every frame, so loading a big
+// volume never stalls the viewport. Ring space is only reused once bgfx has
+// released the reference it was given.
+class UploadScheduler {
+  private:
+    struct Allocation {
+        uint32_t offset;
+        uint32_t size;
+        std::atomic<uint32_t> pending; // references bgfx still holds
+    };
+
+    std::vector<uint8_t> ring;
+    uint32_t head = 0;
+    std::deque<Allocation> inFlight;
+
+    uint32_t frameBudget = 8u << 20;
+    uint32_t frameBytes = 0;
+    uint64_t totalBytes = 0;
+
+    static void Release(void* ptr, void* userData);
+    void Reclaim();
+
+  public:
+    UploadScheduler();
+    ~UploadScheduler();
+
+    // ringSize should cover a few frames of budget, bgfx keeps references
+    // alive until the frame that consumes them has been rendered
+    void Init(uint32_t ringSize = 32u << 20);
+    void Destroy();
+
+    void BeginFrame();
+    // Staging memory for one slice, or nullptr once this frame's budget or
+    // the ring is used up; the caller fills data and passes it to bgfx
+    const bgfx::Memory* Allocate(uint32_t size);
+    // Staging memory for uploads that have to go out together, one slice
+    // per size in out; all of them or none, then false
+    bool Allocate(std::initializer_list<uint32_t> sizes,
+                  const bgfx::Memory** out);
+
+    inline uint32_t& getFrameBudget() { return frameBudget; }
+    inline uint32_t getFrameBytes() const { return frameBytes; }
+    inline uint64_t getTotalBytes() const { return totalBytes; }
+};
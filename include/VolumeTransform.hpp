@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Parallel.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Axis-aligned reorientations of a dense volume: any mix of flips, 90 degree
+// rotations and axis permutations is one AxisMap, applied in a single pass.
+namespace VolumeTransform {
+
+// Output axis i reads input axis source[i], mirrored when flip[i] is set
+struct AxisMap {
+    glm::ivec3 source = {0, 1, 2};
+    glm::bvec3 flip = {false, false, false};
+};
+
+AxisMap Flip(int axis);
+// Quarter turn around axis, counterclockwise looking down the axis
+AxisMap Rotate(int axis, bool clockwise = false);
+AxisMap Swap(int a, int b);
+
+glm::ivec3 MappedSize(const glm::ivec3& size, const AxisMap& map);
+
+// dst[p] = src[q] for every output voxel p, q being p mapped back into the
+// input. Runs over 16^3 output tiles in parallel so the scattered reads of
+// a transpose stay within a few cache lines per row.
+template <typename T>
+void Remap(const std::vector<T>& src, const glm::ivec3& srcSize,
+           std::vector<T>& dst, const AxisMap& map) {
+    constexpr int tileSize = 16;
+    const glm::ivec3 dstSize = MappedSize(srcSize, map);
+    dst.resize(size_t(dstSize.x) * dstSize.y * dstSize.z);
+
+    const int64_t srcStrides[3] = {1, int64_t(srcSize.x),
+                                   int64_t(srcSize.x) * srcSize.y};
+    int64_t step[3];
+    int64_t base = 0;
+    for (int i = 0; i < 3; ++i) {
+        const int axis = map.source[i];
+        step[i] = map.flip[i] ? -srcStrides[axis] : srcStrides[axis];
+        if (map.flip[i]) {
+            base += int64_t(srcSize[axis] - 1) * srcStrides[axis];
+        }
+    }
+
+    const glm::ivec3 tiles = (dstSize + tileSize - 1) / tileSize;
+    Parallel::For(0, tiles.x * tiles.y * tiles.z, [&](uint32_t t) {
+        const glm::ivec3 start =
+            glm::ivec3(t % tiles.x, (t / tiles.x) % tiles.y,
+                       t / (tiles.x * tiles.y)) *
+            tileSize;
+        const glm::ivec3 end = glm::min(start + tileSize, dstSize);
+        for (int z = start.z; z < end.z; ++z) {
+            for (int y = start.y; y < end.y; ++y) {
+                T* out = &dst[(size_t(z) * dstSize.y + y) * dstSize.x];
+                int64_t in = base + y * step[1] + z * step[2] +
+                             start.x * step[0];
+                for (int x = start.x; x < end.x; ++x, in += step[0]) {
+                    out[x] = src[in];
+                }
+            }
+        }
+    });
+}
+
+} // namespace VolumeTransform
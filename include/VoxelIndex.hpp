@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <bgfx/bgfx.h>
+#include <cstdint>
+#include <type_traits>
+
+// The volume keeps palette indices as index / 255 floats, which is exact for
+// every 16-bit index. Wherever they are packed into integers (GPU textures,
+// files, snapshots) the width follows the palette: 8 bits while it has at
+// most 256 entries, 16 bits past that.
+enum class IndexFormat { U8, U16 };
+
+template <typename T> struct VoxelIndex {
+    static_assert(std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t>,
+                  "palette indices are 8 or 16 bits");
+
+    static constexpr uint32_t count = uint32_t(1) << (8 * sizeof(T));
+    static constexpr IndexFormat format =
+        sizeof(T) == 1 ? IndexFormat::U8 : IndexFormat::U16;
+    static constexpr bgfx::TextureFormat::Enum textureFormat =
+        sizeof(T) == 1 ? bgfx::TextureFormat::R8 : bgfx::TextureFormat::R16;
+    // A unorm texel of this width reads back as index / (count - 1); the
+    // shader multiplies by this to get index / 255 again
+    static constexpr float shaderScale = (count - 1) / 255.0f;
+
+    static inline T Encode(float value) {
+        return static_cast<T>(
+            std::clamp(int(value * 255.0f + 0.5f), 0, int(count - 1)));
+    }
+    static inline float Decode(T index) { return index / 255.0f; }
+};
+
+inline IndexFormat IndexFormatFor(size_t colorCount) {
+    return colorCount <= VoxelIndex<uint8_t>::count ? IndexFormat::U8
+                                                    : IndexFormat::U16;
+}
+
+// Calls fn with a zero of the index type matching format, so generic code
+// can be written once as a template and picked at runtime
+template <typename Fn>
+decltype(auto) DispatchIndex(IndexFormat format, Fn&& fn) {
+    if (format == IndexFormat::U16) {
+        return fn(uint16_t(0));
+    }
+    return fn(uint8_t(0));
+}
+
+inline uint32_t IndexCount(IndexFormat format) {
+    return DispatchIndex(format, [](auto zero) {
+        return VoxelIndex<decltype(zero)>::count;
+    });
+}
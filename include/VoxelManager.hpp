@@ -1,14 +1,27 @@
 #pragma once
 
+#include "AmbientOcclusion.hpp"
+#include "BrickAtlas.hpp"
+#include "DistanceField.hpp"
+#include "OverlayVolume.hpp"
 #include "Palette.hpp"
 #include "PaletteManager.hpp"
+#include "SelectionMask.hpp"
+#include "UploadScheduler.hpp"
+#include "VolumeTransform.hpp"
+#include "VoxelIndex.hpp"
+#include "VoxelMipChain.hpp"
 #include "glm/fwd.hpp"
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <bgfx/bgfx.h>
 #include <glm/glm.hpp>
 #include <optional>
 #include <vector>
 
+enum class ResampleFilter { Nearest, Mode };
+
 struct HitInfo {
     glm::ivec3 pos;
     glm::ivec3 normal;
@@ -22,17 +35,76 @@ class VoxelManager {
     std::vector<float> voxelData;
     std::vector<uint8_t> occupancyData;
     PaletteManager* paletteManager;
+    // Bumped on every edit, so derived data can tell when it is stale
+    uint64_t revision = 0;
+    // Voxel count per palette index, kept current by every edit
+    PaletteUsage usage = PaletteUsage(VoxelIndex<uint8_t>::count, 0);
+    // Width of the packed indices, follows the palette size
+    IndexFormat indexFormat = IndexFormat::U8;
 
-    bgfx::TextureHandle textureHandle;
     bgfx::UniformHandle s_voxelTexture;
 
+    UploadScheduler uploads;
+    BrickAtlas atlas;
+    VoxelMipChain mipChain;
+    AmbientOcclusion occlusion;
+    DistanceField distanceField;
+    OverlayVolume overlay;
+
+    SelectionMask selection;
+    // setVoxel and setVoxelAABB leave unselected voxels alone
+    bool editSelectionOnly = false;
+
+    // Regions edited since the last Update(), [min, max). Touching ones
+    // are merged, apart ones stay apart so that distant edits of a frame,
+    // like mirrored strokes, do not upload everything in between.
+    static constexpr size_t maxDirtyRegions = 8;
+    std::vector<std::pair<glm::ivec3, glm::ivec3>> dirtyRegions;
+
+    // Rebuilds all derived data after the whole volume was replaced
+    void Rebuild();
+    void CountUsage();
+    // Follows the palette size, true when the format changed
+    bool SyncIndexFormat();
+    template <typename T>
+    void LoadIndices(const std::vector<T>& indices, uint32_t w, uint32_t h,
+                     uint32_t d);
+
   public:
+    // Change in voxel count per palette index, from newUsageDelta()
+    using UsageDelta = std::vector<int64_t>;
+
     VoxelManager();
     ~VoxelManager();
     void Init(uint32_t width, uint32_t height, uint32_t depth,
               PaletteManager* paletteManager);
     void Destroy();
+    // Uploads the edits made since the last call and refreshes derived data
+    void Update();
 
+    // Call after writing to getVoxel() directly, [min, max) is re-uploaded
+    void markDirty(const glm::ivec3& min, const glm::ivec3& max);
+    // Code writing getVoxel() directly reports what it changed here; safe
+    // to call from several threads
+    void applyUsage(const UsageDelta& delta);
+    inline UsageDelta newUsageDelta() const {
+        return UsageDelta(usage.size(), 0);
+    }
+    static inline int paletteIndex(float value) {
+        return VoxelIndex<uint16_t>::Encode(value);
+    }
+    template <typename Counts>
+    static inline size_t usageSlot(const Counts& counts, float value) {
+        return std::min<size_t>(paletteIndex(value), counts.size() - 1);
+    }
+    template <typename Counts>
+    static inline void countChange(Counts& counts, float before,
+                                   float after) {
+        counts[usageSlot(counts, before)]--;
+        counts[usageSlot(counts, after)]++;
+    }
+    // Camera position in world space, used to pick resident bricks
+    void setViewer(const glm::vec3& worldPos, float voxelScale);
     void setVoxelAABB(std::vector<float> data, const glm::ivec3& aabbMin,
                       const glm::ivec3& aabbMax);
     void setVoxel(uint32_t x, uint32_t y, uint32_t z, float value);
@@ -50,19 +122,53 @@ class VoxelManager {
 
     void newVoxelData(std::vector<uint8_t>& newVoxelData, uint32_t w,
                       uint32_t h, uint32_t d);
+    void newVoxelData(std::vector<uint16_t>& newVoxelData, uint32_t w,
+                      uint32_t h, uint32_t d);
+    // Takes over a volume already holding index / 255 values, no copy
+    void newVoxelData(std::vector<float>&& newVoxelData, uint32_t w,
+                      uint32_t h, uint32_t d);
+    // Flips, rotates or permutes the whole volume, dimensions follow the map
+    void Reorient(const VolumeTransform::AxisMap& map);
+    // Same for the selected voxels, around the center of the selection
+    int ReorientSelection(const VolumeTransform::AxisMap& map);
+    // Replaces every voxel value v by remap[v] in one parallel pass
+    void Remap(const PaletteRemap& remap);
+    // Rescales the content by scale per axis; Mode keeps the most common
+    // value of the source voxels under each output voxel, empty included
+    int Resample(const glm::vec3& scale, ResampleFilter filter);
 
     std::optional<HitInfo> Raycast(const glm::vec2& mousePos,
                                    const glm::vec3& rayOrigin,
                                    const glm::mat4& camMat,
                                    const float voxelScale = 0.0625f);
 
-    inline bgfx::TextureHandle& getTextureHandle() { return textureHandle; }
+    inline bgfx::TextureHandle& getTextureHandle() {
+        return atlas.getAtlasTexture();
+    }
 
     inline bgfx::UniformHandle& getVoxelTextureUniform() {
         return s_voxelTexture;
     }
 
+    inline UploadScheduler& getUploadScheduler() { return uploads; }
+    inline BrickAtlas& getAtlas() { return atlas; }
+    inline VoxelMipChain& getMipChain() { return mipChain; }
+    inline AmbientOcclusion& getOcclusion() { return occlusion; }
+    inline DistanceField& getDistanceField() { return distanceField; }
+    inline OverlayVolume& getOverlay() { return overlay; }
+
+    inline SelectionMask& getSelection() { return selection; }
+    inline bool& getEditSelectionOnly() { return editSelectionOnly; }
+    // False when edits are limited to a non-empty selection missing voxel
+    inline bool isEditable(const glm::ivec3& voxel) const {
+        return !editSelectionOnly || selection.isEmpty() ||
+               selection.test(voxel);
+    }
+
     inline std::vector<float>& getVoxel() { return voxelData; }
+    inline const PaletteUsage& getUsage() const { return usage; }
+    inline IndexFormat getIndexFormat() const { return indexFormat; }
+    inline uint64_t getRevision() const { return revision; }
 
     inline uint32_t* getWidth() { return &width; }
     inline uint32_t* getHeight() { return &height; }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "UploadScheduler.hpp"
+#include "VoxelIndex.hpp"
+#include <bgfx/bgfx.h>
+#include <cstdint>
+#include <deque>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Level-of-detail pyramid of the palette-index volume. Every coarse cell
+// holds the dominant non-empty color of its up to 8 children, so a cell is
+// only empty when all of its children are. Level 0 is the voxel store itself;
+// levels 1..N live here. The GPU copy is one mipmapped 3D texture, R8 or R16
+// per the index format, that starts at the first level no larger than
+// maxTextureEdge per axis, so it stays small whatever the grid extent.
+class VoxelMipChain {
+  public:
+    static constexpr int maxTextureEdge = 256;
+
+  private:
+    struct Slice {
+        int level;
+        glm::ivec3 min, max;
+    };
+
+    glm::ivec3 baseSize = {0, 0, 0};
+    std::vector<glm::ivec3> levelSizes;       // [i] is level i + 1
+    std::vector<std::vector<uint16_t>> levels; // [i] is level i + 1
+    glm::ivec3 textureSize = {0, 0, 0};       // first level, padded to pow2
+    int firstTextureLevel = 1;                // level in texture mip 0
+    IndexFormat indexFormat = IndexFormat::U8;
+
+    bgfx::TextureHandle textureHandle = {bgfx::kInvalidHandle};
+    bgfx::UniformHandle s_lodTexture = {bgfx::kInvalidHandle};
+
+    // Texture regions waiting for upload, at most 32^3 cells each
+    std::deque<Slice> pendingSlices;
+
+    void Downsample(const std::vector<float>& voxels, int level,
+                    const glm::ivec3& cellMin, const glm::ivec3& cellMax);
+    void QueueUpload(int level, const glm::ivec3& cellMin,
+                     const glm::ivec3& cellMax);
+    template <typename T>
+    void Upload(const Slice& slice, const bgfx::Memory* mem);
+
+  public:
+    VoxelMipChain();
+    ~VoxelMipChain();
+
+    void Init();
+    void Destroy();
+    // Takes effect with the next Build()
+    void setIndexFormat(IndexFormat format);
+
+    // Rebuilds every level from scratch, in parallel
+    void Build(const std::vector<float>& voxels, const glm::ivec3& size);
+    // Refreshes only the ancestors of the voxels in [min, max)
+    void Update(const std::vector<float>& voxels, const glm::ivec3& min,
+                const glm::ivec3& max);
+    // Uploads queued slices within the scheduler's budget
+    void Flush(UploadScheduler& scheduler);
+
+    uint16_t getCell(int level, const glm::ivec3& cell) const;
+    inline int getLevelCount() const { return static_cast<int>(levels.size()); }
+    inline size_t getPendingCount() const { return pendingSlices.size(); }
+    inline int getFirstTextureLevel() const { return firstTextureLevel; }
+    inline const glm::ivec3& getTextureSize() const { return textureSize; }
+    inline bgfx::TextureHandle& getTextureHandle() { return textureHandle; }
+    inline bgfx::UniformHandle& getTextureUniform() { return s_lodTexture; }
+};
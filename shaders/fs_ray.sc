@@ -2,12 +2,26 @@ $input v_texcoord0
 #include <bgfx_shader.sh>
 #include <bgfx_compute.sh>
 
-SAMPLER3D(s_voxelTexture, 0); // 3D texture at binding 1
+SAMPLER3D(s_voxelTexture, 0); // brick atlas at binding 1
 BUFFER_RO(paletteBuffer, vec4, 1); // palette buffer at binding 2
+SAMPLER3D(s_lodTexture, 2); // mipmapped LOD levels 1..N at binding 3
+SAMPLER3D(s_pageTable, 3); // brick -> atlas slot at binding 4
+SAMPLER3D(s_occlusionTexture, 4); // baked AO, same layout as the atlas
+SAMPLER3D(s_distanceTexture, 5); // free voxels around each cell
+SAMPLER3D(s_overlayTexture, 6); // tool preview volume
 
 uniform vec4 u_camPos; // camera position
 uniform mat4 u_camMat; // inverse proj view matrix
 uniform vec4 u_gridSize; // xyz: grid dimensions
+uniform vec4 u_lodParams; // x: pixel angle, y: lod bias, z: top level, w: enabled
+uniform vec4 u_lodSize; // xyz: texture size of its first level (power of two), w: that level
+uniform vec4 u_atlasParams; // xyz: brick grid size, w: atlas size in voxels
+uniform vec4 u_aoParams; // x: ambient occlusion strength
+uniform vec4 u_sdfParams; // x: sphere tracing enabled, y: voxels per distance texel
+uniform vec4 u_overlayParams; // xyz: overlay origin in voxels, w: opacity, 0 hidden
+uniform vec4 u_overlaySize; // xyz: overlay size in voxels, w: 1 outline only
+uniform vec4 u_overlayTextureSize; // xyz: overlay texture size
+uniform vec4 u_indexParams; // x: atlas and LOD texel to index / 255 (1 for R8, 257 for R16)
 
 // Safer division that avoids dividing by zero
 vec3 safeDiv(vec3 a, vec3 b) {
@@ -18,6 +32,159 @@ vec3 safeDiv(vec3 a, vec3 b) {
     );
 }
 
+// Palette value of a cell in the LOD chain, lod >= 1. Levels finer than the
+// texture holds read the coarser cell covering them.
+float sampleLod(ivec3 cell, float lod) {
+    float level = max(lod, u_lodSize.w);
+    cell = cell / int(exp2(level - lod) + 0.5);
+    float mip = level - u_lodSize.w;
+    vec3 mipSize = max(vec3_splat(1.0), floor(u_lodSize.xyz / exp2(mip)));
+    return texture3DLod(s_lodTexture, (vec3(cell) + vec3_splat(0.5)) / mipSize, mip).r * u_indexParams.x;
+}
+
+// Page entry of a brick: xyz atlas slot, w 0 empty, 1 streamed out, 2 resident
+vec4 samplePage(ivec3 brick) {
+    return floor(texture3DLod(s_pageTable, (vec3(brick) + vec3_splat(0.5)) / u_atlasParams.xyz, 0.0) * 255.0 + 0.5);
+}
+
+// Palette value of a cell at the given level, level 0 is the full volume
+float sampleVoxel(ivec3 voxel, vec3 cells, float lod) {
+    if (lod > 0.5) {
+        return sampleLod(voxel, lod);
+    }
+    ivec3 brick = voxel / 8;
+    vec4 page = samplePage(brick);
+    if (page.w < 0.5) {
+        return 0.0;
+    }
+    if (page.w < 1.5) {
+        // Not resident, draw the brick with its 8^3 LOD cell, or the top
+        // cell of a chain with fewer levels
+        float level = min(3.0, u_lodParams.z);
+        return sampleLod(voxel / int(exp2(level) + 0.5), level);
+    }
+    vec3 atlasVoxel = page.xyz * 8.0 + vec3(voxel - brick * 8) + vec3_splat(0.5);
+    return texture3DLod(s_voxelTexture, atlasVoxel / u_atlasParams.w, 0.0).r * u_indexParams.x;
+}
+
+// Baked openness of a voxel, 1 where no occlusion data is resident
+float sampleOcclusion(ivec3 voxel, float lod) {
+    ivec3 brick = voxel / 8;
+    vec4 page = samplePage(brick);
+    if (lod > 0.5 || page.w < 1.5) {
+        return 1.0;
+    }
+    vec3 atlasVoxel = page.xyz * 8.0 + vec3(voxel - brick * 8) + vec3_splat(0.5);
+    return texture3DLod(s_occlusionTexture, atlasVoxel / u_atlasParams.w, 0.0).r;
+}
+
+// Ray distance from pos to the next cell boundary on each axis
+vec3 boundaryDistance(vec3 pos, ivec3 voxel, vec3 rayDir, vec3 voxelSize, vec3 volumeMin) {
+    vec3 voxelBoundary = vec3(0.0);
+    for (int i = 0; i < 3; i++) {
+        voxelBoundary[i] = volumeMin[i] + (rayDir[i] > 0.0 ?
+                (voxel[i] + 1) * voxelSize[i] :
+                voxel[i] * voxelSize[i]);
+    }
+    return abs(safeDiv(voxelBoundary - pos, rayDir));
+}
+
+// First overlay voxel along the ray, alpha 0 on a miss. Returns the shaded
+// palette color and the ray distance of the hit in hitT.
+vec4 traceOverlay(vec3 camPos, vec3 rayDir, vec3 voxelSize, vec3 volumeMin, out float hitT) {
+    hitT = 1e30;
+    vec3 boxMin = volumeMin + u_overlayParams.xyz * voxelSize;
+    vec3 boxMax = boxMin + u_overlaySize.xyz * voxelSize;
+    vec3 invDir = safeDiv(vec3_splat(1.0), rayDir);
+    vec3 t0s = (boxMin - camPos) * invDir;
+    vec3 t1s = (boxMax - camPos) * invDir;
+    vec3 tsmaller = min(t0s, t1s);
+    vec3 tbigger = max(t0s, t1s);
+    float tmin = max(0.0, max(tsmaller.x, max(tsmaller.y, tsmaller.z)));
+    float tmax = min(tbigger.x, min(tbigger.y, tbigger.z));
+    if (tmax <= tmin) {
+        return vec4_splat(0.0);
+    }
+
+    vec3 pos = camPos + rayDir * (tmin + 1e-4);
+    ivec3 size = ivec3(u_overlaySize.xyz);
+    ivec3 cell = clamp(ivec3(floor((pos - boxMin) / voxelSize)), ivec3(0, 0, 0), size - ivec3(1, 1, 1));
+    vec3 deltaT = abs(safeDiv(voxelSize, rayDir));
+    ivec3 step = ivec3(sign(rayDir));
+    vec3 tMax = boundaryDistance(pos, cell, rayDir, voxelSize, boxMin);
+    float tEntry = 0.0;
+
+    vec3 normal = vec3(0.0);
+    float eps = 1e-5;
+    if (abs(tmin - tsmaller.x) < eps) normal.x = sign(rayDir.x);
+    if (abs(tmin - tsmaller.y) < eps) normal.y = sign(rayDir.y);
+    if (abs(tmin - tsmaller.z) < eps) normal.z = sign(rayDir.z);
+    for (int i = 0; i < 1024; ++i) {
+        if (any(lessThan(cell, ivec3(0, 0, 0))) || any(greaterThanEqual(cell, size)))
+            break;
+        // R16 texture, 257 = 65535 / 255
+        float value = texture3DLod(s_overlayTexture, (vec3(cell) + vec3_splat(0.5)) / u_overlayTextureSize.xyz, 0.0).r * 257.0;
+        if (value > 0.003) {
+            hitT = tmin + 1e-4 + tEntry;
+            vec4 color = paletteBuffer[int(value * 255.0 + 0.5)];
+            color.rgb *= max(dot(normal, rayDir), 0.1);
+            return vec4(color.rgb, 1.0);
+        }
+        if (tMax.x < tMax.y && tMax.x < tMax.z) {
+            cell.x += step.x;
+            tEntry = tMax.x;
+            tMax.x += deltaT.x;
+            normal = vec3(step.x, 0.0, 0.0);
+        } else if (tMax.y < tMax.z) {
+            cell.y += step.y;
+            tEntry = tMax.y;
+            tMax.y += deltaT.y;
+            normal = vec3(0.0, step.y, 0.0);
+        } else {
+            cell.z += step.z;
+            tEntry = tMax.z;
+            tMax.z += deltaT.z;
+            normal = vec3(0.0, 0.0, step.z);
+        }
+    }
+    return vec4_splat(0.0);
+}
+
+// Edges of the overlay box where the ray enters or leaves it, alpha 0 on a
+// miss. The lines stay about two pixels wide at any distance.
+vec4 traceOverlayOutline(vec3 camPos, vec3 rayDir, vec3 voxelSize, vec3 volumeMin, out float hitT) {
+    hitT = 1e30;
+    vec3 boxMin = volumeMin + u_overlayParams.xyz * voxelSize;
+    vec3 boxMax = boxMin + u_overlaySize.xyz * voxelSize;
+    vec3 invDir = safeDiv(vec3_splat(1.0), rayDir);
+    vec3 t0s = (boxMin - camPos) * invDir;
+    vec3 t1s = (boxMax - camPos) * invDir;
+    vec3 tsmaller = min(t0s, t1s);
+    vec3 tbigger = max(t0s, t1s);
+    float tmin = max(tsmaller.x, max(tsmaller.y, tsmaller.z));
+    float tmax = min(tbigger.x, min(tbigger.y, tbigger.z));
+    if (tmax <= max(tmin, 0.0)) {
+        return vec4_splat(0.0);
+    }
+
+    // Near side first, a point is on an edge when it is close to two faces
+    for (int side = 0; side < 2; ++side) {
+        float t = side == 0 ? tmin : tmax;
+        if (t <= 0.0) {
+            continue;
+        }
+        vec3 local = (camPos + rayDir * t - boxMin) / voxelSize;
+        vec3 border = min(local, u_overlaySize.xyz - local);
+        float width = max(0.05, 2.0 * t * u_lodParams.x / voxelSize.x);
+        vec3 close = step(border, vec3_splat(width));
+        if (close.x + close.y + close.z >= 2.0) {
+            hitT = t;
+            return vec4(1.0, 1.0, 1.0, 1.0);
+        }
+    }
+    return vec4_splat(0.0);
+}
+
 void main() {
     vec3 camPos = u_camPos.xyz;
 
@@ -68,6 +235,18 @@ void main() {
 
     // Calculate voxel size
     vec3 voxelSize = (u_volumeMax - u_volumeMin) / gridSize;
+    vec3 fullVoxelSize = voxelSize;
+
+    // Pick the level whose cells project to about one pixel at the entry
+    float lod = 0.0;
+    if (u_lodParams.w > 0.5) {
+        float footprint = max(tmin, 1e-3) * u_lodParams.x;
+        lod = floor(log2(max(footprint / voxelSize.x, 1.0)) + u_lodParams.y);
+        lod = clamp(lod, 0.0, u_lodParams.z);
+    }
+    float lodScale = exp2(lod);
+    vec3 cells = ceil(gridSize / lodScale);
+    voxelSize *= lodScale;
 
     // Calculate initial voxel indices
     ivec3 voxel = ivec3(floor((pos - u_volumeMin) / voxelSize));
@@ -76,15 +255,9 @@ void main() {
     vec3 deltaT = abs(safeDiv(voxelSize, rayDir));
     ivec3 step = ivec3(sign(rayDir));
 
-    // Calculate initial tMax values
-    vec3 voxelBoundary = vec3(0.0);
-    for (int i = 0; i < 3; i++) {
-        voxelBoundary[i] = u_volumeMin[i] + (rayDir[i] > 0.0 ?
-                (voxel[i] + 1) * voxelSize[i] :
-                voxel[i] * voxelSize[i]);
-    }
-
-    vec3 tMax = abs(safeDiv(voxelBoundary - pos, rayDir));
+    // Calculate initial tMax values, relative to pos like tEntry
+    vec3 tMax = boundaryDistance(pos, voxel, rayDir, voxelSize, u_volumeMin);
+    float tEntry = 0.0;
 
     vec3 hitNormal = vec3(0.0);
     float eps = 1e-5;
@@ -94,47 +267,76 @@ void main() {
     if (abs(tmin - t1s.y) < eps) hitNormal.y = -1.0;
     if (abs(tmin - t0s.z) < eps) hitNormal.z = 1.0;
     if (abs(tmin - t1s.z) < eps) hitNormal.z = -1.0;
+    // Nearest surface so far and its ray distance, the overlay is blended
+    // over it at the end
+    vec4 result = bgColor;
+    float resultT = 1e30;
+    bool hit = false;
+
     // Ray marching through the grid
     const int maxSteps = 1024;
     for (int i = 0; i < maxSteps; ++i)
     {
         // Check if current voxel is inside the grid
-        if (any(lessThan(voxel, ivec3(0))) || any(greaterThanEqual(voxel, ivec3(gridSize))))
+        if (any(lessThan(voxel, ivec3(0))) || any(greaterThanEqual(voxel, ivec3(cells))))
             break;
 
         // Sample voxel data
-        vec3 texCoord = (vec3(voxel) + vec3(0.5)) / gridSize;
-        float voxelValue = texture3D(s_voxelTexture, texCoord).r;
+        float voxelValue = sampleVoxel(voxel, cells, lod);
 
         // If we hit a solid voxel, render it
         if (voxelValue > 0.003)
         {
             // Fetch color from palette buffer
-            float index = voxelValue * 255.0; // Voxel values are in [0, 1]
-            vec4 color = paletteBuffer[int(index)];
+            float index = voxelValue * 255.0; // Voxel values are index / 255
+            vec4 color = paletteBuffer[int(index + 0.5)];
             // Lambertian shading based on normal
             float lightIntensity = max(dot(hitNormal, rayDir), 0.1);
             color.rgb *= lightIntensity;
-            gl_FragColor = color;
-            return;
+            // Open faces sit around 0.4 openness, so that maps to about 0.8
+            float ao = saturate(sampleOcclusion(voxel, lod) * 2.0);
+            color.rgb *= mix(1.0, ao, u_aoParams.x);
+            result = color;
+            resultT = dot(pos - camPos, rayDir) + tEntry;
+            hit = true;
+            break;
+        }
+
+        // Leap through empty space. The distance is between voxel centers,
+        // the ray point and the nearest solid cube each take off up to
+        // sqrt(3)/2 of it, so leaping two voxels less never skips a surface
+        if (u_sdfParams.x > 0.5 && lod < 0.5) {
+            vec3 sdfSize = ceil(gridSize / u_sdfParams.y);
+            vec3 sdfTexel = floor(vec3(voxel) / u_sdfParams.y) + vec3_splat(0.5);
+            float freeVoxels = texture3DLod(s_distanceTexture, sdfTexel / sdfSize, 0.0).r * 255.0;
+            if (freeVoxels >= 3.0) {
+                pos += rayDir * (tEntry + (freeVoxels - 2.0) * voxelSize.x);
+                voxel = ivec3(floor((pos - u_volumeMin) / voxelSize));
+                tMax = boundaryDistance(pos, voxel, rayDir, voxelSize, u_volumeMin);
+                tEntry = 0.0;
+                continue;
+            }
         }
 
         // Find the next voxel to step to
         if (tMax.x < tMax.y && tMax.x < tMax.z)
         {
             voxel.x += step.x;
+            tEntry = tMax.x;
             tMax.x += deltaT.x;
             hitNormal = vec3(step.x, 0.0, 0.0);
         }
         else if (tMax.y < tMax.z)
         {
             voxel.y += step.y;
+            tEntry = tMax.y;
             tMax.y += deltaT.y;
             hitNormal = vec3(0.0, step.y, 0.0);
         }
         else
         {
             voxel.z += step.z;
+            tEntry = tMax.z;
             tMax.z += deltaT.z;
             hitNormal = vec3(0.0, 0.0, step.z);
         }
@@ -145,7 +347,7 @@ void main() {
     const float u_lineWidth = 0.03f; // Width of the grid lines
     const float planeY = 0.0;
     float denom = rayDir.y;
-    if (abs(denom) > epsilon) {
+    if (!hit && abs(denom) > epsilon) {
         float tPlane = (planeY - camPos.y) / denom;
 
         if (tPlane >= tmin && tPlane <= tmax) {
@@ -166,11 +368,21 @@ void main() {
             // Lines are white and background is bgcolor
             vec3 color = mix(vec3(1.0), bgColor.rgb, linee);
 
-            gl_FragColor = vec4(color, 1.0);
-            return;
+            result = vec4(color, 1.0);
+            resultT = tPlane;
+        }
+    }
+
+    // Ghost of the tool preview, drawn on top of coplanar surfaces
+    if (u_overlayParams.w > 0.0) {
+        float ghostT;
+        vec4 ghost = u_overlaySize.w > 0.0
+            ? traceOverlayOutline(camPos, rayDir, fullVoxelSize, u_volumeMin, ghostT)
+            : traceOverlay(camPos, rayDir, fullVoxelSize, u_volumeMin, ghostT);
+        if (ghost.a > 0.0 && ghostT <= resultT + 1e-3) {
+            result.rgb = mix(result.rgb, ghost.rgb, u_overlayParams.w);
         }
     }
 
-    // If we didn't hit anything
-    gl_FragColor = bgColor;
+    gl_FragColor = result;
 }
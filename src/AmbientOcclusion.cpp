@@ -0,0 +1,130 @@
+#include "AmbientOcclusion.hpp"
+#include "Parallel.hpp"
+#include "glm/common.hpp"
+#include <algorithm>
+
+AmbientOcclusion::AmbientOcclusion() {}
+
+AmbientOcclusion::~AmbientOcclusion() {}
+
+void AmbientOcclusion::Build(const std::vector<float>& voxels,
+                             const glm::ivec3& size) {
+    this->size = size;
+    values.assign(size_t(size.x) * size.y * size.z, 0);
+    BakeTiles(voxels, glm::ivec3(0), size);
+}
+
+void AmbientOcclusion::Update(const std::vector<float>& voxels,
+                              const glm::ivec3& min, const glm::ivec3& max) {
+    BakeTiles(voxels, glm::max(min - radius, glm::ivec3(0)),
+              glm::min(max + radius, size));
+}
+
+void AmbientOcclusion::BakeTiles(const std::vector<float>& voxels,
+                                 const glm::ivec3& min, const glm::ivec3& max) {
+    if (glm::any(glm::greaterThanEqual(min, max))) {
+        return;
+    }
+    const glm::ivec3 tileMin = min / tileSize;
+    const glm::ivec3 tileMax = (max - 1) / tileSize + 1;
+    const glm::ivec3 tiles = tileMax - tileMin;
+    Parallel::For(0, tiles.x * tiles.y * tiles.z, [&](uint32_t i) {
+        glm::ivec3 tile(i % tiles.x, (i / tiles.x) % tiles.y,
+                        i / (tiles.x * tiles.y));
+        BakeTile(voxels, tileMin + tile);
+    });
+}
+
+void AmbientOcclusion::BakeTile(const std::vector<float>& voxels,
+                                const glm::ivec3& tile) {
+    const glm::ivec3 start = tile * tileSize;
+    const glm::ivec3 end = glm::min(start + tileSize, size);
+    // Occupancy of the tile plus a halo of radius, outside the grid is empty
+    const glm::ivec3 haloMin = start - radius;
+    const glm::ivec3 ext = end - start + 2 * radius;
+    auto at = [&](int x, int y, int z) {
+        return (size_t(z) * ext.y + y) * ext.x + x;
+    };
+
+    std::vector<uint8_t> occupancy(size_t(ext.x) * ext.y * ext.z, 0);
+    bool any = false;
+    for (int z = 0; z < ext.z; ++z) {
+        int vz = haloMin.z + z;
+        if (vz < 0 || vz >= size.z) {
+            continue;
+        }
+        for (int y = 0; y < ext.y; ++y) {
+            int vy = haloMin.y + y;
+            if (vy < 0 || vy >= size.y) {
+                continue;
+            }
+            size_t row = (size_t(vz) * size.y + vy) * size.x;
+            for (int x = 0; x < ext.x; ++x) {
+                int vx = haloMin.x + x;
+                if (vx >= 0 && vx < size.x && voxels[row + vx] > 0.003f) {
+                    occupancy[at(x, y, z)] = 1;
+                    any = true;
+                }
+            }
+        }
+    }
+    if (!any) {
+        for (int z = start.z; z < end.z; ++z) {
+            for (int y = start.y; y < end.y; ++y) {
+                size_t row = (size_t(z) * size.y + y) * size.x;
+                std::fill(&values[row + start.x], &values[row + end.x], 0);
+            }
+        }
+        return;
+    }
+
+    // Box sums along x, then y, then z; each pass shrinks the valid range
+    // of its axis by the radius on both sides, counts stay below 125
+    std::vector<uint8_t> sums(occupancy.size(), 0);
+    for (int z = 0; z < ext.z; ++z) {
+        for (int y = 0; y < ext.y; ++y) {
+            for (int x = radius; x < ext.x - radius; ++x) {
+                uint8_t sum = 0;
+                for (int d = -radius; d <= radius; ++d) {
+                    sum += occupancy[at(x + d, y, z)];
+                }
+                sums[at(x, y, z)] = sum;
+            }
+        }
+    }
+    for (int z = 0; z < ext.z; ++z) {
+        for (int y = radius; y < ext.y - radius; ++y) {
+            for (int x = radius; x < ext.x - radius; ++x) {
+                uint8_t sum = 0;
+                for (int d = -radius; d <= radius; ++d) {
+                    sum += sums[at(x, y + d, z)];
+                }
+                occupancy[at(x, y, z)] = sum;
+            }
+        }
+    }
+
+    const int neighbors = (2 * radius + 1) * (2 * radius + 1) *
+                              (2 * radius + 1) -
+                          1;
+    for (int z = start.z; z < end.z; ++z) {
+        for (int y = start.y; y < end.y; ++y) {
+            size_t row = (size_t(z) * size.y + y) * size.x;
+            for (int x = start.x; x < end.x; ++x) {
+                if (voxels[row + x] <= 0.003f) {
+                    values[row + x] = 0;
+                    continue;
+                }
+                const int lx = x - haloMin.x;
+                const int ly = y - haloMin.y;
+                const int lz = z - haloMin.z;
+                int solid = -1; // the voxel itself
+                for (int d = -radius; d <= radius; ++d) {
+                    solid += occupancy[at(lx, ly, lz + d)];
+                }
+                values[row + x] =
+                    static_cast<uint8_t>((neighbors - solid) * 255 / neighbors);
+            }
+        }
+    }
+}
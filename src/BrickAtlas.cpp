@@ -0,0 +1,376 @@
+#include "BrickAtlas.hpp"
+#include "Parallel.hpp"
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include <algorithm>
+#include <iostream>
+
+BrickAtlas::BrickAtlas() {}
+
+BrickAtlas::~BrickAtlas() {}
+
+void BrickAtlas::Init(int slotsPerAxis) {
+    this->slotsPerAxis = slotsPerAxis;
+    const int size = getAtlasSize();
+    CreateAtlasTexture();
+    occlusionTexture = bgfx::createTexture3D(
+        size, size, size, false, bgfx::TextureFormat::R8,
+        BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP, nullptr);
+    s_pageTable =
+        bgfx::createUniform("s_pageTable", bgfx::UniformType::Sampler);
+    s_occlusionTexture = bgfx::createUniform("s_occlusionTexture",
+                                             bgfx::UniformType::Sampler);
+}
+
+void BrickAtlas::CreateAtlasTexture() {
+    if (bgfx::isValid(atlasTexture)) {
+        bgfx::destroy(atlasTexture);
+    }
+    const int size = getAtlasSize();
+    const bgfx::TextureFormat::Enum format =
+        DispatchIndex(indexFormat, [](auto zero) {
+            return VoxelIndex<decltype(zero)>::textureFormat;
+        });
+    atlasTexture = bgfx::createTexture3D(
+        size, size, size, false, format,
+        BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP, nullptr);
+}
+
+void BrickAtlas::setIndexFormat(IndexFormat format) {
+    if (format == indexFormat) {
+        return;
+    }
+    indexFormat = format;
+    if (bgfx::isValid(atlasTexture)) {
+        CreateAtlasTexture();
+    }
+}
+
+void BrickAtlas::Destroy() {
+    if (bgfx::isValid(s_pageTable)) {
+        bgfx::destroy(s_pageTable);
+        s_pageTable.idx = bgfx::kInvalidHandle;
+    }
+    if (bgfx::isValid(s_occlusionTexture)) {
+        bgfx::destroy(s_occlusionTexture);
+        s_occlusionTexture.idx = bgfx::kInvalidHandle;
+    }
+    if (bgfx::isValid(pageTexture)) {
+        bgfx::destroy(pageTexture);
+        pageTexture.idx = bgfx::kInvalidHandle;
+    }
+    if (bgfx::isValid(occlusionTexture)) {
+        bgfx::destroy(occlusionTexture);
+        occlusionTexture.idx = bgfx::kInvalidHandle;
+    }
+    if (bgfx::isValid(atlasTexture)) {
+        bgfx::destroy(atlasTexture);
+        atlasTexture.idx = bgfx::kInvalidHandle;
+    }
+    occupied.clear();
+    queued.clear();
+    pendingBricks.clear();
+    brickSlot.clear();
+    slotBrick.clear();
+    freeSlots.clear();
+    pageTable.clear();
+}
+
+void BrickAtlas::Build(const std::vector<float>& voxels,
+                       const glm::ivec3& size) {
+    gridSize = size;
+    glm::ivec3 newBrickGrid = (size + brickSize - 1) / brickSize;
+    const size_t brickCount =
+        size_t(newBrickGrid.x) * newBrickGrid.y * newBrickGrid.z;
+    if (newBrickGrid != brickGrid || !bgfx::isValid(pageTexture)) {
+        if (bgfx::isValid(pageTexture)) {
+            bgfx::destroy(pageTexture);
+        }
+        brickGrid = newBrickGrid;
+        pageTexture = bgfx::createTexture3D(
+            brickGrid.x, brickGrid.y, brickGrid.z, false,
+            bgfx::TextureFormat::RGBA8,
+            BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP, nullptr);
+    }
+
+    occupied.assign(brickCount, 0);
+    Parallel::For(0, brickCount, [&](uint32_t b) {
+        occupied[b] = ScanBrick(voxels, BrickCoord(b));
+    });
+
+    brickSlot.assign(brickCount, -1);
+    slotBrick.assign(getSlotCount(), -1);
+    freeSlots.resize(getSlotCount());
+    for (int i = 0; i < getSlotCount(); ++i) {
+        freeSlots[i] = getSlotCount() - 1 - i;
+    }
+    pageTable.assign(brickCount, 0);
+    queued.assign(brickCount, 0);
+    pendingBricks.clear();
+
+    // Bricks start out non-resident and turn resident as Flush() streams
+    // them in, the LOD chain covers them meanwhile
+    oversubscribed = false;
+    for (size_t b = 0; b < brickCount; ++b) {
+        if (occupied[b] && !MakeResident(b)) {
+            SetPage(b, NonResident);
+            oversubscribed = true;
+        }
+    }
+    residencyDirty = oversubscribed;
+    MarkPages(glm::ivec3(0), brickGrid);
+
+    if (oversubscribed) {
+        std::cerr << "Brick atlas full: " << getSlotCount()
+                  << " slots for more occupied bricks, streaming by distance"
+                  << std::endl;
+    }
+}
+
+void BrickAtlas::Update(const std::vector<float>& voxels,
+                        const glm::ivec3& min, const glm::ivec3& max) {
+    const glm::ivec3 brickMin = min / brickSize;
+    const glm::ivec3 brickMax =
+        glm::min((max - 1) / brickSize + 1, brickGrid);
+    for (int z = brickMin.z; z < brickMax.z; ++z) {
+        for (int y = brickMin.y; y < brickMax.y; ++y) {
+            for (int x = brickMin.x; x < brickMax.x; ++x) {
+                const glm::ivec3 brick(x, y, z);
+                const size_t b = BrickIndex(brick);
+                occupied[b] = ScanBrick(voxels, brick);
+                if (!occupied[b]) {
+                    Evict(b);
+                    SetPage(b, Empty);
+                } else if (brickSlot[b] >= 0) {
+                    QueueBrick(b);
+                } else if (!MakeResident(b)) {
+                    SetPage(b, NonResident);
+                    oversubscribed = true;
+                    residencyDirty = true;
+                }
+            }
+        }
+    }
+    MarkPages(brickMin, brickMax);
+}
+
+void BrickAtlas::UpdateResidency() {
+    if (!oversubscribed) {
+        return;
+    }
+    // Only reshuffle when the viewer moved a few bricks
+    if (!residencyDirty &&
+        glm::length(viewer - residencyViewer) < brickSize * 4.0f) {
+        return;
+    }
+    residencyViewer = viewer;
+    residencyDirty = false;
+
+    std::vector<std::pair<float, int32_t>> candidates;
+    for (size_t b = 0; b < occupied.size(); ++b) {
+        if (!occupied[b]) {
+            continue;
+        }
+        glm::vec3 center = (glm::vec3(BrickCoord(b)) + 0.5f) * float(brickSize);
+        glm::vec3 delta = center - viewer;
+        candidates.emplace_back(glm::dot(delta, delta),
+                                static_cast<int32_t>(b));
+    }
+
+    const size_t capacity = getSlotCount();
+    if (candidates.size() > capacity) {
+        std::nth_element(candidates.begin(), candidates.begin() + capacity,
+                         candidates.end());
+        // Evict resident bricks that are no longer among the closest
+        for (size_t i = capacity; i < candidates.size(); ++i) {
+            size_t b = candidates[i].second;
+            if (brickSlot[b] >= 0) {
+                Evict(b);
+                SetPage(b, NonResident);
+            }
+        }
+        candidates.resize(capacity);
+    } else {
+        oversubscribed = false;
+    }
+    for (const auto& candidate : candidates) {
+        if (brickSlot[candidate.second] < 0) {
+            MakeResident(candidate.second);
+        }
+    }
+    MarkPages(glm::ivec3(0), brickGrid);
+}
+
+void BrickAtlas::Flush(const std::vector<float>& voxels,
+                       const std::vector<uint8_t>& occlusion,
+                       UploadScheduler& scheduler) {
+    const uint32_t brickVoxels = brickSize * brickSize * brickSize;
+    const uint32_t indexBytes = indexFormat == IndexFormat::U16 ? 2 : 1;
+    while (!pendingBricks.empty()) {
+        const size_t b = pendingBricks.front();
+        if (brickSlot[b] < 0) {
+            // Evicted while waiting
+            queued[b] = 0;
+            pendingBricks.pop_front();
+            continue;
+        }
+        // Voxels and occlusion go out in the same frame or wait together
+        const bgfx::Memory* mems[2];
+        if (!scheduler.Allocate({brickVoxels * indexBytes, brickVoxels},
+                                mems)) {
+            break;
+        }
+        const bgfx::Memory* mem = mems[0];
+        UploadBrick<uint8_t>(occlusionTexture, occlusion, b, mems[1]);
+        queued[b] = 0;
+        pendingBricks.pop_front();
+        DispatchIndex(indexFormat, [&](auto zero) {
+            UploadBrick<decltype(zero)>(atlasTexture, voxels, b, mem);
+        });
+        if ((pageTable[b] >> 24) != Resident) {
+            SetPage(b, Resident);
+            const glm::ivec3 brick = BrickCoord(b);
+            MarkPages(brick, brick + 1);
+        }
+    }
+    UploadPages();
+}
+
+BrickAtlas::PageState BrickAtlas::getPageState(const glm::ivec3& brick) const {
+    if (glm::any(glm::lessThan(brick, glm::ivec3(0))) ||
+        glm::any(glm::greaterThanEqual(brick, brickGrid))) {
+        return Empty;
+    }
+    return static_cast<PageState>(pageTable[BrickIndex(brick)] >> 24);
+}
+
+bool BrickAtlas::ScanBrick(const std::vector<float>& voxels,
+                           const glm::ivec3& brick) const {
+    const glm::ivec3 start = brick * brickSize;
+    const glm::ivec3 end = glm::min(start + brickSize, gridSize);
+    for (int z = start.z; z < end.z; ++z) {
+        for (int y = start.y; y < end.y; ++y) {
+            size_t row = (size_t(z) * gridSize.y + y) * gridSize.x;
+            for (int x = start.x; x < end.x; ++x) {
+                if (voxels[row + x] > 0.003f) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool BrickAtlas::MakeResident(size_t brick) {
+    if (freeSlots.empty()) {
+        return false;
+    }
+    int32_t slot = freeSlots.back();
+    freeSlots.pop_back();
+    brickSlot[brick] = slot;
+    slotBrick[slot] = static_cast<int32_t>(brick);
+    // The slot still holds stale data until the upload went through
+    SetPage(brick, NonResident);
+    QueueBrick(brick);
+    return true;
+}
+
+void BrickAtlas::QueueBrick(size_t brick) {
+    if (!queued[brick]) {
+        queued[brick] = 1;
+        pendingBricks.push_back(static_cast<int32_t>(brick));
+    }
+}
+
+void BrickAtlas::Evict(size_t brick) {
+    int32_t slot = brickSlot[brick];
+    if (slot < 0) {
+        return;
+    }
+    brickSlot[brick] = -1;
+    slotBrick[slot] = -1;
+    freeSlots.push_back(slot);
+}
+
+void BrickAtlas::SetPage(size_t brick, PageState state) {
+    uint32_t entry = uint32_t(state) << 24;
+    int32_t slot = brickSlot[brick];
+    if (state == Resident && slot >= 0) {
+        entry |= uint32_t(slot % slotsPerAxis);
+        entry |= uint32_t((slot / slotsPerAxis) % slotsPerAxis) << 8;
+        entry |= uint32_t(slot / (slotsPerAxis * slotsPerAxis)) << 16;
+    }
+    pageTable[brick] = entry;
+}
+
+template <typename T, typename S>
+void BrickAtlas::UploadBrick(bgfx::TextureHandle texture,
+                             const std::vector<S>& source, size_t brick,
+                             const bgfx::Memory* mem) {
+    const int32_t slot = brickSlot[brick];
+    const glm::ivec3 start = BrickCoord(brick) * brickSize;
+    const glm::ivec3 end = glm::min(start + brickSize, gridSize);
+
+    T* dst = reinterpret_cast<T*>(mem->data);
+    std::fill_n(dst, brickSize * brickSize * brickSize, T(0));
+    for (int z = start.z; z < end.z; ++z) {
+        for (int y = start.y; y < end.y; ++y) {
+            size_t row = (size_t(z) * gridSize.y + y) * gridSize.x;
+            T* out = dst + ((z - start.z) * brickSize + (y - start.y)) *
+                               brickSize;
+            if constexpr (std::is_same_v<T, S>) {
+                std::copy(&source[row + start.x], &source[row + end.x], out);
+            } else {
+                std::transform(&source[row + start.x], &source[row + end.x],
+                               out, VoxelIndex<T>::Encode);
+            }
+        }
+    }
+
+    const glm::ivec3 slotCoord(slot % slotsPerAxis,
+                               (slot / slotsPerAxis) % slotsPerAxis,
+                               slot / (slotsPerAxis * slotsPerAxis));
+    const glm::ivec3 offset = slotCoord * brickSize;
+    bgfx::updateTexture3D(texture, 0, offset.x, offset.y, offset.z, brickSize,
+                          brickSize, brickSize, mem);
+}
+
+void BrickAtlas::MarkPages(const glm::ivec3& min, const glm::ivec3& max) {
+    if (!pagesDirty) {
+        pageDirtyMin = min;
+        pageDirtyMax = max;
+        pagesDirty = true;
+    } else {
+        pageDirtyMin = glm::min(pageDirtyMin, min);
+        pageDirtyMax = glm::max(pageDirtyMax, max);
+    }
+}
+
+// The page table is small next to the brick data, so it goes out in one
+// coalesced update per frame instead of through the budgeted ring
+void BrickAtlas::UploadPages() {
+    if (!pagesDirty) {
+        return;
+    }
+    pagesDirty = false;
+    const glm::ivec3 min = pageDirtyMin;
+    const glm::ivec3 max = pageDirtyMax;
+    if (!bgfx::isValid(pageTexture) ||
+        glm::any(glm::greaterThanEqual(min, max))) {
+        return;
+    }
+    const glm::ivec3 extent = max - min;
+    const bgfx::Memory* mem =
+        bgfx::alloc(extent.x * extent.y * extent.z * sizeof(uint32_t));
+    uint32_t* dst = reinterpret_cast<uint32_t*>(mem->data);
+    for (int z = min.z; z < max.z; ++z) {
+        for (int y = min.y; y < max.y; ++y) {
+            const uint32_t* src =
+                &pageTable[BrickIndex(glm::ivec3(min.x, y, z))];
+            std::copy_n(src, extent.x, dst);
+            dst += extent.x;
+        }
+    }
+    bgfx::updateTexture3D(pageTexture, 0, min.x, min.y, min.z, extent.x,
+                          extent.y, extent.z, mem);
+}
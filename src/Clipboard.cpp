@@ -0,0 +1,170 @@
+#include "Clipboard.hpp"
+#include "Parallel.hpp"
+#include "glm/common.hpp"
+
+Clipboard::Clipboard() {}
+
+Clipboard::~Clipboard() {}
+
+void Clipboard::Clear() {
+    size = glm::ivec3(0);
+    bricks.clear();
+    runs.clear();
+    voxelCount = 0;
+}
+
+void Clipboard::Copy(const std::vector<float>& voxels,
+                     const glm::ivec3& volumeSize, const glm::ivec3& min,
+                     const glm::ivec3& max, const SelectionMask* selection) {
+    Clear();
+    const glm::ivec3 regionMin = glm::clamp(min, glm::ivec3(0), volumeSize);
+    const glm::ivec3 regionMax = glm::clamp(max, regionMin, volumeSize);
+    if (glm::any(glm::greaterThanEqual(regionMin, regionMax))) {
+        return;
+    }
+    size = regionMax - regionMin;
+
+    // Every brick encodes its own runs, x fastest, then they are joined
+    const glm::ivec3 grid = (size + brickSize - 1) / brickSize;
+    const uint32_t brickCount = grid.x * grid.y * grid.z;
+    std::vector<std::vector<Run>> brickRuns(brickCount);
+    std::vector<uint32_t> brickVoxels(brickCount, 0);
+    Parallel::For(
+        0, brickCount,
+        [&](uint32_t b) {
+            const glm::ivec3 offset =
+                glm::ivec3(b % grid.x, (b / grid.x) % grid.y,
+                           b / (grid.x * grid.y)) *
+                brickSize;
+            const glm::ivec3 end = glm::min(offset + brickSize, size);
+            std::vector<Run>& out = brickRuns[b];
+            uint32_t solid = 0;
+            for (int z = offset.z; z < end.z; ++z) {
+                for (int y = offset.y; y < end.y; ++y) {
+                    for (int x = offset.x; x < end.x; ++x) {
+                        const glm::ivec3 voxel = regionMin + glm::ivec3(x, y, z);
+                        size_t index =
+                            (size_t(voxel.z) * volumeSize.y + voxel.y) *
+                                volumeSize.x +
+                            voxel.x;
+                        uint16_t value = 0;
+                        if (voxels[index] > 0.003f &&
+                            (!selection || selection->test(voxel))) {
+                            value = VoxelIndex<uint16_t>::Encode(voxels[index]);
+                            ++solid;
+                        }
+                        if (!out.empty() && out.back().value == value) {
+                            ++out.back().length;
+                        } else {
+                            out.push_back({1, value});
+                        }
+                    }
+                }
+            }
+            brickVoxels[b] = solid;
+            if (solid == 0) {
+                out.clear();
+            }
+        },
+        8);
+
+    for (uint32_t b = 0; b < brickCount; ++b) {
+        if (brickVoxels[b] == 0) {
+            continue;
+        }
+        const glm::ivec3 offset =
+            glm::ivec3(b % grid.x, (b / grid.x) % grid.y,
+                       b / (grid.x * grid.y)) *
+            brickSize;
+        bricks.push_back({offset, static_cast<uint32_t>(runs.size()),
+                          static_cast<uint32_t>(brickRuns[b].size())});
+        runs.insert(runs.end(), brickRuns[b].begin(), brickRuns[b].end());
+        voxelCount += brickVoxels[b];
+    }
+    if (voxelCount == 0) {
+        Clear();
+    }
+}
+
+void Clipboard::Paste(VoxelManager& voxelManager,
+                      const glm::ivec3& origin) const {
+    if (isEmpty()) {
+        return;
+    }
+    const glm::ivec3 volumeSize = glm::ivec3(voxelManager.getSize());
+    std::vector<float>& voxels = voxelManager.getVoxel();
+
+    // Bricks cover disjoint voxels, so they are written in parallel
+    std::vector<glm::ivec3> brickMin(bricks.size(), volumeSize);
+    std::vector<glm::ivec3> brickMax(bricks.size(), glm::ivec3(0));
+    Parallel::For(
+        0, static_cast<uint32_t>(bricks.size()),
+        [&](uint32_t b) {
+            const Brick& brick = bricks[b];
+            const glm::ivec3 extent =
+                glm::min(brick.offset + brickSize, size) - brick.offset;
+            VoxelManager::UsageDelta delta = voxelManager.newUsageDelta();
+            uint32_t cell = 0;
+            for (uint32_t r = 0; r < brick.runCount; ++r) {
+                const Run& run = runs[brick.firstRun + r];
+                if (run.value == 0) {
+                    cell += run.length;
+                    continue;
+                }
+                const float value = VoxelIndex<uint16_t>::Decode(run.value);
+                for (uint32_t end = cell + run.length; cell < end; ++cell) {
+                    const glm::ivec3 local(cell % extent.x,
+                                           (cell / extent.x) % extent.y,
+                                           cell / (extent.x * extent.y));
+                    const glm::ivec3 voxel = origin + brick.offset + local;
+                    if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) ||
+                        glm::any(glm::greaterThanEqual(voxel, volumeSize)) ||
+                        !voxelManager.isEditable(voxel)) {
+                        continue;
+                    }
+                    float& target =
+                        voxels[(size_t(voxel.z) * volumeSize.y + voxel.y) *
+                                   volumeSize.x +
+                               voxel.x];
+                    VoxelManager::countChange(delta, target, value);
+                    target = value;
+                    brickMin[b] = glm::min(brickMin[b], voxel);
+                    brickMax[b] = glm::max(brickMax[b], voxel + 1);
+                }
+            }
+            voxelManager.applyUsage(delta);
+        },
+        4);
+
+    glm::ivec3 min = volumeSize;
+    glm::ivec3 max(0);
+    for (size_t b = 0; b < bricks.size(); ++b) {
+        min = glm::min(min, brickMin[b]);
+        max = glm::max(max, brickMax[b]);
+    }
+    voxelManager.markDirty(min, max);
+}
+
+void Clipboard::Decode(std::vector<uint16_t>& values) const {
+    values.assign(size_t(size.x) * size.y * size.z, 0);
+    for (const Brick& brick : bricks) {
+        const glm::ivec3 extent =
+            glm::min(brick.offset + brickSize, size) - brick.offset;
+        uint32_t cell = 0;
+        for (uint32_t r = 0; r < brick.runCount; ++r) {
+            const Run& run = runs[brick.firstRun + r];
+            if (run.value == 0) {
+                cell += run.length;
+                continue;
+            }
+            for (uint32_t end = cell + run.length; cell < end; ++cell) {
+                const glm::ivec3 voxel =
+                    brick.offset + glm::ivec3(cell % extent.x,
+                                              (cell / extent.x) % extent.y,
+                                              cell / (extent.x * extent.y));
+                values[(size_t(voxel.z) * size.y + voxel.y) * size.x +
+                       voxel.x] = run.value;
+            }
+        }
+    }
+}
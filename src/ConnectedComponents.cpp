@@ -0,0 +1,240 @@
+#include "ConnectedComponents.hpp"
+#include "Parallel.hpp"
+#include "glm/common.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t kEmpty = 0xFFFFFFFFu;
+constexpr uint32_t kRootFlag = 0x80000000u;
+
+inline uint32_t Load(std::vector<uint32_t>& parent, uint32_t i) {
+    return std::atomic_ref<uint32_t>(parent[i]).load(std::memory_order_relaxed);
+}
+
+// Root of i, halving the path on the way
+inline uint32_t Find(std::vector<uint32_t>& parent, uint32_t i) {
+    while (true) {
+        uint32_t p = Load(parent, i);
+        if (p == i) {
+            return i;
+        }
+        uint32_t gp = Load(parent, p);
+        if (gp != p) {
+            std::atomic_ref<uint32_t>(parent[i]).compare_exchange_weak(
+                p, gp, std::memory_order_relaxed);
+        }
+        i = gp;
+    }
+}
+
+// Links the larger root below the smaller one; the CAS only succeeds while
+// that root is still a root, so concurrent unions never lose a link
+inline void Union(std::vector<uint32_t>& parent, uint32_t a, uint32_t b) {
+    while (true) {
+        a = Find(parent, a);
+        b = Find(parent, b);
+        if (a == b) {
+            return;
+        }
+        if (a < b) {
+            std::swap(a, b);
+        }
+        uint32_t expected = a;
+        if (std::atomic_ref<uint32_t>(parent[a]).compare_exchange_strong(
+                expected, b, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+// Single-threaded variants for the tile pass, where no other thread can
+// reach the same trees
+inline uint32_t FindLocal(std::vector<uint32_t>& parent, uint32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+inline void UnionLocal(std::vector<uint32_t>& parent, uint32_t a, uint32_t b) {
+    a = FindLocal(parent, a);
+    b = FindLocal(parent, b);
+    if (a != b) {
+        parent[std::max(a, b)] = std::min(a, b);
+    }
+}
+
+} // namespace
+
+ConnectedComponents::ConnectedComponents() {}
+
+ConnectedComponents::~ConnectedComponents() {}
+
+void ConnectedComponents::Label(const std::vector<float>& voxels,
+                                const glm::ivec3& size, uint64_t revision) {
+    if (revision == this->revision && size == this->size) {
+        return;
+    }
+    this->revision = revision;
+    this->size = size;
+
+    const size_t count = size_t(size.x) * size.y * size.z;
+    const size_t sliceStride = size_t(size.x) * size.y;
+    if (count >= kRootFlag) {
+        std::cerr << "Volume too large to label: " << count << " voxels"
+                  << std::endl;
+        labels.clear();
+        sizes.clear();
+        largest = 0;
+        return;
+    }
+    // Every entry is written by the tile pass, so only grow the buffer
+    labels.resize(count);
+
+    // Union inside every tile; tiles touch disjoint voxels
+    const glm::ivec3 tiles = (size + tileSize - 1) / tileSize;
+    Parallel::For(0, tiles.x * tiles.y * tiles.z, [&](uint32_t t) {
+        const glm::ivec3 tile(t % tiles.x, (t / tiles.x) % tiles.y,
+                              t / (tiles.x * tiles.y));
+        const glm::ivec3 start = tile * tileSize;
+        const glm::ivec3 end = glm::min(start + tileSize, size);
+        for (int z = start.z; z < end.z; ++z) {
+            for (int y = start.y; y < end.y; ++y) {
+                size_t row = z * sliceStride + size_t(y) * size.x;
+                for (int x = start.x; x < end.x; ++x) {
+                    const uint32_t i = static_cast<uint32_t>(row + x);
+                    if (voxels[i] <= 0.003f) {
+                        labels[i] = kEmpty;
+                        continue;
+                    }
+                    // Continue the run to the left, join the rest
+                    if (x > start.x && labels[i - 1] != kEmpty) {
+                        labels[i] = labels[i - 1];
+                    } else {
+                        labels[i] = i;
+                    }
+                    if (y > start.y && labels[i - size.x] != kEmpty) {
+                        UnionLocal(labels, i, i - size.x);
+                    }
+                    if (z > start.z && labels[i - sliceStride] != kEmpty) {
+                        UnionLocal(labels, i, i - sliceStride);
+                    }
+                }
+            }
+        }
+    });
+
+    // Merge across tile borders, visiting only the voxels on a tile's
+    // lower face; every (axis, plane) pair is an independent task
+    const int planes[3] = {tiles.x - 1, tiles.y - 1, tiles.z - 1};
+    const size_t strides[3] = {1, size_t(size.x), sliceStride};
+    Parallel::For(0, planes[0] + planes[1] + planes[2], [&](uint32_t task) {
+        int axis = 0;
+        while (task >= uint32_t(planes[axis])) {
+            task -= planes[axis++];
+        }
+        const int u = axis == 0 ? 1 : 0;
+        const int v = axis == 2 ? 1 : 2;
+        glm::ivec3 voxel(0);
+        voxel[axis] = (task + 1) * tileSize;
+        for (int b = 0; b < size[v]; ++b) {
+            voxel[v] = b;
+            for (int a = 0; a < size[u]; ++a) {
+                voxel[u] = a;
+                const uint32_t i = static_cast<uint32_t>(
+                    voxel.z * sliceStride + size_t(voxel.y) * size.x + voxel.x);
+                const uint32_t j = static_cast<uint32_t>(i - strides[axis]);
+                if (Load(labels, i) != kEmpty && Load(labels, j) != kEmpty) {
+                    Union(labels, i, j);
+                }
+            }
+        }
+    });
+
+    // Number the roots slab by slab and replace each root entry with its
+    // flagged label
+    std::vector<uint32_t> slabRoots(size.z + 1, 0);
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        const size_t begin = z * sliceStride;
+        uint32_t roots = 0;
+        for (size_t i = begin; i < begin + sliceStride; ++i) {
+            roots += labels[i] == i;
+        }
+        slabRoots[z + 1] = roots;
+    });
+    for (int z = 0; z < size.z; ++z) {
+        slabRoots[z + 1] += slabRoots[z];
+    }
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        const size_t begin = z * sliceStride;
+        uint32_t next = slabRoots[z] + 1;
+        for (size_t i = begin; i < begin + sliceStride; ++i) {
+            if (labels[i] == i) {
+                std::atomic_ref<uint32_t>(labels[i]).store(
+                    next++ | kRootFlag, std::memory_order_relaxed);
+            }
+        }
+    });
+
+    // Follow every parent chain to the first flagged entry. That is either
+    // the root or a voxel of the same component resolved by another thread,
+    // so the label is the same either way. Sizes are summed per run.
+    const uint32_t componentCount = slabRoots[size.z];
+    sizes.assign(componentCount + 1, 0);
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        const size_t begin = z * sliceStride;
+        uint32_t runLabel = 0;
+        uint32_t runLength = 0;
+        for (size_t i = begin; i < begin + sliceStride; ++i) {
+            uint32_t label = Load(labels, static_cast<uint32_t>(i));
+            if (label == kEmpty) {
+                label = 0;
+            } else {
+                while (!(label & kRootFlag)) {
+                    label = Load(labels, label);
+                }
+                std::atomic_ref<uint32_t>(labels[i]).store(
+                    label, std::memory_order_relaxed);
+                label &= ~kRootFlag;
+            }
+            if (label != runLabel) {
+                if (runLabel != 0) {
+                    std::atomic_ref<uint32_t>(sizes[runLabel]).fetch_add(
+                        runLength, std::memory_order_relaxed);
+                }
+                runLabel = label;
+                runLength = 0;
+            }
+            ++runLength;
+        }
+        if (runLabel != 0) {
+            std::atomic_ref<uint32_t>(sizes[runLabel]).fetch_add(
+                runLength, std::memory_order_relaxed);
+        }
+    });
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        const size_t begin = z * sliceStride;
+        for (size_t i = begin; i < begin + sliceStride; ++i) {
+            labels[i] = labels[i] == kEmpty ? 0 : labels[i] & ~kRootFlag;
+        }
+    });
+
+    largest = 0;
+    for (uint32_t label = 1; label <= componentCount; ++label) {
+        if (largest == 0 || sizes[label] > sizes[largest]) {
+            largest = label;
+        }
+    }
+}
+
+uint32_t ConnectedComponents::getLabel(const glm::ivec3& voxel) const {
+    if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) ||
+        glm::any(glm::greaterThanEqual(voxel, size))) {
+        return 0;
+    }
+    return labels[(size_t(voxel.z) * size.y + voxel.y) * size.x + voxel.x];
+}
@@ -0,0 +1,393 @@
+#include "Csg.hpp"
+#include "Parallel.hpp"
+#include "imgui.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// False when [min, max) holds no solid voxel, stops at the first one
+bool HasSolid(const std::vector<float>& voxels, const glm::ivec3& size,
+              const glm::ivec3& min, const glm::ivec3& max) {
+    for (int z = min.z; z < max.z; ++z) {
+        for (int y = min.y; y < max.y; ++y) {
+            const float* row =
+                &voxels[(size_t(z) * size.y + y) * size.x + min.x];
+            if (std::any_of(row, row + (max.x - min.x),
+                            [](float v) { return v > 0.003f; })) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+Csg::Csg() {}
+
+Csg::~Csg() {}
+
+void Csg::SetVolume(std::string name, const glm::ivec3& size,
+                    std::vector<float>&& voxels,
+                    std::vector<glm::vec4>&& colors) {
+    volumeName = std::move(name);
+    volumeSize = size;
+    volume = std::move(voxels);
+    volumeColors = std::move(colors);
+
+    volumeBrickGrid = (size + brickSize - 1) / brickSize;
+    const uint32_t brickCount =
+        volumeBrickGrid.x * volumeBrickGrid.y * volumeBrickGrid.z;
+    volumeBricks.assign(brickCount, 0);
+    Parallel::For(0, brickCount, [&](uint32_t b) {
+        const glm::ivec3 min =
+            glm::ivec3(b % volumeBrickGrid.x,
+                       (b / volumeBrickGrid.x) % volumeBrickGrid.y,
+                       b / (volumeBrickGrid.x * volumeBrickGrid.y)) *
+            brickSize;
+        volumeBricks[b] =
+            HasSolid(volume, size, min, glm::min(min + brickSize, size));
+    });
+}
+
+void Csg::OperandBounds(glm::ivec3& min, glm::ivec3& max) const {
+    switch (operand) {
+    case Operand::Sphere:
+        min = glm::ivec3(glm::floor(center - radius));
+        max = glm::ivec3(glm::ceil(center + radius));
+        break;
+    case Operand::Cylinder: {
+        glm::vec3 reach(radius);
+        reach[axis] = height * 0.5f;
+        min = glm::ivec3(glm::floor(center - reach));
+        max = glm::ivec3(glm::ceil(center + reach));
+        break;
+    }
+    case Operand::Box:
+        min = boxMin;
+        max = boxMax;
+        break;
+    case Operand::Volume:
+        min = offset;
+        max = offset + volumeSize;
+        break;
+    }
+}
+
+Csg::Cover Csg::Classify(const glm::ivec3& min, const glm::ivec3& max) const {
+    glm::ivec3 operandMin, operandMax;
+    OperandBounds(operandMin, operandMax);
+    const glm::ivec3 overlapMin = glm::max(min, operandMin);
+    const glm::ivec3 overlapMax = glm::min(max, operandMax);
+    if (glm::any(glm::greaterThanEqual(overlapMin, overlapMax))) {
+        return Cover::Outside;
+    }
+
+    // Shapes are convex, so they hold the brick when they hold the voxel
+    // centers nearest to and farthest from their own center
+    const glm::vec3 low = glm::vec3(min) + 0.5f;
+    const glm::vec3 high = glm::vec3(max) - 0.5f;
+    switch (operand) {
+    case Operand::Sphere:
+    case Operand::Cylinder: {
+        glm::vec3 nearest = glm::clamp(center, low, high) - center;
+        glm::vec3 farthest =
+            glm::max(glm::abs(low - center), glm::abs(high - center));
+        bool alongInside = true;
+        if (operand == Operand::Cylinder) {
+            const float half = height * 0.5f;
+            alongInside = low[axis] >= center[axis] - half &&
+                          high[axis] <= center[axis] + half;
+            if (high[axis] < center[axis] - half ||
+                low[axis] > center[axis] + half) {
+                return Cover::Outside;
+            }
+            nearest[axis] = 0.0f;
+            farthest[axis] = 0.0f;
+        }
+        const float radius2 = radius * radius;
+        if (glm::dot(nearest, nearest) > radius2) {
+            return Cover::Outside;
+        }
+        if (alongInside && glm::dot(farthest, farthest) <= radius2) {
+            return Cover::Inside;
+        }
+        return Cover::Partial;
+    }
+    case Operand::Box:
+        if (glm::all(glm::greaterThanEqual(min, boxMin)) &&
+            glm::all(glm::lessThanEqual(max, boxMax))) {
+            return Cover::Inside;
+        }
+        return Cover::Partial;
+    case Operand::Volume: {
+        // Partial as soon as one overlapped brick of it has solid voxels
+        const glm::ivec3 first = (overlapMin - offset) / brickSize;
+        const glm::ivec3 last = (overlapMax - offset - 1) / brickSize;
+        for (int z = first.z; z <= last.z; ++z) {
+            for (int y = first.y; y <= last.y; ++y) {
+                for (int x = first.x; x <= last.x; ++x) {
+                    if (volumeBricks[(size_t(z) * volumeBrickGrid.y + y) *
+                                         volumeBrickGrid.x +
+                                     x]) {
+                        return Cover::Partial;
+                    }
+                }
+            }
+        }
+        return Cover::Outside;
+    }
+    }
+    return Cover::Partial;
+}
+
+void Csg::OperandRow(int x0, int y, int z, int count, float value,
+                     const std::vector<float>& remap, float* out) const {
+    std::fill(out, out + count, 0.0f);
+    const float py = float(y) + 0.5f - center.y;
+    const float pz = float(z) + 0.5f - center.z;
+    const float radius2 = radius * radius;
+    const float half = height * 0.5f;
+    switch (operand) {
+    case Operand::Sphere:
+        for (int x = 0; x < count; ++x) {
+            const float px = float(x0 + x) + 0.5f - center.x;
+            out[x] = px * px + py * py + pz * pz <= radius2 ? value : 0.0f;
+        }
+        break;
+    case Operand::Cylinder:
+        if (axis == 0) {
+            if (py * py + pz * pz > radius2) {
+                break;
+            }
+            for (int x = 0; x < count; ++x) {
+                const float px = float(x0 + x) + 0.5f - center.x;
+                out[x] = std::abs(px) <= half ? value : 0.0f;
+            }
+        } else {
+            // Along y or z the row crosses a disc at a fixed height
+            const float along = axis == 1 ? py : pz;
+            const float across = axis == 1 ? pz : py;
+            if (std::abs(along) > half) {
+                break;
+            }
+            for (int x = 0; x < count; ++x) {
+                const float px = float(x0 + x) + 0.5f - center.x;
+                out[x] = px * px + across * across <= radius2 ? value : 0.0f;
+            }
+        }
+        break;
+    case Operand::Box:
+        if (y < boxMin.y || y >= boxMax.y || z < boxMin.z || z >= boxMax.z) {
+            break;
+        }
+        for (int x = std::max(x0, boxMin.x); x < std::min(x0 + count, boxMax.x);
+             ++x) {
+            out[x - x0] = value;
+        }
+        break;
+    case Operand::Volume: {
+        const glm::ivec3 local = glm::ivec3(x0, y, z) - offset;
+        if (local.y < 0 || local.y >= volumeSize.y || local.z < 0 ||
+            local.z >= volumeSize.z) {
+            break;
+        }
+        const float* row =
+            &volume[(size_t(local.z) * volumeSize.y + local.y) * volumeSize.x];
+        for (int x = std::max(0, -local.x);
+             x < std::min(count, volumeSize.x - local.x); ++x) {
+            out[x] = remap[VoxelIndex<uint16_t>::Encode(row[local.x + x])];
+        }
+        break;
+    }
+    }
+}
+
+uint64_t Csg::Apply(VoxelManager& voxelManager,
+                    PaletteManager& paletteManager) {
+    if (operand == Operand::Volume && volume.empty()) {
+        return 0;
+    }
+    auto start = std::chrono::steady_clock::now();
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    std::vector<float>& voxels = voxelManager.getVoxel();
+    Palette& palette = paletteManager.GetCurrentPalette();
+    const float value =
+        VoxelIndex<uint16_t>::Decode(palette.getSelectedIndex());
+
+    // Colors of the second volume go to the nearest current palette entry,
+    // matched once per index. Never 0, so every solid voxel stays solid.
+    std::vector<float> remap;
+    if (operand == Operand::Volume) {
+        const std::vector<glm::vec4>& colors = palette.getColors();
+        remap.assign(VoxelIndex<uint16_t>::count, 0.0f);
+        for (size_t i = 0;
+             i < volumeColors.size() && i + 1 < remap.size(); ++i) {
+            uint16_t best = 1;
+            float bestDistance = std::numeric_limits<float>::max();
+            for (size_t j = 1; j < colors.size(); ++j) {
+                const glm::vec3 d =
+                    glm::vec3(colors[j]) - glm::vec3(volumeColors[i]);
+                const float distance = glm::dot(d, d);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = static_cast<uint16_t>(j);
+                }
+            }
+            remap[i + 1] = VoxelIndex<uint16_t>::Decode(best);
+        }
+    }
+
+    const glm::ivec3 grid = (size + brickSize - 1) / brickSize;
+    const uint32_t brickCount = grid.x * grid.y * grid.z;
+    std::vector<glm::ivec3> brickMin(brickCount, size);
+    std::vector<glm::ivec3> brickMax(brickCount, glm::ivec3(0));
+    std::vector<uint64_t> brickChanged(brickCount, 0);
+    Parallel::For(0, brickCount, [&](uint32_t b) {
+        const glm::ivec3 min =
+            glm::ivec3(b % grid.x, (b / grid.x) % grid.y,
+                       b / (grid.x * grid.y)) *
+            brickSize;
+        const glm::ivec3 max = glm::min(min + brickSize, size);
+        const int width = max.x - min.x;
+
+        // Union and subtract leave bricks the operand misses alone,
+        // intersect those it covers whole. Subtract and intersect only
+        // remove, so empty bricks have nothing for them either.
+        const Cover cover = Classify(min, max);
+        if ((cover == Cover::Outside && op != Op::Intersect) ||
+            (cover == Cover::Inside && op == Op::Intersect) ||
+            (op != Op::Union && !HasSolid(voxels, size, min, max))) {
+            return;
+        }
+
+        float row[brickSize];
+        if (cover != Cover::Partial) {
+            std::fill(row, row + width,
+                      cover == Cover::Inside ? value : 0.0f);
+        }
+        VoxelManager::UsageDelta delta = voxelManager.newUsageDelta();
+        for (int z = min.z; z < max.z; ++z) {
+            for (int y = min.y; y < max.y; ++y) {
+                if (cover == Cover::Partial) {
+                    OperandRow(min.x, y, z, width, value, remap, row);
+                }
+                const size_t rowStart =
+                    (size_t(z) * size.y + y) * size.x + min.x;
+                for (int x = 0; x < width; ++x) {
+                    float& current = voxels[rowStart + x];
+                    float target = current;
+                    switch (op) {
+                    case Op::Union:
+                        target = current > 0.003f ? current : row[x];
+                        break;
+                    case Op::Subtract:
+                        target = row[x] > 0.0f ? 0.0f : current;
+                        break;
+                    case Op::Intersect:
+                        target = row[x] > 0.0f ? current : 0.0f;
+                        break;
+                    }
+                    const glm::ivec3 voxel(min.x + x, y, z);
+                    if (target == current || !voxelManager.isEditable(voxel)) {
+                        continue;
+                    }
+                    VoxelManager::countChange(delta, current, target);
+                    current = target;
+                    brickMin[b] = glm::min(brickMin[b], voxel);
+                    brickMax[b] = glm::max(brickMax[b], voxel + 1);
+                    ++brickChanged[b];
+                }
+            }
+        }
+        voxelManager.applyUsage(delta);
+    });
+
+    glm::ivec3 changedMin = size;
+    glm::ivec3 changedMax(0);
+    uint64_t changed = 0;
+    for (uint32_t b = 0; b < brickCount; ++b) {
+        changedMin = glm::min(changedMin, brickMin[b]);
+        changedMax = glm::max(changedMax, brickMax[b]);
+        changed += brickChanged[b];
+    }
+    voxelManager.markDirty(changedMin, changedMax);
+    lastMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+    lastChanged = changed;
+    return changed;
+}
+
+void Csg::RenderWindow(bool* open, VoxelManager& voxelManager,
+                       PaletteManager& paletteManager) {
+    if (!*open) {
+        return;
+    }
+
+    ImGui::Begin("CSG", open);
+
+    static const char* opNames[] = {"Union", "Subtract", "Intersect"};
+    static const char* operandNames[] = {"Sphere", "Cylinder", "Box",
+                                         "Volume"};
+    static const char* axisNames[] = {"X", "Y", "Z"};
+
+    int opIndex = static_cast<int>(op);
+    if (ImGui::Combo("Operation", &opIndex, opNames, 3)) {
+        op = static_cast<Op>(opIndex);
+    }
+    int operandIndex = static_cast<int>(operand);
+    if (ImGui::Combo("Operand", &operandIndex, operandNames, 4)) {
+        operand = static_cast<Operand>(operandIndex);
+    }
+
+    ImGui::Separator();
+    switch (operand) {
+    case Operand::Sphere:
+    case Operand::Cylinder:
+        ImGui::DragFloat3("Center", &center.x, 0.5f, -2048.0f, 4096.0f);
+        ImGui::DragFloat("Radius", &radius, 0.25f, 0.5f, 2048.0f);
+        if (operand == Operand::Cylinder) {
+            ImGui::DragFloat("Height", &height, 0.5f, 1.0f, 4096.0f);
+            ImGui::Combo("Axis", &axis, axisNames, 3);
+        }
+        if (ImGui::Button("Center in Volume")) {
+            center = glm::vec3(voxelManager.getSize()) * 0.5f;
+        }
+        break;
+    case Operand::Box:
+        ImGui::DragInt3("Min", &boxMin.x, 1.0f, -2048, 4096);
+        ImGui::DragInt3("Max", &boxMax.x, 1.0f, -2048, 4096);
+        break;
+    case Operand::Volume:
+        if (ImGui::Button("Open .nuum")) {
+            volumeRequested = true;
+        }
+        if (volume.empty()) {
+            ImGui::Text("No volume loaded");
+        } else {
+            ImGui::Text("%s: %dx%dx%d", volumeName.c_str(), volumeSize.x,
+                        volumeSize.y, volumeSize.z);
+        }
+        ImGui::DragInt3("Offset", &offset.x, 1.0f, -4096, 4096);
+        break;
+    }
+
+    ImGui::Separator();
+    ImGui::BeginDisabled(operand == Operand::Volume && volume.empty());
+    if (ImGui::Button("Apply")) {
+        Apply(voxelManager, paletteManager);
+    }
+    ImGui::EndDisabled();
+    if (lastMilliseconds >= 0) {
+        ImGui::SameLine();
+        ImGui::Text("%llu voxels in %lld ms",
+                    static_cast<unsigned long long>(lastChanged),
+                    lastMilliseconds);
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,309 @@
+#include "DistanceField.hpp"
+#include "Parallel.hpp"
+#include "glm/common.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr float kInf = 1e20f;
+// Squared distances past the clamp all read as this, so the transform fits
+// in 16 bits; anything at least this far ends up as maxDistance
+constexpr uint16_t kFar =
+    (DistanceField::maxDistance + 1) * (DistanceField::maxDistance + 1);
+// Rows of the grid transformed at a time, bounding the scratch memory
+constexpr int kSlabDepth = 64;
+
+// Exact 1D squared distance transform (Felzenszwalb & Huttenlocher): lower
+// envelope of the parabolas rooted at the samples of f
+void Transform1D(const float* f, float* d, int n, int* v, float* z) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -kInf;
+    for (int q = 1; q < n; ++q) {
+        float s;
+        while (true) {
+            const int p = v[k];
+            s = ((f[q] + float(q) * q) - (f[p] + float(p) * p)) /
+                (2.0f * (q - p));
+            if (s > z[k]) {
+                break;
+            }
+            --k;
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+    }
+    z[k + 1] = kInf;
+    int j = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[j + 1] < q) {
+            ++j;
+        }
+        const float delta = float(q - v[j]);
+        d[q] = delta * delta + f[v[j]];
+    }
+}
+
+// Runs the 1D transform over every line of g along one axis, in parallel
+void TransformAxis(std::vector<uint16_t>& g, const glm::ivec3& extent,
+                   int axis) {
+    const int n = extent[axis];
+    const size_t stride = axis == 0   ? 1
+                          : axis == 1 ? size_t(extent.x)
+                                      : size_t(extent.x) * extent.y;
+    const int a = axis == 0 ? 1 : 0;
+    const int b = axis == 2 ? 1 : 2;
+    const uint32_t lines = extent[a] * extent[b];
+    Parallel::For(
+        0, lines,
+        [&](uint32_t line) {
+            thread_local std::vector<float> f, d, z;
+            thread_local std::vector<int> v;
+            f.resize(n);
+            d.resize(n);
+            z.resize(n + 1);
+            v.resize(n);
+
+            glm::ivec3 start(0);
+            start[a] = line % extent[a];
+            start[b] = line / extent[a];
+            uint16_t* base =
+                &g[(size_t(start.z) * extent.y + start.y) * extent.x + start.x];
+            for (int i = 0; i < n; ++i) {
+                f[i] = float(base[i * stride]);
+            }
+            Transform1D(f.data(), d.data(), n, v.data(), z.data());
+            for (int i = 0; i < n; ++i) {
+                base[i * stride] =
+                    static_cast<uint16_t>(std::min(d[i], float(kFar)));
+            }
+        },
+        64);
+}
+
+} // namespace
+
+DistanceField::DistanceField() {}
+
+DistanceField::~DistanceField() {}
+
+void DistanceField::Init() {
+    s_distanceTexture =
+        bgfx::createUniform("s_distanceTexture", bgfx::UniformType::Sampler);
+}
+
+void DistanceField::Destroy() {
+    if (bgfx::isValid(s_distanceTexture)) {
+        bgfx::destroy(s_distanceTexture);
+        s_distanceTexture.idx = bgfx::kInvalidHandle;
+    }
+    if (bgfx::isValid(textureHandle)) {
+        bgfx::destroy(textureHandle);
+        textureHandle.idx = bgfx::kInvalidHandle;
+    }
+    distances.clear();
+    pendingSlices.clear();
+}
+
+void DistanceField::Build(const std::vector<float>& voxels,
+                          const glm::ivec3& size) {
+    this->size = size;
+    if (!gpuEnabled) {
+        return;
+    }
+    distances.assign(size_t(size.x) * size.y * size.z,
+                     int8_t(maxDistance * stepsPerVoxel));
+    Transform(voxels, glm::ivec3(0), size, glm::ivec3(0), size);
+    CreateTexture();
+}
+
+void DistanceField::Update(const std::vector<float>& voxels,
+                           const glm::ivec3& min, const glm::ivec3& max) {
+    if (!gpuEnabled) {
+        return;
+    }
+    // Cells further than maxDistance from the edit keep their clamped value,
+    // and those within it only see features up to maxDistance further out
+    const glm::ivec3 regionMin = glm::max(min - maxDistance, glm::ivec3(0));
+    const glm::ivec3 regionMax = glm::min(max + maxDistance, size);
+    const glm::ivec3 windowMin =
+        glm::max(regionMin - maxDistance, glm::ivec3(0));
+    const glm::ivec3 windowMax = glm::min(regionMax + maxDistance, size);
+    Transform(voxels, windowMin, windowMax, regionMin, regionMax);
+    // The texture may now promise free space where voxels were placed,
+    // rays take plain steps until the new slices are uploaded
+    textureReady = false;
+    QueueUpload(regionMin, regionMax);
+}
+
+void DistanceField::Transform(const std::vector<float>& voxels,
+                              const glm::ivec3& windowMin,
+                              const glm::ivec3& windowMax,
+                              const glm::ivec3& regionMin,
+                              const glm::ivec3& regionMax) {
+    if (glm::any(glm::greaterThanEqual(regionMin, regionMax))) {
+        return;
+    }
+    // The region is done in slabs along z; a slab only needs the rows
+    // within maxDistance of it, so the scratch stays a few slabs deep
+    std::vector<uint16_t> g;
+    for (int slabMin = regionMin.z; slabMin < regionMax.z;
+         slabMin += kSlabDepth) {
+        const int slabMax = std::min(slabMin + kSlabDepth, regionMax.z);
+        glm::ivec3 lower = windowMin;
+        glm::ivec3 upper = windowMax;
+        lower.z = std::max(slabMin - maxDistance, windowMin.z);
+        upper.z = std::min(slabMax + maxDistance, windowMax.z);
+        const glm::ivec3 extent = upper - lower;
+        g.resize(size_t(extent.x) * extent.y * extent.z);
+
+        // Outside distance, seeded from solid voxels, then inside distance,
+        // seeded from empty ones
+        for (int pass = 0; pass < 2; ++pass) {
+            const bool inside = pass == 1;
+            Parallel::For(0, extent.z, [&](uint32_t z) {
+                for (int y = 0; y < extent.y; ++y) {
+                    const int vy = lower.y + y;
+                    const int vz = lower.z + z;
+                    size_t src = (size_t(vz) * size.y + vy) * size.x + lower.x;
+                    uint16_t* dst = &g[(size_t(z) * extent.y + y) * extent.x];
+                    for (int x = 0; x < extent.x; ++x) {
+                        bool solid = voxels[src + x] > 0.003f;
+                        dst[x] = solid != inside ? 0 : kFar;
+                    }
+                }
+            });
+            for (int axis = 0; axis < 3; ++axis) {
+                TransformAxis(g, extent, axis);
+            }
+
+            // Steps are truncated, so a stored distance never overshoots
+            const glm::ivec3 offset = regionMin - lower;
+            Parallel::For(slabMin, slabMax, [&](uint32_t z) {
+                for (int y = regionMin.y; y < regionMax.y; ++y) {
+                    size_t row = (size_t(z) * size.y + y) * size.x;
+                    const uint16_t* src =
+                        &g[(size_t(z - lower.z) * extent.y + y - lower.y) *
+                               extent.x +
+                           offset.x];
+                    for (int x = regionMin.x; x < regionMax.x; ++x) {
+                        const float d =
+                            std::min(std::sqrt(float(src[x - regionMin.x])),
+                                     float(maxDistance));
+                        const int8_t steps =
+                            static_cast<int8_t>(d * stepsPerVoxel);
+                        if (!inside) {
+                            distances[row + x] = steps;
+                        } else if (steps > 0) {
+                            distances[row + x] = -steps;
+                        }
+                    }
+                }
+            });
+        }
+    }
+}
+
+void DistanceField::setGpuEnabled(bool enabled,
+                                  const std::vector<float>& voxels) {
+    if (enabled == gpuEnabled) {
+        return;
+    }
+    gpuEnabled = enabled;
+    if (gpuEnabled) {
+        Build(voxels, size);
+    } else {
+        std::vector<int8_t>().swap(distances);
+        pendingSlices.clear();
+        textureReady = false;
+        if (bgfx::isValid(textureHandle)) {
+            bgfx::destroy(textureHandle);
+            textureHandle.idx = bgfx::kInvalidHandle;
+        }
+    }
+}
+
+void DistanceField::CreateTexture() {
+    if (bgfx::isValid(textureHandle)) {
+        bgfx::destroy(textureHandle);
+        textureHandle.idx = bgfx::kInvalidHandle;
+    }
+    pendingSlices.clear();
+    textureReady = false;
+    if (glm::any(glm::lessThanEqual(size, glm::ivec3(0)))) {
+        return;
+    }
+    textureScale = 1;
+    while (glm::any(glm::greaterThan((size + textureScale - 1) / textureScale,
+                                     glm::ivec3(maxTextureEdge)))) {
+        textureScale *= 2;
+    }
+    textureSize = (size + textureScale - 1) / textureScale;
+    textureHandle = bgfx::createTexture3D(
+        textureSize.x, textureSize.y, textureSize.z, false,
+        bgfx::TextureFormat::R8, BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP,
+        nullptr);
+    QueueUpload(glm::ivec3(0), size);
+}
+
+void DistanceField::QueueUpload(const glm::ivec3& min, const glm::ivec3& max) {
+    // Slices are in texels, covering every texel the voxels touch
+    const glm::ivec3 texelMin = min / textureScale;
+    const glm::ivec3 texelMax = (max - 1) / textureScale + 1;
+    const int sliceSize = 32;
+    for (int z = texelMin.z; z < texelMax.z; z += sliceSize) {
+        for (int y = texelMin.y; y < texelMax.y; y += sliceSize) {
+            for (int x = texelMin.x; x < texelMax.x; x += sliceSize) {
+                glm::ivec3 sliceMin(x, y, z);
+                pendingSlices.push_back(
+                    {sliceMin, glm::min(sliceMin + sliceSize, texelMax)});
+            }
+        }
+    }
+}
+
+void DistanceField::Flush(UploadScheduler& scheduler) {
+    while (!pendingSlices.empty() && bgfx::isValid(textureHandle)) {
+        const Slice& slice = pendingSlices.front();
+        const glm::ivec3 extent = slice.max - slice.min;
+        const bgfx::Memory* mem =
+            scheduler.Allocate(extent.x * extent.y * extent.z);
+        if (!mem) {
+            break;
+        }
+        // Whole voxels of free space, rounded down so a leap never
+        // overshoots; a coarse texel holds what all of its voxels have
+        uint8_t* dst = mem->data;
+        for (int z = slice.min.z; z < slice.max.z; ++z) {
+            for (int y = slice.min.y; y < slice.max.y; ++y) {
+                for (int x = slice.min.x; x < slice.max.x; ++x) {
+                    const glm::ivec3 voxelMin =
+                        glm::ivec3(x, y, z) * textureScale;
+                    const glm::ivec3 voxelMax =
+                        glm::min(voxelMin + textureScale, size);
+                    int free = maxDistance * stepsPerVoxel;
+                    for (int vz = voxelMin.z; vz < voxelMax.z; ++vz) {
+                        for (int vy = voxelMin.y; vy < voxelMax.y; ++vy) {
+                            const int8_t* src =
+                                &distances[(size_t(vz) * size.y + vy) *
+                                           size.x];
+                            for (int vx = voxelMin.x; vx < voxelMax.x; ++vx) {
+                                free = std::min(free, int(src[vx]));
+                            }
+                        }
+                    }
+                    *dst++ = static_cast<uint8_t>(std::max(free, 0) /
+                                                  stepsPerVoxel);
+                }
+            }
+        }
+        bgfx::updateTexture3D(textureHandle, 0, slice.min.x, slice.min.y,
+                              slice.min.z, extent.x, extent.y, extent.z, mem);
+        pendingSlices.pop_front();
+    }
+    if (pendingSlices.empty() && bgfx::isValid(textureHandle)) {
+        textureReady = true;
+    }
+}
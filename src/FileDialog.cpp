@@ -22,6 +22,20 @@ int FileDialog::OpenFileDialog(std::string& outPath, const nfdu8filteritem_t* fi
     return 0;
 }
 
+int FileDialog::PickFolderDialog(std::string& outPath) {
+    nfdu8char_t* outPathCStr = nullptr;
+    nfdresult_t result = NFD::PickFolder(outPathCStr, ".", nativeWindow);
+    if (result == NFD_CANCEL) {
+        outPath = "";
+        return 2;
+    } else if (result == NFD_ERROR) {
+        return 1;
+    }
+    outPath = std::string(outPathCStr);
+    NFD::FreePath(outPathCStr);
+    return 0;
+}
+
 int FileDialog::SaveFileDialog(std::string& outPath, const std::string& defaultName, const nfdu8filteritem_t* filter,
                                const size_t filterCount) {
     nfdu8char_t* outPathCStr = nullptr;
@@ -0,0 +1,419 @@
+#include "Generator.hpp"
+#include "Parallel.hpp"
+#include "imgui.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+constexpr uint32_t primeX = 501125321u;
+constexpr uint32_t primeY = 1136930381u;
+constexpr uint32_t primeZ = 1720413743u;
+
+// floor() as a plain convert and compare, which vectorizes everywhere
+inline int FastFloor(float v) {
+    const int i = int(v);
+    return i - int(v < float(i));
+}
+
+// Lattice coordinates come in already multiplied by their primes
+inline uint32_t Hash(uint32_t seed, uint32_t x, uint32_t y, uint32_t z) {
+    uint32_t h = seed ^ x ^ y ^ z;
+    h *= 0x27d4eb2du;
+    return h ^ (h >> 15);
+}
+
+// One of Perlin's 12 edge gradients dotted with (x, y, z), chosen by
+// selects rather than a table so no gather is needed
+inline float Grad(uint32_t hash, float x, float y, float z) {
+    const uint32_t h = hash & 15;
+    const float u = h < 8 ? x : y;
+    const float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+inline float Lerp(float a, float b, float t) { return a + t * (b - a); }
+
+inline float Fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+inline float Perlin(float x, float y, float z, uint32_t seed) {
+    const int xi = FastFloor(x);
+    const int yi = FastFloor(y);
+    const int zi = FastFloor(z);
+    const float fx = x - float(xi);
+    const float fy = y - float(yi);
+    const float fz = z - float(zi);
+    const uint32_t x0 = uint32_t(xi) * primeX, x1 = x0 + primeX;
+    const uint32_t y0 = uint32_t(yi) * primeY, y1 = y0 + primeY;
+    const uint32_t z0 = uint32_t(zi) * primeZ, z1 = z0 + primeZ;
+
+    const float n000 = Grad(Hash(seed, x0, y0, z0), fx, fy, fz);
+    const float n100 = Grad(Hash(seed, x1, y0, z0), fx - 1, fy, fz);
+    const float n010 = Grad(Hash(seed, x0, y1, z0), fx, fy - 1, fz);
+    const float n110 = Grad(Hash(seed, x1, y1, z0), fx - 1, fy - 1, fz);
+    const float n001 = Grad(Hash(seed, x0, y0, z1), fx, fy, fz - 1);
+    const float n101 = Grad(Hash(seed, x1, y0, z1), fx - 1, fy, fz - 1);
+    const float n011 = Grad(Hash(seed, x0, y1, z1), fx, fy - 1, fz - 1);
+    const float n111 = Grad(Hash(seed, x1, y1, z1), fx - 1, fy - 1, fz - 1);
+
+    const float u = Fade(fx);
+    const float v = Fade(fy);
+    const float w = Fade(fz);
+    return Lerp(Lerp(Lerp(n000, n100, u), Lerp(n010, n110, u), v),
+                Lerp(Lerp(n001, n101, u), Lerp(n011, n111, u), v), w);
+}
+
+inline float SimplexCorner(float x, float y, float z, uint32_t hash) {
+    // max(t, 0) as arithmetic: a compare would become a branch around the
+    // multiplies below, which keeps the loop from vectorizing
+    float t = 0.6f - x * x - y * y - z * z;
+    t = 0.5f * (t + std::fabs(t));
+    t *= t;
+    return t * t * Grad(hash, x, y, z);
+}
+
+inline float Simplex(float x, float y, float z, uint32_t seed) {
+    constexpr float F3 = 1.0f / 3.0f;
+    constexpr float G3 = 1.0f / 6.0f;
+    const float s = (x + y + z) * F3;
+    const int i = FastFloor(x + s);
+    const int j = FastFloor(y + s);
+    const int k = FastFloor(z + s);
+    const float t = float(i + j + k) * G3;
+    const float x0 = x - (float(i) - t);
+    const float y0 = y - (float(j) - t);
+    const float z0 = z - (float(k) - t);
+
+    // The two middle corners follow from the ranks of x0, y0 and z0
+    const int gx = x0 >= y0;
+    const int gy = y0 >= z0;
+    const int gz = z0 >= x0;
+    const int i1 = gx & (1 - gz), j1 = gy & (1 - gx), k1 = gz & (1 - gy);
+    const int i2 = gx | (1 - gz), j2 = gy | (1 - gx), k2 = gz | (1 - gy);
+
+    const uint32_t xs = uint32_t(i) * primeX;
+    const uint32_t ys = uint32_t(j) * primeY;
+    const uint32_t zs = uint32_t(k) * primeZ;
+    const float n0 = SimplexCorner(x0, y0, z0, Hash(seed, xs, ys, zs));
+    const float n1 = SimplexCorner(
+        x0 - float(i1) + G3, y0 - float(j1) + G3, z0 - float(k1) + G3,
+        Hash(seed, xs + uint32_t(i1) * primeX, ys + uint32_t(j1) * primeY,
+             zs + uint32_t(k1) * primeZ));
+    const float n2 = SimplexCorner(
+        x0 - float(i2) + 2.0f * G3, y0 - float(j2) + 2.0f * G3,
+        z0 - float(k2) + 2.0f * G3,
+        Hash(seed, xs + uint32_t(i2) * primeX, ys + uint32_t(j2) * primeY,
+             zs + uint32_t(k2) * primeZ));
+    const float n3 = SimplexCorner(
+        x0 - 1.0f + 3.0f * G3, y0 - 1.0f + 3.0f * G3, z0 - 1.0f + 3.0f * G3,
+        Hash(seed, xs + primeX, ys + primeY, zs + primeZ));
+    return 32.0f * (n0 + n1 + n2 + n3);
+}
+
+// Octaves are summed over the whole row before the next one starts, so
+// the inner loop is one noise call per lane with nothing else in between
+template <typename NoiseFn>
+void Fbm(NoiseFn noise, float x0, float y, float z, int count, float* out,
+         float frequency, int octaves, float lacunarity, float gain,
+         uint32_t seed) {
+    std::fill(out, out + count, 0.0f);
+    float amplitude = 1.0f;
+    float total = 0.0f;
+    for (int o = 0; o < octaves; ++o) {
+        const uint32_t octaveSeed = seed + uint32_t(o) * 0x9E3779B9u;
+        const float fy = y * frequency;
+        const float fz = z * frequency;
+        for (int i = 0; i < count; ++i) {
+            out[i] += amplitude *
+                      noise((x0 + float(i)) * frequency, fy, fz, octaveSeed);
+        }
+        total += amplitude;
+        amplitude *= gain;
+        frequency *= lacunarity;
+    }
+    const float scale = 1.0f / total;
+    for (int i = 0; i < count; ++i) {
+        out[i] *= scale;
+    }
+}
+
+} // namespace
+
+Generator::Generator() {}
+
+Generator::~Generator() {}
+
+bool Generator::RegionBounds(VoxelManager& voxelManager, glm::ivec3& min,
+                             glm::ivec3& max) const {
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    switch (region) {
+    case Region::Volume:
+        min = glm::ivec3(0);
+        max = size;
+        break;
+    case Region::Selection:
+        if (!voxelManager.getSelection().getBounds(min, max)) {
+            return false;
+        }
+        break;
+    case Region::Custom:
+        min = glm::clamp(customMin, glm::ivec3(0), size);
+        max = glm::clamp(customMax, min, size);
+        break;
+    }
+    return !glm::any(glm::greaterThanEqual(min, max));
+}
+
+void Generator::FbmRow(float x0, float y, float z, int count,
+                       float* out) const {
+    const float frequency = 1.0f / std::max(featureSize, 1.0f);
+    const int octaveCount = std::clamp(octaves, 1, 12);
+    const uint32_t noiseSeed = uint32_t(seed);
+    if (noise == Noise::Perlin) {
+        Fbm([](float x, float y, float z,
+               uint32_t s) { return Perlin(x, y, z, s); },
+            x0, y, z, count, out, frequency, octaveCount, lacunarity, gain,
+            noiseSeed);
+    } else {
+        Fbm([](float x, float y, float z,
+               uint32_t s) { return Simplex(x, y, z, s); },
+            x0, y, z, count, out, frequency, octaveCount, lacunarity, gain,
+            noiseSeed);
+    }
+}
+
+int Generator::Generate(VoxelManager& voxelManager,
+                        PaletteManager& paletteManager) {
+    glm::ivec3 min, max;
+    if (!RegionBounds(voxelManager, min, max)) {
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    const glm::ivec3 extent = max - min;
+    const glm::vec3 center = glm::vec3(min + max) * 0.5f;
+    const glm::vec3 half = glm::vec3(extent) * 0.5f;
+    const float tube = std::clamp(tubeRadius, 0.01f, 1.0f);
+    const bool selectionOnly = region == Region::Selection;
+    const SelectionMask& selection = voxelManager.getSelection();
+    std::vector<float>& voxels = voxelManager.getVoxel();
+
+    // The value written is looked up per layer, banding is free per voxel
+    Palette& palette = paletteManager.GetCurrentPalette();
+    const int colorCount = static_cast<int>(palette.getColors().size());
+    const int bands = std::max(bandCount, 1);
+    std::vector<float> layerValue(extent.y, 0.0f);
+    for (int y = 0; y < extent.y && mode != Mode::Carve; ++y) {
+        int index = palette.getSelectedIndex();
+        if (banding && colorCount > 1) {
+            const int band = std::min(bands - 1, y * bands / extent.y);
+            index = std::clamp(bandFirst + band, 1, colorCount - 1);
+        }
+        layerValue[y] = index / 255.0f;
+    }
+
+    const glm::ivec3 grid = (extent + brickSize - 1) / brickSize;
+    const uint32_t brickCount = grid.x * grid.y * grid.z;
+    std::vector<glm::ivec3> brickMin(brickCount, size);
+    std::vector<glm::ivec3> brickMax(brickCount, glm::ivec3(0));
+    Parallel::For(0, brickCount, [&](uint32_t b) {
+        const glm::ivec3 offset =
+            min + glm::ivec3(b % grid.x, (b / grid.x) % grid.y,
+                             b / (grid.x * grid.y)) *
+                      brickSize;
+        const glm::ivec3 end = glm::min(offset + brickSize, max);
+        const int width = end.x - offset.x;
+        float heights[brickSize * brickSize];
+        float density[brickSize];
+        uint8_t inside[brickSize];
+
+        // Terrain is a height per column, shared by the brick's rows
+        if (shape == Shape::Terrain) {
+            for (int z = offset.z; z < end.z; ++z) {
+                float* row = &heights[(z - offset.z) * brickSize];
+                FbmRow(float(offset.x), 0.0f, float(z), width, row);
+                for (int x = 0; x < width; ++x) {
+                    row[x] = float(min.y) +
+                             (baseHeight + amplitude * row[x]) * extent.y;
+                }
+            }
+        }
+
+        VoxelManager::UsageDelta delta = voxelManager.newUsageDelta();
+        for (int z = offset.z; z < end.z; ++z) {
+            const float pz = (float(z) + 0.5f - center.z) / half.z;
+            for (int y = offset.y; y < end.y; ++y) {
+                const float py = (float(y) + 0.5f - center.y) / half.y;
+                switch (shape) {
+                case Shape::Terrain: {
+                    const float* row = &heights[(z - offset.z) * brickSize];
+                    for (int x = 0; x < width; ++x) {
+                        inside[x] = float(y) + 0.5f < row[x];
+                    }
+                    break;
+                }
+                case Shape::Caves:
+                    FbmRow(float(offset.x), float(y), float(z), width,
+                           density);
+                    for (int x = 0; x < width; ++x) {
+                        inside[x] = density[x] > caveThreshold;
+                    }
+                    break;
+                case Shape::Box:
+                    std::fill(inside, inside + width, uint8_t(1));
+                    break;
+                case Shape::Sphere:
+                    for (int x = 0; x < width; ++x) {
+                        const float px =
+                            (float(offset.x + x) + 0.5f - center.x) / half.x;
+                        inside[x] = px * px + py * py + pz * pz <= 1.0f;
+                    }
+                    break;
+                case Shape::Cylinder:
+                    for (int x = 0; x < width; ++x) {
+                        const float px =
+                            (float(offset.x + x) + 0.5f - center.x) / half.x;
+                        inside[x] = px * px + pz * pz <= 1.0f;
+                    }
+                    break;
+                case Shape::Torus: {
+                    // The tube cross section at this height is an annulus
+                    // in xz, tested on squared radii to keep sqrt per row
+                    const float reach = 1.0f - py * py;
+                    const float ring = 1.0f - tube;
+                    const float spread =
+                        tube * std::sqrt(std::max(reach, 0.0f));
+                    const float inner = std::max(ring - spread, 0.0f);
+                    const float outer = ring + spread;
+                    const float inner2 = inner * inner;
+                    const float outer2 = reach < 0.0f ? -1.0f : outer * outer;
+                    for (int x = 0; x < width; ++x) {
+                        const float px =
+                            (float(offset.x + x) + 0.5f - center.x) / half.x;
+                        const float r2 = px * px + pz * pz;
+                        inside[x] = r2 >= inner2 && r2 <= outer2;
+                    }
+                    break;
+                }
+                }
+
+                const float value = layerValue[y - min.y];
+                const size_t rowStart =
+                    (size_t(z) * size.y + y) * size.x + offset.x;
+                for (int x = 0; x < width; ++x) {
+                    if (!inside[x] && mode != Mode::Replace) {
+                        continue;
+                    }
+                    const float target = inside[x] ? value : 0.0f;
+                    float& current = voxels[rowStart + x];
+                    const glm::ivec3 voxel(offset.x + x, y, z);
+                    if (current == target ||
+                        (selectionOnly && !selection.test(voxel)) ||
+                        !voxelManager.isEditable(voxel)) {
+                        continue;
+                    }
+                    VoxelManager::countChange(delta, current, target);
+                    current = target;
+                    brickMin[b] = glm::min(brickMin[b], voxel);
+                    brickMax[b] = glm::max(brickMax[b], voxel + 1);
+                }
+            }
+        }
+        voxelManager.applyUsage(delta);
+    });
+
+    glm::ivec3 changedMin = size;
+    glm::ivec3 changedMax(0);
+    for (uint32_t b = 0; b < brickCount; ++b) {
+        changedMin = glm::min(changedMin, brickMin[b]);
+        changedMax = glm::max(changedMax, brickMax[b]);
+    }
+    voxelManager.markDirty(changedMin, changedMax);
+    lastMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+    return 0;
+}
+
+void Generator::RenderWindow(bool* open, VoxelManager& voxelManager,
+                             PaletteManager& paletteManager) {
+    if (!*open) {
+        return;
+    }
+
+    ImGui::Begin("Generator", open);
+
+    static const char* shapeNames[] = {"Terrain", "Caves",    "Box",
+                                       "Sphere",  "Cylinder", "Torus"};
+    static const char* modeNames[] = {"Fill", "Replace", "Carve"};
+    static const char* regionNames[] = {"Volume", "Selection", "Custom"};
+    static const char* noiseNames[] = {"Perlin", "Simplex"};
+
+    int shapeIndex = static_cast<int>(shape);
+    if (ImGui::Combo("Shape", &shapeIndex, shapeNames, 6)) {
+        shape = static_cast<Shape>(shapeIndex);
+        if (shape == Shape::Caves) {
+            mode = Mode::Carve; // caves are holes in what is there
+        }
+    }
+    int modeIndex = static_cast<int>(mode);
+    if (ImGui::Combo("Mode", &modeIndex, modeNames, 3)) {
+        mode = static_cast<Mode>(modeIndex);
+    }
+    int regionIndex = static_cast<int>(region);
+    if (ImGui::Combo("Region", &regionIndex, regionNames, 3)) {
+        region = static_cast<Region>(regionIndex);
+    }
+    if (region == Region::Custom) {
+        ImGui::DragInt3("Min", &customMin.x, 1.0f, 0, 2048);
+        ImGui::DragInt3("Max", &customMax.x, 1.0f, 0, 2048);
+    }
+
+    if (shape == Shape::Terrain || shape == Shape::Caves) {
+        ImGui::Separator();
+        int noiseIndex = static_cast<int>(noise);
+        if (ImGui::Combo("Noise", &noiseIndex, noiseNames, 2)) {
+            noise = static_cast<Noise>(noiseIndex);
+        }
+        ImGui::InputInt("Seed", &seed);
+        ImGui::SliderFloat("Feature Size", &featureSize, 4.0f, 512.0f,
+                           "%.0f");
+        ImGui::SliderInt("Octaves", &octaves, 1, 8);
+        ImGui::SliderFloat("Lacunarity", &lacunarity, 1.5f, 3.0f);
+        ImGui::SliderFloat("Gain", &gain, 0.2f, 0.8f);
+        if (shape == Shape::Terrain) {
+            ImGui::SliderFloat("Base Height", &baseHeight, 0.0f, 1.0f);
+            ImGui::SliderFloat("Amplitude", &amplitude, 0.0f, 1.0f);
+        } else {
+            ImGui::SliderFloat("Threshold", &caveThreshold, -0.5f, 0.5f);
+        }
+    } else if (shape == Shape::Torus) {
+        ImGui::SliderFloat("Tube Radius", &tubeRadius, 0.05f, 1.0f);
+    }
+
+    ImGui::Separator();
+    ImGui::Checkbox("Height Bands", &banding);
+    if (banding) {
+        const int colorCount = static_cast<int>(
+            paletteManager.GetCurrentPalette().getColors().size());
+        ImGui::SliderInt("First Color", &bandFirst, 1,
+                         std::max(colorCount - 1, 1));
+        ImGui::SliderInt("Bands", &bandCount, 1, 16);
+    }
+
+    ImGui::Separator();
+    if (ImGui::Button("Generate")) {
+        if (Generate(voxelManager, paletteManager) != 0) {
+            lastMilliseconds = -1;
+        }
+    }
+    if (lastMilliseconds >= 0) {
+        ImGui::SameLine();
+        ImGui::Text("%lld ms", lastMilliseconds);
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,312 @@
+#include "ImageImporter.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <bimg/decode.h>
+#include <bx/allocator.h>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+namespace {
+
+// Rec. 709 weights in 8 bit fixed point, white stays 255
+inline uint32_t Luminance(const glm::u8vec4& color) {
+    return (color.r * 54u + color.g * 183u + color.b * 19u) >> 8;
+}
+
+// "slice2" before "slice10", so unpadded numbering still stacks in order
+bool NaturalLess(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (std::isdigit(static_cast<unsigned char>(a[i])) &&
+            std::isdigit(static_cast<unsigned char>(b[j]))) {
+            size_t iEnd = i, jEnd = j;
+            while (iEnd < a.size() &&
+                   std::isdigit(static_cast<unsigned char>(a[iEnd]))) {
+                ++iEnd;
+            }
+            while (jEnd < b.size() &&
+                   std::isdigit(static_cast<unsigned char>(b[jEnd]))) {
+                ++jEnd;
+            }
+            while (i + 1 < iEnd && a[i] == '0') {
+                ++i;
+            }
+            while (j + 1 < jEnd && b[j] == '0') {
+                ++j;
+            }
+            if (iEnd - i != jEnd - j) {
+                return iEnd - i < jEnd - j;
+            }
+            const int order = a.compare(i, iEnd - i, b, j, jEnd - j);
+            if (order != 0) {
+                return order < 0;
+            }
+            i = iEnd;
+            j = jEnd;
+            continue;
+        }
+        if (a[i] != b[j]) {
+            return a[i] < b[j];
+        }
+        ++i;
+        ++j;
+    }
+    return a.size() - i < b.size() - j;
+}
+
+// Nearest current palette entry of an RGB color by squared distance. Images
+// repeat few colors, so callers keep a cache of what was already matched.
+class PaletteMatcher {
+  private:
+    std::vector<glm::ivec3> colors;
+
+  public:
+    using Cache = std::unordered_map<uint32_t, uint16_t>;
+
+    explicit PaletteMatcher(const std::vector<glm::vec4>& palette) {
+        colors.reserve(palette.size());
+        for (const glm::vec4& color : palette) {
+            colors.push_back(glm::ivec3(glm::vec3(color) * 255.0f + 0.5f));
+        }
+    }
+
+    uint16_t Nearest(const glm::u8vec4& color) const {
+        const glm::ivec3 rgb(color);
+        uint16_t best = 0;
+        int bestDistance = std::numeric_limits<int>::max();
+        for (size_t i = 1; i < colors.size(); ++i) {
+            const glm::ivec3 d = colors[i] - rgb;
+            const int distance = d.x * d.x + d.y * d.y + d.z * d.z;
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = static_cast<uint16_t>(i);
+            }
+        }
+        return best;
+    }
+
+    inline uint16_t Match(const glm::u8vec4& color, Cache& cache) const {
+        const uint32_t key = uint32_t(color.r) | uint32_t(color.g) << 8 |
+                             uint32_t(color.b) << 16;
+        auto [entry, inserted] = cache.try_emplace(key, 0);
+        if (inserted) {
+            entry->second = Nearest(color);
+        }
+        return entry->second;
+    }
+};
+
+} // namespace
+
+ImageImporter::ImageImporter() {}
+
+ImageImporter::~ImageImporter() {}
+
+int ImageImporter::Decode(const std::string& path, Image& image,
+                          std::string& error) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        error = "Failed to open file: " + path;
+        return 1;
+    }
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    if (file.fail()) {
+        error = "Failed to read file: " + path;
+        return 1;
+    }
+
+    // bimg converts whatever the file holds to RGBA8 while decoding
+    bx::DefaultAllocator allocator;
+    bimg::ImageContainer* container = bimg::imageParse(
+        &allocator, data.data(), static_cast<uint32_t>(data.size()),
+        bimg::TextureFormat::RGBA8);
+    if (container == nullptr) {
+        error = "Failed to decode image: " + path;
+        return 1;
+    }
+    image.width = container->m_width;
+    image.height = container->m_height;
+    const size_t count = size_t(image.width) * image.height;
+    if (container->m_size < count * sizeof(glm::u8vec4)) {
+        bimg::imageFree(container);
+        error = "Unexpected image data in: " + path;
+        return 1;
+    }
+    image.pixels.resize(count);
+    std::memcpy(image.pixels.data(), container->m_data,
+                count * sizeof(glm::u8vec4));
+    bimg::imageFree(container);
+    return 0;
+}
+
+int ImageImporter::ImportSlices(const std::string& folder,
+                                VoxelManager& voxelManager,
+                                PaletteManager& paletteManager,
+                                std::string& log, std::string& error) {
+    static const char* extensions[] = {".png", ".jpg", ".jpeg", ".tga",
+                                       ".bmp"};
+    std::vector<std::string> paths;
+    std::error_code code;
+    for (const auto& entry :
+         std::filesystem::directory_iterator(folder, code)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        if (std::find(std::begin(extensions), std::end(extensions),
+                      extension) != std::end(extensions)) {
+            paths.push_back(entry.path().string());
+        }
+    }
+    if (code) {
+        error = "Failed to read folder: " + folder;
+        return 1;
+    }
+    if (paths.empty()) {
+        error = "No images found in " + folder;
+        return 1;
+    }
+    if (paths.size() > maxSize) {
+        error = "More than " + std::to_string(maxSize) + " slices";
+        return 1;
+    }
+    std::sort(paths.begin(), paths.end(),
+              [](const std::string& a, const std::string& b) {
+                  return NaturalLess(
+                      std::filesystem::path(a).filename().string(),
+                      std::filesystem::path(b).filename().string());
+              });
+
+    // The first slice sets the size every other one has to match
+    Image first;
+    if (Decode(paths[0], first, error) != 0) {
+        return 1;
+    }
+    const uint32_t width = first.width;
+    const uint32_t height = first.height;
+    const uint32_t depth = static_cast<uint32_t>(paths.size());
+    if (width == 0 || height == 0 || width > maxSize || height > maxSize) {
+        error = "Slices must be 1 to " + std::to_string(maxSize) +
+                " pixels wide and high";
+        return 1;
+    }
+    log += "Slices: " + std::to_string(depth) + " of " +
+           std::to_string(width) + "x" + std::to_string(height) + "\n";
+
+    const PaletteMatcher matcher(
+        paletteManager.GetCurrentPalette().getColors());
+    const size_t sliceStride = size_t(width) * height;
+    std::vector<float> voxels(sliceStride * depth, 0.0f);
+    std::vector<std::string> errors(depth);
+    Parallel::For(0, depth, [&](uint32_t z) {
+        Image decoded;
+        const Image* image = &first;
+        if (z > 0) {
+            if (Decode(paths[z], decoded, errors[z]) != 0) {
+                return;
+            }
+            image = &decoded;
+        }
+        if (image->width != width || image->height != height) {
+            errors[z] = paths[z] + " is not " + std::to_string(width) + "x" +
+                        std::to_string(height);
+            return;
+        }
+        PaletteMatcher::Cache cache;
+        float* slice = &voxels[z * sliceStride];
+        for (uint32_t row = 0; row < height; ++row) {
+            // Image rows run top down, the volume Y up
+            float* out = slice + size_t(height - 1 - row) * width;
+            const glm::u8vec4* in = &image->pixels[size_t(row) * width];
+            for (uint32_t x = 0; x < width; ++x) {
+                const glm::u8vec4& pixel = in[x];
+                if (pixel.a < 128 || Luminance(pixel) < uint32_t(threshold)) {
+                    continue;
+                }
+                out[x] = VoxelIndex<uint16_t>::Decode(
+                    matcher.Match(pixel, cache));
+            }
+        }
+    });
+    for (const std::string& sliceError : errors) {
+        if (!sliceError.empty()) {
+            error = sliceError;
+            return 1;
+        }
+    }
+
+    voxelManager.setSize(width, height, depth);
+    voxelManager.newVoxelData(std::move(voxels), width, height, depth);
+    return 0;
+}
+
+int ImageImporter::ImportHeightmap(const std::string& path,
+                                   VoxelManager& voxelManager,
+                                   PaletteManager& paletteManager,
+                                   std::string& log, std::string& error) {
+    Image image;
+    if (Decode(path, image, error) != 0) {
+        return 1;
+    }
+    if (image.width == 0 || image.height == 0 || image.width > maxSize ||
+        image.height > maxSize) {
+        error = "Heightmaps must be 1 to " + std::to_string(maxSize) +
+                " pixels wide and high";
+        return 1;
+    }
+    // Pixels are columns on the XZ plane, rows running along Z
+    const uint32_t width = image.width;
+    const uint32_t height = std::clamp(heightScale, 1, maxSize);
+    const uint32_t depth = image.height;
+    const bool gray = std::all_of(
+        image.pixels.begin(), image.pixels.end(),
+        [](const glm::u8vec4& p) { return p.r == p.g && p.g == p.b; });
+    log += "Heightmap: " + std::to_string(width) + "x" +
+           std::to_string(depth) + (gray ? ", gray" : ", color") + "\n";
+
+    Palette& palette = paletteManager.GetCurrentPalette();
+    const float selected =
+        VoxelIndex<uint16_t>::Decode(palette.getSelectedIndex());
+    const PaletteMatcher matcher(palette.getColors());
+    const size_t slabStride = size_t(width) * height;
+    std::vector<float> voxels(slabStride * depth, 0.0f);
+
+    // Every image row fills one Z slab, rows are split in even ranges so
+    // each thread keeps one match cache
+    const uint32_t partCount = std::min(Parallel::ThreadCount(), depth);
+    Parallel::For(0, partCount, [&](uint32_t p) {
+        PaletteMatcher::Cache cache;
+        const uint32_t end = uint32_t(uint64_t(depth) * (p + 1) / partCount);
+        for (uint32_t z = uint32_t(uint64_t(depth) * p / partCount); z < end;
+             ++z) {
+            float* slab = &voxels[z * slabStride];
+            const glm::u8vec4* in = &image.pixels[size_t(z) * width];
+            for (uint32_t x = 0; x < width; ++x) {
+                const glm::u8vec4& pixel = in[x];
+                const uint32_t top = (Luminance(pixel) * height + 127) / 255;
+                if (pixel.a < 128 || top == 0) {
+                    continue;
+                }
+                const float value =
+                    gray ? selected
+                         : VoxelIndex<uint16_t>::Decode(
+                               matcher.Match(pixel, cache));
+                for (uint32_t y = 0; y < top; ++y) {
+                    slab[size_t(y) * width + x] = value;
+                }
+            }
+        }
+    });
+
+    voxelManager.setSize(width, height, depth);
+    voxelManager.newVoxelData(std::move(voxels), width, height, depth);
+    return 0;
+}
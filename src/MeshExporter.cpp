@@ -0,0 +1,746 @@
+#include "MeshExporter.hpp"
+#include "Parallel.hpp"
+#include "glm/common.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace {
+
+const glm::vec3 faceNormals[6] = {{1.0f, 0.0f, 0.0f},  {-1.0f, 0.0f, 0.0f},
+                                  {0.0f, 1.0f, 0.0f},  {0.0f, -1.0f, 0.0f},
+                                  {0.0f, 0.0f, 1.0f},  {0.0f, 0.0f, -1.0f}};
+
+// Accumulates output in memory and hands it to the stream in large blocks,
+// so exporting millions of quads does not go through the stream per number
+class StreamWriter {
+  private:
+    std::ofstream& file;
+    std::string buffer;
+
+  public:
+    explicit StreamWriter(std::ofstream& file) : file(file) {
+        buffer.reserve(1 << 21);
+    }
+    ~StreamWriter() { Flush(); }
+
+    inline void Put(const char* text) {
+        buffer += text;
+        if (buffer.size() > (1 << 20)) {
+            Flush();
+        }
+    }
+    inline void Put(const std::string& text) { Put(text.c_str()); }
+    inline void Put(float value) {
+        char temp[32];
+        auto result = std::to_chars(temp, temp + sizeof(temp), value);
+        buffer.append(temp, result.ptr);
+    }
+    inline void Put(uint32_t value) {
+        char temp[16];
+        auto result = std::to_chars(temp, temp + sizeof(temp), value);
+        buffer.append(temp, result.ptr);
+    }
+    template <typename T> inline void Raw(const T& value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        if (buffer.size() > (1 << 20)) {
+            Flush();
+        }
+    }
+    inline void Flush() {
+        file.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+};
+
+inline float SrgbToLinear(float c) {
+    return std::pow(std::clamp(c, 0.0f, 1.0f), 2.2f);
+}
+
+inline uint8_t ToByte(float c) {
+    return static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Minimal RGBA8 PNG writer using stored (uncompressed) deflate blocks; the
+// palette texture is tiny, so compression is not worth a dependency.
+bool WritePng(const std::string& path, uint32_t w, uint32_t h,
+              const std::vector<uint8_t>& rgba) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    auto putU32 = [](std::vector<uint8_t>& out, uint32_t v) {
+        out.push_back(v >> 24);
+        out.push_back((v >> 16) & 0xff);
+        out.push_back((v >> 8) & 0xff);
+        out.push_back(v & 0xff);
+    };
+    auto writeChunk = [&](const char* type, const std::vector<uint8_t>& data) {
+        std::vector<uint8_t> chunk;
+        putU32(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        putU32(chunk, Crc32(chunk.data() + 4, chunk.size() - 4));
+        file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    };
+
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<uint8_t> header;
+    putU32(header, w);
+    putU32(header, h);
+    header.insert(header.end(), {8, 6, 0, 0, 0}); // 8 bit RGBA
+    writeChunk("IHDR", header);
+
+    // Scanlines with filter type 0
+    std::vector<uint8_t> raw;
+    raw.reserve(size_t(h) * (w * 4 + 1));
+    for (uint32_t y = 0; y < h; ++y) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba.begin() + size_t(y) * w * 4,
+                   rgba.begin() + size_t(y + 1) * w * 4);
+    }
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    for (size_t offset = 0; offset < raw.size() || offset == 0;) {
+        size_t len = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + len >= raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(len & 0xff);
+        zlib.push_back(len >> 8);
+        zlib.push_back(~len & 0xff);
+        zlib.push_back((~len >> 8) & 0xff);
+        zlib.insert(zlib.end(), raw.begin() + offset,
+                    raw.begin() + offset + len);
+        offset += len;
+        if (last) {
+            break;
+        }
+    }
+    uint32_t a = 1, b = 0;
+    for (uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    putU32(zlib, (b << 16) | a);
+    writeChunk("IDAT", zlib);
+    writeChunk("IEND", {});
+    return !file.fail();
+}
+
+} // namespace
+
+MeshExporter::MeshExporter() {}
+
+MeshExporter::~MeshExporter() {}
+
+int MeshExporter::Export(const std::string& path, Format format,
+                         VoxelManager& voxelManager,
+                         PaletteManager& paletteManager, std::string& log,
+                         std::string& error, const SelectionMask* selection) {
+    colors = paletteManager.GetCurrentPalette().getColors();
+    BuildQuads(voxelManager, selection);
+    if (quads.empty()) {
+        error = "Nothing to export, the model is empty";
+        return 1;
+    }
+    log += "Quads: " + std::to_string(quads.size()) +
+           ", triangles: " + std::to_string(quads.size() * 2) + "\n";
+
+    int res = 1;
+    switch (format) {
+    case Format::OBJ:
+        res = WriteObj(path, error);
+        break;
+    case Format::PLY:
+        res = WritePly(path, error);
+        break;
+    case Format::GLTF:
+        res = WriteGltf(path, error);
+        break;
+    }
+
+    quads.clear();
+    quads.shrink_to_fit();
+    return res;
+}
+
+void MeshExporter::BuildQuads(VoxelManager& voxelManager,
+                              const SelectionMask* selection) {
+    const glm::vec4 gridSize = voxelManager.getSize();
+    const glm::ivec3 size(gridSize.x, gridSize.y, gridSize.z);
+    const std::vector<float>& data = voxelManager.getVoxel();
+    auto voxelAt = [&](const glm::ivec3& p) -> uint16_t {
+        if (glm::any(glm::lessThan(p, glm::ivec3(0))) ||
+            glm::any(glm::greaterThanEqual(p, size))) {
+            return 0;
+        }
+        if (selection && !selection->test(p)) {
+            return 0;
+        }
+        size_t index = (size_t(p.z) * size.y + p.y) * size.x + p.x;
+        return static_cast<uint16_t>(data[index] * 255.0f + 0.5f);
+    };
+
+    const glm::ivec3 chunks = (size + chunkSize - 1) / chunkSize;
+    const uint32_t chunkCount = chunks.x * chunks.y * chunks.z;
+    std::vector<std::vector<Quad>> chunkQuads(chunkCount);
+
+    Parallel::For(0, chunkCount, [&](uint32_t c) {
+        glm::ivec3 chunk(c % chunks.x, (c / chunks.x) % chunks.y,
+                         c / (chunks.x * chunks.y));
+        glm::ivec3 start = chunk * chunkSize;
+        glm::ivec3 end = glm::min(start + chunkSize, size);
+        std::vector<uint16_t> mask(chunkSize * chunkSize);
+        std::vector<Quad>& out = chunkQuads[c];
+
+        for (int axis = 0; axis < 3; ++axis) {
+            const int u = (axis + 1) % 3;
+            const int v = (axis + 2) % 3;
+            const int du = end[u] - start[u];
+            const int dv = end[v] - start[v];
+            for (int negative = 0; negative < 2; ++negative) {
+                for (int d = start[axis]; d < end[axis]; ++d) {
+                    // Visible faces of this layer
+                    glm::ivec3 p;
+                    p[axis] = d;
+                    for (int j = 0; j < dv; ++j) {
+                        for (int i = 0; i < du; ++i) {
+                            p[u] = start[u] + i;
+                            p[v] = start[v] + j;
+                            uint16_t color = voxelAt(p);
+                            if (color != 0) {
+                                glm::ivec3 n = p;
+                                n[axis] += negative ? -1 : 1;
+                                if (voxelAt(n) != 0) {
+                                    color = 0;
+                                }
+                            }
+                            mask[j * du + i] = color;
+                        }
+                    }
+
+                    // Greedy merge into maximal same-colored rectangles
+                    for (int j = 0; j < dv; ++j) {
+                        for (int i = 0; i < du;) {
+                            uint16_t color = mask[j * du + i];
+                            if (color == 0) {
+                                ++i;
+                                continue;
+                            }
+                            int w = 1;
+                            while (i + w < du && mask[j * du + i + w] == color) {
+                                ++w;
+                            }
+                            int h = 1;
+                            for (; j + h < dv; ++h) {
+                                const uint16_t* row = &mask[(j + h) * du + i];
+                                if (!std::all_of(row, row + w, [&](uint16_t m) {
+                                        return m == color;
+                                    })) {
+                                    break;
+                                }
+                            }
+                            for (int k = 0; k < h; ++k) {
+                                std::fill_n(&mask[(j + k) * du + i], w, 0);
+                            }
+
+                            glm::ivec3 corner;
+                            corner[axis] = negative ? d : d + 1;
+                            corner[u] = start[u] + i;
+                            corner[v] = start[v] + j;
+                            Quad quad;
+                            quad.x = static_cast<uint16_t>(corner.x);
+                            quad.y = static_cast<uint16_t>(corner.y);
+                            quad.z = static_cast<uint16_t>(corner.z);
+                            quad.w = static_cast<uint16_t>(w);
+                            quad.h = static_cast<uint16_t>(h);
+                            quad.color = color;
+                            quad.face = static_cast<uint8_t>(axis * 2 + negative);
+                            out.push_back(quad);
+                            i += w;
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    // Counting sort by color, keeping chunk order within a color
+    uint16_t maxColor = 0;
+    size_t total = 0;
+    for (const auto& list : chunkQuads) {
+        total += list.size();
+        for (const Quad& quad : list) {
+            maxColor = std::max(maxColor, quad.color);
+        }
+    }
+    colorOffsets.assign(size_t(maxColor) + 2, 0);
+    for (const auto& list : chunkQuads) {
+        for (const Quad& quad : list) {
+            colorOffsets[quad.color + 1]++;
+        }
+    }
+    for (size_t i = 1; i < colorOffsets.size(); ++i) {
+        colorOffsets[i] += colorOffsets[i - 1];
+    }
+    quads.resize(total);
+    std::vector<uint32_t> cursor(colorOffsets.begin(), colorOffsets.end() - 1);
+    for (auto& list : chunkQuads) {
+        for (const Quad& quad : list) {
+            quads[cursor[quad.color]++] = quad;
+        }
+        std::vector<Quad>().swap(list);
+    }
+}
+
+void MeshExporter::QuadCorners(const Quad& quad, glm::vec3 corners[4]) const {
+    const int axis = quad.face / 2;
+    const bool negative = quad.face & 1;
+    glm::vec3 p(quad.x, quad.y, quad.z);
+    glm::vec3 du(0.0f), dv(0.0f);
+    du[(axis + 1) % 3] = quad.w;
+    dv[(axis + 2) % 3] = quad.h;
+    // Counter-clockwise seen from the side the normal points to
+    corners[0] = p * voxelSize;
+    corners[1] = (negative ? p + dv : p + du) * voxelSize;
+    corners[2] = (p + du + dv) * voxelSize;
+    corners[3] = (negative ? p + du : p + dv) * voxelSize;
+}
+
+int MeshExporter::WritePaletteTexture(const std::string& path,
+                                      std::string& error) {
+    std::vector<uint8_t> rgba(colors.size() * 4);
+    for (size_t i = 0; i < colors.size(); ++i) {
+        rgba[i * 4 + 0] = ToByte(colors[i].r);
+        rgba[i * 4 + 1] = ToByte(colors[i].g);
+        rgba[i * 4 + 2] = ToByte(colors[i].b);
+        rgba[i * 4 + 3] = ToByte(colors[i].a);
+    }
+    if (!WritePng(path, static_cast<uint32_t>(colors.size()), 1, rgba)) {
+        error = "Failed to write palette texture: " + path;
+        return 1;
+    }
+    return 0;
+}
+
+int MeshExporter::WriteObj(const std::string& path, std::string& error) {
+    const std::filesystem::path filePath(path);
+    const std::string stem = filePath.stem().string();
+    const std::string mtlName = stem + ".mtl";
+    const std::string textureName = stem + "_palette.png";
+    const bool vertexColors = colorMode == ColorMode::VertexColors;
+    const bool paletteTexture = colorMode == ColorMode::PaletteTexture;
+
+    if (!vertexColors) {
+        std::ofstream mtlFile(filePath.parent_path() / mtlName);
+        if (!mtlFile.is_open()) {
+            error = "Failed to open file: " + mtlName;
+            return 1;
+        }
+        StreamWriter mtl(mtlFile);
+        if (paletteTexture) {
+            mtl.Put("newmtl palette\nKd 1 1 1\nmap_Kd ");
+            mtl.Put(textureName);
+            mtl.Put("\n");
+        } else {
+            for (size_t c = 1; c + 1 < colorOffsets.size(); ++c) {
+                if (colorOffsets[c] == colorOffsets[c + 1] ||
+                    c >= colors.size()) {
+                    continue;
+                }
+                mtl.Put("newmtl color_");
+                mtl.Put(static_cast<uint32_t>(c));
+                mtl.Put("\nKd ");
+                for (int k = 0; k < 3; ++k) {
+                    mtl.Put(colors[c][k]);
+                    mtl.Put(k < 2 ? " " : "\nd ");
+                }
+                mtl.Put(colors[c].a);
+                mtl.Put("\n");
+            }
+        }
+        mtl.Flush();
+        if (mtlFile.fail()) {
+            error = "Failed to write materials";
+            return 1;
+        }
+    }
+    if (paletteTexture &&
+        WritePaletteTexture((filePath.parent_path() / textureName).string(),
+                            error) != 0) {
+        return 1;
+    }
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        error = "Failed to open file: " + path;
+        return 1;
+    }
+    StreamWriter out(file);
+    out.Put("# Nuum greedy mesh export\n");
+    if (!vertexColors) {
+        out.Put("mtllib " + mtlName + "\n");
+    }
+    for (const glm::vec3& n : faceNormals) {
+        out.Put("vn ");
+        out.Put(n.x);
+        out.Put(" ");
+        out.Put(n.y);
+        out.Put(" ");
+        out.Put(n.z);
+        out.Put("\n");
+    }
+    if (paletteTexture) {
+        for (size_t c = 0; c < colors.size(); ++c) {
+            out.Put("vt ");
+            out.Put((c + 0.5f) / colors.size());
+            out.Put(" 0.5\n");
+        }
+        out.Put("usemtl palette\n");
+    }
+
+    uint32_t vertex = 1;
+    for (size_t c = 1; c + 1 < colorOffsets.size(); ++c) {
+        if (colorOffsets[c] == colorOffsets[c + 1]) {
+            continue;
+        }
+        const glm::vec4 color =
+            c < colors.size() ? colors[c] : glm::vec4(1.0f);
+        out.Put("g color_");
+        out.Put(static_cast<uint32_t>(c));
+        out.Put("\n");
+        if (colorMode == ColorMode::Materials) {
+            out.Put("usemtl color_");
+            out.Put(static_cast<uint32_t>(c));
+            out.Put("\n");
+        }
+        for (uint32_t q = colorOffsets[c]; q < colorOffsets[c + 1]; ++q) {
+            glm::vec3 corners[4];
+            QuadCorners(quads[q], corners);
+            for (const glm::vec3& p : corners) {
+                out.Put("v ");
+                out.Put(p.x);
+                out.Put(" ");
+                out.Put(p.y);
+                out.Put(" ");
+                out.Put(p.z);
+                if (vertexColors) {
+                    for (int k = 0; k < 3; ++k) {
+                        out.Put(" ");
+                        out.Put(color[k]);
+                    }
+                }
+                out.Put("\n");
+            }
+            out.Put("f");
+            for (uint32_t k = 0; k < 4; ++k) {
+                out.Put(" ");
+                out.Put(vertex + k);
+                out.Put("/");
+                if (paletteTexture) {
+                    out.Put(static_cast<uint32_t>(c + 1));
+                }
+                out.Put("/");
+                out.Put(static_cast<uint32_t>(quads[q].face + 1));
+            }
+            out.Put("\n");
+            vertex += 4;
+        }
+    }
+    out.Flush();
+    if (file.fail()) {
+        error = "Failed to write mesh data";
+        return 1;
+    }
+    return 0;
+}
+
+int MeshExporter::WritePly(const std::string& path, std::string& error) {
+    const std::filesystem::path filePath(path);
+    const std::string textureName = filePath.stem().string() + "_palette.png";
+    const bool paletteTexture = colorMode == ColorMode::PaletteTexture;
+    if (paletteTexture &&
+        WritePaletteTexture((filePath.parent_path() / textureName).string(),
+                            error) != 0) {
+        return 1;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        error = "Failed to open file: " + path;
+        return 1;
+    }
+    StreamWriter out(file);
+    out.Put("ply\nformat binary_little_endian 1.0\n"
+            "comment Nuum greedy mesh export\n");
+    if (paletteTexture) {
+        out.Put("comment TextureFile " + textureName + "\n");
+    }
+    out.Put("element vertex ");
+    out.Put(static_cast<uint32_t>(quads.size() * 4));
+    out.Put("\nproperty float x\nproperty float y\nproperty float z\n"
+            "property float nx\nproperty float ny\nproperty float nz\n");
+    if (paletteTexture) {
+        out.Put("property float s\nproperty float t\n");
+    } else {
+        out.Put("property uchar red\nproperty uchar green\n"
+                "property uchar blue\nproperty uchar alpha\n");
+    }
+    out.Put("element face ");
+    out.Put(static_cast<uint32_t>(quads.size()));
+    out.Put("\nproperty list uchar uint vertex_indices\nend_header\n");
+
+    for (size_t c = 1; c + 1 < colorOffsets.size(); ++c) {
+        const glm::vec4 color =
+            c < colors.size() ? colors[c] : glm::vec4(1.0f);
+        const uint8_t rgba[4] = {ToByte(color.r), ToByte(color.g),
+                                 ToByte(color.b), ToByte(color.a)};
+        const float s = (c + 0.5f) / colors.size();
+        for (uint32_t q = colorOffsets[c]; q < colorOffsets[c + 1]; ++q) {
+            glm::vec3 corners[4];
+            QuadCorners(quads[q], corners);
+            const glm::vec3& n = faceNormals[quads[q].face];
+            for (const glm::vec3& p : corners) {
+                out.Raw(p);
+                out.Raw(n);
+                if (paletteTexture) {
+                    out.Raw(s);
+                    out.Raw(0.5f);
+                } else {
+                    out.Raw(rgba);
+                }
+            }
+        }
+    }
+    for (uint32_t q = 0; q < quads.size(); ++q) {
+        const uint8_t count = 4;
+        const uint32_t indices[4] = {q * 4, q * 4 + 1, q * 4 + 2, q * 4 + 3};
+        out.Raw(count);
+        out.Raw(indices);
+    }
+    out.Flush();
+    if (file.fail()) {
+        error = "Failed to write mesh data";
+        return 1;
+    }
+    return 0;
+}
+
+int MeshExporter::WriteGltf(const std::string& path, std::string& error) {
+    const std::filesystem::path filePath(path);
+    const std::string stem = filePath.stem().string();
+    const std::string binName = stem + ".bin";
+    const std::string textureName = stem + "_palette.png";
+    const bool vertexColors = colorMode == ColorMode::VertexColors;
+    const bool paletteTexture = colorMode == ColorMode::PaletteTexture;
+    if (paletteTexture &&
+        WritePaletteTexture((filePath.parent_path() / textureName).string(),
+                            error) != 0) {
+        return 1;
+    }
+
+    const uint32_t vertexCount = static_cast<uint32_t>(quads.size() * 4);
+    const uint32_t indexCount = static_cast<uint32_t>(quads.size() * 6);
+    const uint32_t attributeStride = paletteTexture ? 8 : 4;
+    const uint32_t positionOffset = 0;
+    const uint32_t normalOffset = positionOffset + vertexCount * 12;
+    const uint32_t attributeOffset = normalOffset + vertexCount * 12;
+    const uint32_t indexOffset =
+        attributeOffset +
+        (vertexColors || paletteTexture ? vertexCount * attributeStride : 0);
+    const uint32_t bufferLength = indexOffset + indexCount * 4;
+
+    // Binary buffer, one streamed pass per attribute
+    std::ofstream binFile(filePath.parent_path() / binName, std::ios::binary);
+    if (!binFile.is_open()) {
+        error = "Failed to open file: " + binName;
+        return 1;
+    }
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    {
+        StreamWriter bin(binFile);
+        for (const Quad& quad : quads) {
+            glm::vec3 corners[4];
+            QuadCorners(quad, corners);
+            for (const glm::vec3& p : corners) {
+                bin.Raw(p);
+                boundsMin = glm::min(boundsMin, p);
+                boundsMax = glm::max(boundsMax, p);
+            }
+        }
+        for (const Quad& quad : quads) {
+            for (int k = 0; k < 4; ++k) {
+                bin.Raw(faceNormals[quad.face]);
+            }
+        }
+        if (vertexColors || paletteTexture) {
+            for (const Quad& quad : quads) {
+                const glm::vec4 color = quad.color < colors.size()
+                                            ? colors[quad.color]
+                                            : glm::vec4(1.0f);
+                const uint8_t rgba[4] = {ToByte(SrgbToLinear(color.r)),
+                                         ToByte(SrgbToLinear(color.g)),
+                                         ToByte(SrgbToLinear(color.b)),
+                                         ToByte(color.a)};
+                const float uv[2] = {(quad.color + 0.5f) / colors.size(),
+                                     0.5f};
+                for (int k = 0; k < 4; ++k) {
+                    if (paletteTexture) {
+                        bin.Raw(uv);
+                    } else {
+                        bin.Raw(rgba);
+                    }
+                }
+            }
+        }
+        for (uint32_t q = 0; q < quads.size(); ++q) {
+            const uint32_t indices[6] = {q * 4,     q * 4 + 1, q * 4 + 2,
+                                         q * 4,     q * 4 + 2, q * 4 + 3};
+            bin.Raw(indices);
+        }
+    }
+    if (binFile.fail()) {
+        error = "Failed to write mesh buffer";
+        return 1;
+    }
+
+    auto num = [](float value) {
+        char temp[32];
+        auto result = std::to_chars(temp, temp + sizeof(temp), value);
+        return std::string(temp, result.ptr);
+    };
+    auto vec3 = [&](const glm::vec3& v) {
+        return "[" + num(v.x) + "," + num(v.y) + "," + num(v.z) + "]";
+    };
+    auto view = [](uint32_t offset, uint32_t length, int target) {
+        return "{\"buffer\":0,\"byteOffset\":" + std::to_string(offset) +
+               ",\"byteLength\":" + std::to_string(length) +
+               ",\"target\":" + std::to_string(target) + "}";
+    };
+
+    std::string bufferViews = view(positionOffset, vertexCount * 12, 34962) +
+                              "," + view(normalOffset, vertexCount * 12, 34962);
+    std::string accessors =
+        "{\"bufferView\":0,\"componentType\":5126,\"count\":" +
+        std::to_string(vertexCount) + ",\"type\":\"VEC3\",\"min\":" +
+        vec3(boundsMin) + ",\"max\":" + vec3(boundsMax) + "}," +
+        "{\"bufferView\":1,\"componentType\":5126,\"count\":" +
+        std::to_string(vertexCount) + ",\"type\":\"VEC3\"}";
+    std::string attributes = "\"POSITION\":0,\"NORMAL\":1";
+    int indexView = 2;
+    if (vertexColors || paletteTexture) {
+        bufferViews +=
+            "," + view(attributeOffset, vertexCount * attributeStride, 34962);
+        if (paletteTexture) {
+            accessors += ",{\"bufferView\":2,\"componentType\":5126,\"count\":" +
+                         std::to_string(vertexCount) + ",\"type\":\"VEC2\"}";
+            attributes += ",\"TEXCOORD_0\":2";
+        } else {
+            accessors += ",{\"bufferView\":2,\"componentType\":5121,"
+                         "\"normalized\":true,\"count\":" +
+                         std::to_string(vertexCount) + ",\"type\":\"VEC4\"}";
+            attributes += ",\"COLOR_0\":2";
+        }
+        indexView = 3;
+    }
+    bufferViews += "," + view(indexOffset, indexCount * 4, 34963);
+
+    // One primitive per palette color, or a single one when the color comes
+    // from the vertices or the palette texture
+    std::string primitives;
+    std::string materials;
+    int accessor = indexView;
+    auto addPrimitive = [&](uint32_t firstQuad, uint32_t quadCount,
+                            int material) {
+        accessors += ",{\"bufferView\":" + std::to_string(indexView) +
+                     ",\"byteOffset\":" + std::to_string(firstQuad * 24) +
+                     ",\"componentType\":5125,\"count\":" +
+                     std::to_string(quadCount * 6) + ",\"type\":\"SCALAR\"}";
+        primitives += std::string(primitives.empty() ? "" : ",") +
+                      "{\"attributes\":{" + attributes +
+                      "},\"indices\":" + std::to_string(accessor++) +
+                      ",\"material\":" + std::to_string(material) + "}";
+    };
+    if (colorMode == ColorMode::Materials) {
+        int material = 0;
+        for (size_t c = 1; c + 1 < colorOffsets.size(); ++c) {
+            uint32_t count = colorOffsets[c + 1] - colorOffsets[c];
+            if (count == 0) {
+                continue;
+            }
+            const glm::vec4 color =
+                c < colors.size() ? colors[c] : glm::vec4(1.0f);
+            materials += std::string(materials.empty() ? "" : ",") +
+                         "{\"name\":\"color_" + std::to_string(c) +
+                         "\",\"pbrMetallicRoughness\":{\"baseColorFactor\":[" +
+                         num(SrgbToLinear(color.r)) + "," +
+                         num(SrgbToLinear(color.g)) + "," +
+                         num(SrgbToLinear(color.b)) + "," + num(color.a) +
+                         "],\"metallicFactor\":0,\"roughnessFactor\":1}}";
+            addPrimitive(colorOffsets[c], count, material++);
+        }
+    } else {
+        materials = "{\"name\":\"palette\",\"pbrMetallicRoughness\":{";
+        if (paletteTexture) {
+            materials += "\"baseColorTexture\":{\"index\":0},";
+        }
+        materials += "\"metallicFactor\":0,\"roughnessFactor\":1}}";
+        addPrimitive(0, static_cast<uint32_t>(quads.size()), 0);
+    }
+
+    std::string json =
+        "{\"asset\":{\"version\":\"2.0\",\"generator\":\"Nuum\"},"
+        "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+        "\"nodes\":[{\"mesh\":0,\"name\":\"" +
+        stem + "\"}],\"meshes\":[{\"primitives\":[" + primitives +
+        "]}],\"materials\":[" + materials + "],";
+    if (paletteTexture) {
+        // Nearest filtering keeps palette texels from bleeding
+        json += "\"samplers\":[{\"magFilter\":9728,\"minFilter\":9728}],"
+                "\"images\":[{\"uri\":\"" +
+                textureName +
+                "\"}],\"textures\":[{\"sampler\":0,\"source\":0}],";
+    }
+    json += "\"buffers\":[{\"uri\":\"" + binName +
+            "\",\"byteLength\":" + std::to_string(bufferLength) +
+            "}],\"bufferViews\":[" + bufferViews + "],\"accessors\":[" +
+            accessors + "]}\n";
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        error = "Failed to open file: " + path;
+        return 1;
+    }
+    file.write(json.data(), json.size());
+    if (file.fail()) {
+        error = "Failed to write glTF file";
+        return 1;
+    }
+    return 0;
+}
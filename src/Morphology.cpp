@@ -0,0 +1,347 @@
+#include "Morphology.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+// acc += add on bit-sliced counters: plane i holds bit i of 64 counts
+template <int AccBits, int AddBits>
+inline void AddSliced(uint64_t* acc, const uint64_t* add) {
+    uint64_t carry = 0;
+    for (int i = 0; i < AccBits; ++i) {
+        const uint64_t a = acc[i];
+        const uint64_t b = i < AddBits ? add[i] : 0;
+        acc[i] = a ^ b ^ carry;
+        carry = (a & b) | (carry & (a ^ b));
+    }
+}
+
+// Most common value among the solid 26 neighbors of p, 0 if there is none
+float NeighborColor(const std::vector<float>& voxels, const glm::ivec3& size,
+                    const glm::ivec3& p) {
+    float values[26];
+    int counts[26];
+    int found = 0;
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                const glm::ivec3 q = p + glm::ivec3(dx, dy, dz);
+                if (glm::any(glm::lessThan(q, glm::ivec3(0))) ||
+                    glm::any(glm::greaterThanEqual(q, size))) {
+                    continue;
+                }
+                const float value =
+                    voxels[(size_t(q.z) * size.y + q.y) * size.x + q.x];
+                if (value <= 0.003f) {
+                    continue;
+                }
+                int i = 0;
+                while (i < found && values[i] != value) {
+                    ++i;
+                }
+                if (i == found) {
+                    values[found] = value;
+                    counts[found++] = 0;
+                }
+                ++counts[i];
+            }
+        }
+    }
+    if (found == 0) {
+        return 0.0f;
+    }
+    return values[std::max_element(counts, counts + found) - counts];
+}
+
+} // namespace
+
+Morphology::Morphology() {}
+
+Morphology::~Morphology() {}
+
+void Morphology::Load(const std::vector<float>& voxels) {
+    bits.assign(size_t(size.y) * size.z * wordsPerRow, 0);
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        for (int y = 0; y < size.y; ++y) {
+            const float* in = &voxels[(size_t(z) * size.y + y) * size.x];
+            uint64_t* row = &bits[rowOffset(y, z)];
+            for (int x = 0; x < size.x; ++x) {
+                row[x >> 6] |= uint64_t(in[x] > 0.003f) << (x & 63);
+            }
+        }
+    });
+}
+
+void Morphology::RowNeighbors(const uint64_t* row, size_t w, uint64_t& current,
+                              uint64_t& left, uint64_t& right) const {
+    // left holds the x - 1 neighbor of every bit, right the x + 1 one. With
+    // clamped edges the first and last voxel stand in for the outside.
+    current = row[w];
+    uint64_t low = w > 0 ? row[w - 1] >> 63 : (clampEdges ? current & 1 : 0);
+    uint64_t high = 0;
+    if (w + 1 < wordsPerRow) {
+        high = row[w + 1] & 1;
+    } else {
+        const int lastBit = (size.x - 1) & 63;
+        high = clampEdges ? (current >> lastBit) & 1 : 0;
+        current = (current & tailMask) | (high ? ~tailMask : 0);
+    }
+    left = (current << 1) | low;
+    right = (current >> 1) | (high << 63);
+}
+
+void Morphology::Pass(int axis, int radius, bool grow) {
+    if (axis == 0) {
+        // Rows are independent along x, each is stepped in place
+        Parallel::For(0, size.z, [&](uint32_t z) {
+            std::vector<uint64_t> source(wordsPerRow);
+            for (int y = 0; y < size.y; ++y) {
+                uint64_t* row = &bits[rowOffset(y, z)];
+                for (int step = 0; step < radius; ++step) {
+                    std::copy(row, row + wordsPerRow, source.begin());
+                    for (size_t w = 0; w < wordsPerRow; ++w) {
+                        uint64_t current, left, right;
+                        RowNeighbors(source.data(), w, current, left, right);
+                        row[w] = grow ? current | left | right
+                                      : current & left & right;
+                    }
+                    row[wordsPerRow - 1] &= tailMask;
+                }
+            }
+        });
+        return;
+    }
+
+    // Along y and z every row combines the 2 * radius + 1 rows around it
+    scratch = bits;
+    const int extent = axis == 1 ? size.y : size.z;
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        for (int y = 0; y < size.y; ++y) {
+            const int center = axis == 1 ? y : int(z);
+            uint64_t* dst = &bits[rowOffset(y, z)];
+            std::fill(dst, dst + wordsPerRow, grow ? 0 : ~0ull);
+            for (int k = center - radius; k <= center + radius; ++k) {
+                int n = k;
+                if (n < 0 || n >= extent) {
+                    if (!clampEdges) {
+                        if (!grow) {
+                            std::fill(dst, dst + wordsPerRow, 0);
+                            break;
+                        }
+                        continue;
+                    }
+                    n = std::clamp(n, 0, extent - 1);
+                }
+                const uint64_t* src =
+                    &scratch[axis == 1 ? rowOffset(n, z) : rowOffset(y, n)];
+                for (size_t w = 0; w < wordsPerRow; ++w) {
+                    dst[w] = grow ? dst[w] | src[w] : dst[w] & src[w];
+                }
+            }
+        }
+    });
+}
+
+void Morphology::Grow(int radius) {
+    for (int axis = 0; axis < 3; ++axis) {
+        Pass(axis, radius, true);
+    }
+}
+
+void Morphology::Shrink(int radius) {
+    for (int axis = 0; axis < 3; ++axis) {
+        Pass(axis, radius, false);
+    }
+}
+
+void Morphology::Majority() {
+    // Along x every bit becomes a 2-bit count of itself and its neighbors,
+    // kept as two bit planes
+    std::vector<uint64_t> low(bits.size());
+    std::vector<uint64_t> high(bits.size());
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        for (int y = 0; y < size.y; ++y) {
+            const size_t offset = rowOffset(y, z);
+            for (size_t w = 0; w < wordsPerRow; ++w) {
+                uint64_t current, left, right;
+                RowNeighbors(&bits[offset], w, current, left, right);
+                low[offset + w] = left ^ current ^ right;
+                high[offset + w] =
+                    (left & current) | (right & (left ^ current));
+            }
+        }
+    });
+
+    // The y and z passes are fused: three row counts make a column count
+    // of up to 9, three of those the full 27-neighborhood count
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        for (int y = 0; y < size.y; ++y) {
+            uint64_t* dst = &bits[rowOffset(y, z)];
+            for (size_t w = 0; w < wordsPerRow; ++w) {
+                uint64_t total[5] = {0, 0, 0, 0, 0};
+                for (int dz = -1; dz <= 1; ++dz) {
+                    const int nz = std::clamp(int(z) + dz, 0, size.z - 1);
+                    uint64_t column[4] = {0, 0, 0, 0};
+                    for (int dy = -1; dy <= 1; ++dy) {
+                        const int ny = std::clamp(y + dy, 0, size.y - 1);
+                        const size_t i = rowOffset(ny, nz) + w;
+                        const uint64_t count[2] = {low[i], high[i]};
+                        AddSliced<4, 2>(column, count);
+                    }
+                    AddSliced<5, 4>(total, column);
+                }
+                // total >= 14 is 16 and up, or 14 and 15
+                dst[w] = total[4] | (total[3] & total[2] & total[1]);
+            }
+            dst[wordsPerRow - 1] &= tailMask;
+        }
+    });
+}
+
+uint64_t Morphology::Store(VoxelManager& voxelManager,
+                           const std::vector<uint64_t>& before) {
+    std::vector<float>& voxels = voxelManager.getVoxel();
+    std::vector<uint64_t> pending(bits.size());
+    for (size_t i = 0; i < bits.size(); ++i) {
+        pending[i] = bits[i] & ~before[i];
+    }
+
+    struct Colored {
+        glm::ivec3 voxel;
+        float value;
+    };
+    std::vector<std::vector<Colored>> colored(size.z);
+    std::vector<glm::ivec3> sliceMin(size.z, size);
+    std::vector<glm::ivec3> sliceMax(size.z, glm::ivec3(0));
+    std::vector<uint64_t> sliceChanged(size.z, 0);
+    auto write = [&](VoxelManager::UsageDelta& delta, uint32_t z,
+                     const glm::ivec3& voxel, float value) {
+        float& target =
+            voxels[(size_t(voxel.z) * size.y + voxel.y) * size.x + voxel.x];
+        VoxelManager::countChange(delta, target, value);
+        target = value;
+        sliceMin[z] = glm::min(sliceMin[z], voxel);
+        sliceMax[z] = glm::max(sliceMax[z], voxel + 1);
+        ++sliceChanged[z];
+    };
+
+    // New voxels are colored from the solid side outwards: every round
+    // colors those with a colored neighbor, until a round finds none
+    bool progress = true;
+    while (progress) {
+        Parallel::For(0, size.z, [&](uint32_t z) {
+            colored[z].clear();
+            for (int y = 0; y < size.y; ++y) {
+                const size_t offset = rowOffset(y, z);
+                for (size_t w = 0; w < wordsPerRow; ++w) {
+                    for (uint64_t word = pending[offset + w]; word != 0;
+                         word &= word - 1) {
+                        const glm::ivec3 voxel(
+                            int(w * 64) + std::countr_zero(word), y, z);
+                        const float value = NeighborColor(voxels, size, voxel);
+                        if (value > 0.0f) {
+                            colored[z].push_back({voxel, value});
+                        }
+                    }
+                }
+            }
+        });
+        progress = false;
+        for (const std::vector<Colored>& slice : colored) {
+            progress = progress || !slice.empty();
+        }
+        Parallel::For(0, size.z, [&](uint32_t z) {
+            VoxelManager::UsageDelta delta = voxelManager.newUsageDelta();
+            for (const Colored& entry : colored[z]) {
+                write(delta, z, entry.voxel, entry.value);
+                pending[rowOffset(entry.voxel.y, z) + (entry.voxel.x >> 6)] &=
+                    ~(1ull << (entry.voxel.x & 63));
+            }
+            voxelManager.applyUsage(delta);
+        });
+    }
+
+    // Removed voxels are cleared; new ones left without a color stay empty
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        VoxelManager::UsageDelta delta = voxelManager.newUsageDelta();
+        for (int y = 0; y < size.y; ++y) {
+            const size_t offset = rowOffset(y, z);
+            for (size_t w = 0; w < wordsPerRow; ++w) {
+                for (uint64_t word = before[offset + w] & ~bits[offset + w];
+                     word != 0; word &= word - 1) {
+                    write(delta, z,
+                          glm::ivec3(int(w * 64) + std::countr_zero(word), y,
+                                     z),
+                          0.0f);
+                }
+            }
+        }
+        voxelManager.applyUsage(delta);
+    });
+
+    glm::ivec3 min = size;
+    glm::ivec3 max(0);
+    uint64_t changed = 0;
+    for (int z = 0; z < size.z; ++z) {
+        min = glm::min(min, sliceMin[z]);
+        max = glm::max(max, sliceMax[z]);
+        changed += sliceChanged[z];
+    }
+    voxelManager.markDirty(min, max);
+    return changed;
+}
+
+uint64_t Morphology::Apply(VoxelManager& voxelManager, Op op, int radius,
+                           const SelectionMask* region) {
+    size = glm::ivec3(voxelManager.getSize());
+    if (glm::any(glm::lessThanEqual(size, glm::ivec3(0)))) {
+        return 0;
+    }
+    wordsPerRow = (size_t(size.x) + 63) / 64;
+    tailMask = (size.x & 63) == 0 ? ~0ull : (1ull << (size.x & 63)) - 1;
+    radius = std::max(radius, 1);
+    // Hollowing treats the grid border as a surface so the shell is
+    // closed there; everything else acts as if the model went on
+    clampEdges = op != Op::Hollow;
+
+    Load(voxelManager.getVoxel());
+    const std::vector<uint64_t> before = bits;
+    switch (op) {
+    case Op::Dilate:
+        Grow(radius);
+        break;
+    case Op::Erode:
+        Shrink(radius);
+        break;
+    case Op::Open:
+        Shrink(radius);
+        Grow(radius);
+        break;
+    case Op::Close:
+        Grow(radius);
+        Shrink(radius);
+        break;
+    case Op::Smooth:
+        for (int i = 0; i < radius; ++i) {
+            Majority();
+        }
+        break;
+    case Op::Hollow:
+        Shrink(radius);
+        for (size_t i = 0; i < bits.size(); ++i) {
+            bits[i] = before[i] & ~bits[i];
+        }
+        break;
+    }
+    scratch = std::vector<uint64_t>();
+
+    // Same row layout as the selection, so masking is word by word
+    if (region && region->getSize() == size) {
+        const std::vector<uint64_t>& mask = region->getWords();
+        for (size_t i = 0; i < bits.size(); ++i) {
+            bits[i] = (before[i] & ~mask[i]) | (bits[i] & mask[i]);
+        }
+    }
+    return Store(voxelManager, before);
+}
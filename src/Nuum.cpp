@@ -9,6 +9,8 @@
 #include "imgui.h"
 #include <SDL_syswm.h>
 #include <SDL_video.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include "Vertex.hpp"
 
@@ -114,6 +116,20 @@ void Nuum::InitShaders() {
     u_camPos = bgfx::createUniform("u_camPos", bgfx::UniformType::Vec4);
     u_camMat = bgfx::createUniform("u_camMat", bgfx::UniformType::Mat4);
     u_gridSize = bgfx::createUniform("u_gridSize", bgfx::UniformType::Vec4);
+    u_lodParams = bgfx::createUniform("u_lodParams", bgfx::UniformType::Vec4);
+    u_lodSize = bgfx::createUniform("u_lodSize", bgfx::UniformType::Vec4);
+    u_atlasParams =
+        bgfx::createUniform("u_atlasParams", bgfx::UniformType::Vec4);
+    u_aoParams = bgfx::createUniform("u_aoParams", bgfx::UniformType::Vec4);
+    u_sdfParams = bgfx::createUniform("u_sdfParams", bgfx::UniformType::Vec4);
+    u_overlayParams =
+        bgfx::createUniform("u_overlayParams", bgfx::UniformType::Vec4);
+    u_overlaySize =
+        bgfx::createUniform("u_overlaySize", bgfx::UniformType::Vec4);
+    u_overlayTextureSize =
+        bgfx::createUniform("u_overlayTextureSize", bgfx::UniformType::Vec4);
+    u_indexParams =
+        bgfx::createUniform("u_indexParams", bgfx::UniformType::Vec4);
 
     layout.begin()
         .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
@@ -143,6 +159,67 @@ void Nuum::RenderViewport() {
     bgfx::setUniform(u_camMat, &invMat[0][0], 1);
     bgfx::setTexture(0, voxelManager.getVoxelTextureUniform(),
                      voxelManager.getTextureHandle());
+    BrickAtlas& atlas = voxelManager.getAtlas();
+    glm::vec4 atlasParams(atlas.getBrickGrid(), atlas.getAtlasSize());
+    bgfx::setUniform(u_atlasParams, &atlasParams[0], 1);
+    // Atlas and LOD texels are unorm palette indices of 8 or 16 bits
+    glm::vec4 indexParams(
+        DispatchIndex(voxelManager.getIndexFormat(),
+                      [](auto zero) {
+                          return VoxelIndex<decltype(zero)>::shaderScale;
+                      }),
+        0.0f, 0.0f, 0.0f);
+    bgfx::setUniform(u_indexParams, &indexParams[0], 1);
+    bgfx::setTexture(3, atlas.getPageTableUniform(), atlas.getPageTexture());
+    bgfx::setTexture(4, atlas.getOcclusionUniform(),
+                     atlas.getOcclusionTexture());
+    glm::vec4 aoParams(aoStrength, 0.0f, 0.0f, 0.0f);
+    bgfx::setUniform(u_aoParams, &aoParams[0], 1);
+
+    // Empty-space leaping once the distance field is fully on the GPU
+    DistanceField& distanceField = voxelManager.getDistanceField();
+    bool sphereTracing = distanceField.isTextureReady();
+    glm::vec4 sdfParams(sphereTracing ? 1.0f : 0.0f,
+                        distanceField.getTextureScale(), 0.0f, 0.0f);
+    bgfx::setUniform(u_sdfParams, &sdfParams[0], 1);
+    if (sphereTracing) {
+        bgfx::setTexture(5, distanceField.getTextureUniform(),
+                         distanceField.getTextureHandle());
+    }
+
+    // Tool preview composited over the model
+    OverlayVolume& overlay = voxelManager.getOverlay();
+    glm::vec4 overlayParams(overlay.getOrigin(),
+                            overlay.isVisible() ? 0.6f : 0.0f);
+    glm::vec4 overlaySize(overlay.getSize(),
+                          overlay.isOutline() ? 1.0f : 0.0f);
+    glm::vec4 overlayTextureSize(overlay.getCapacity(), 0.0f);
+    bgfx::setUniform(u_overlayParams, &overlayParams[0], 1);
+    bgfx::setUniform(u_overlaySize, &overlaySize[0], 1);
+    bgfx::setUniform(u_overlayTextureSize, &overlayTextureSize[0], 1);
+    if (overlay.isVisible() && !overlay.isOutline()) {
+        bgfx::setTexture(6, overlay.getTextureUniform(),
+                         overlay.getTextureHandle());
+    }
+
+    // Level of detail: angle covered by one viewport pixel decides the level
+    VoxelMipChain& mipChain = voxelManager.getMipChain();
+    bool lodAvailable =
+        useLod && bgfx::isValid(mipChain.getTextureHandle());
+    float pixelAngle = 2.0f * std::tan(glm::radians(camera.GetFov()) * 0.5f) /
+                       std::max(viewportSize.y, 1.0f);
+    // The top level is also where streamed out bricks in small grids read
+    glm::vec4 lodParams(pixelAngle, lodBias, mipChain.getLevelCount(),
+                        lodAvailable ? 1.0f : 0.0f);
+    glm::vec4 lodSize(mipChain.getTextureSize(),
+                      mipChain.getFirstTextureLevel());
+    bgfx::setUniform(u_lodParams, &lodParams[0], 1);
+    bgfx::setUniform(u_lodSize, &lodSize[0], 1);
+    // Also bound without LOD, bricks streamed out of the atlas read from it
+    if (bgfx::isValid(mipChain.getTextureHandle())) {
+        bgfx::setTexture(2, mipChain.getTextureUniform(),
+                         mipChain.getTextureHandle());
+    }
     bgfx::submit(0, program);
 }
 
@@ -167,7 +244,11 @@ void Nuum::RenderViewportWindow() {
         viewportAspectRatio = viewportSize.x / viewportSize.y;
     }
 
-    ImGui::Image(bgfx::getTexture(frameBuffer).idx, viewportSize);
+    if (pathTracer.IsShownInViewport()) {
+        ImGui::Image(pathTracer.getTextureHandle().idx, viewportSize);
+    } else {
+        ImGui::Image(bgfx::getTexture(frameBuffer).idx, viewportSize);
+    }
 
     isHoveringViewport =
         ImGui::IsWindowHovered(ImGuiHoveredFlags_AllowWhenBlockedByActiveItem |
@@ -197,6 +278,13 @@ void Nuum::RenderDebugWindow() {
         voxelManager.Resize(gridSize[0], gridSize[1], gridSize[2]);
     }
     ImGui::SliderFloat("Voxel Size", &gridSize[3], 0.1f, 10.0f);
+    ImGui::Checkbox("Level of Detail", &useLod);
+    ImGui::SliderFloat("LOD Bias", &lodBias, -2.0f, 2.0f);
+    ImGui::SliderFloat("Ambient Occlusion", &aoStrength, 0.0f, 1.0f);
+    if (ImGui::Checkbox("Sphere Tracing", &useSphereTracing)) {
+        voxelManager.getDistanceField().setGpuEnabled(
+            useSphereTracing, voxelManager.getVoxel());
+    }
     if (ImGui::InputFloat("FOV", &camera.GetFov())) {
         camera.SetUpdateState(true);
     }
@@ -209,6 +297,17 @@ void Nuum::RenderDebugWindow() {
     const auto& voxelSize = voxelManager.getSize();
     ImGui::Text("Voxel Size: %.1f, %.1f, %.1f", voxelSize.x, voxelSize.y,
                 voxelSize.z);
+    ImGui::Text("Resident Bricks: %d / %d",
+                voxelManager.getAtlas().getResidentCount(),
+                voxelManager.getAtlas().getSlotCount());
+    UploadScheduler& uploads = voxelManager.getUploadScheduler();
+    int uploadBudget = uploads.getFrameBudget() >> 20;
+    if (ImGui::SliderInt("Upload Budget (MB/frame)", &uploadBudget, 1, 64)) {
+        uploads.getFrameBudget() = uint32_t(uploadBudget) << 20;
+    }
+    ImGui::Text("Pending Uploads: %zu bricks, %zu LOD slices",
+                voxelManager.getAtlas().getPendingCount(),
+                voxelManager.getMipChain().getPendingCount());
     ImGui::End();
 }
 
@@ -260,6 +359,8 @@ void Nuum::RenderDockspace() {
                     runOnce = true;
                 }
             }
+            ImGui::MenuItem("Export Selection Only", nullptr,
+                            &serializer.GetExportSelectionOnly());
             if (ImGui::MenuItem("Save As NUPR", nullptr)) {
                 if (!runOnce) {
                     int res =
@@ -267,6 +368,43 @@ void Nuum::RenderDockspace() {
                     runOnce = true;
                 }
             }
+            if (ImGui::BeginMenu("Export Mesh")) {
+                auto& colorMode = serializer.GetMeshExporter().GetColorMode();
+                if (ImGui::MenuItem("Material per Color", nullptr,
+                                    colorMode ==
+                                        MeshExporter::ColorMode::Materials)) {
+                    colorMode = MeshExporter::ColorMode::Materials;
+                }
+                if (ImGui::MenuItem(
+                        "Vertex Colors", nullptr,
+                        colorMode == MeshExporter::ColorMode::VertexColors)) {
+                    colorMode = MeshExporter::ColorMode::VertexColors;
+                }
+                if (ImGui::MenuItem(
+                        "Palette Texture", nullptr,
+                        colorMode == MeshExporter::ColorMode::PaletteTexture)) {
+                    colorMode = MeshExporter::ColorMode::PaletteTexture;
+                }
+                ImGui::Separator();
+                const std::pair<const char*, MeshExporter::Format> formats[] = {
+                    {"OBJ", MeshExporter::Format::OBJ},
+                    {"PLY", MeshExporter::Format::PLY},
+                    {"glTF", MeshExporter::Format::GLTF}};
+                for (const auto& [name, format] : formats) {
+                    if (ImGui::MenuItem(name) && !runOnce) {
+                        serializer.ExportMesh(voxelManager, paletteManager,
+                                              format);
+                        runOnce = true;
+                    }
+                }
+                ImGui::EndMenu();
+            }
+            if (ImGui::MenuItem("Export Render", nullptr)) {
+                if (!runOnce) {
+                    serializer.ExportRender(pathTracer);
+                    runOnce = true;
+                }
+            }
             if (ImGui::MenuItem("Open", "Ctrl+O")) {
                 int res = serializer.Import(voxelManager, paletteManager);
                 if (res == 0)
@@ -280,6 +418,43 @@ void Nuum::RenderDockspace() {
                     SDL_SetWindowTitle(
                         window, ("Nuum - " + serializer.GetPath()).c_str());
             }
+            if (ImGui::MenuItem("Open NUPR")) {
+                int res =
+                    serializer.ImportFromNUPR(voxelManager, paletteManager);
+                if (res == 0)
+                    SDL_SetWindowTitle(
+                        window, ("Nuum - " + serializer.GetPath()).c_str());
+            }
+            if (ImGui::BeginMenu("Open Point Cloud")) {
+                ImGui::SliderInt(
+                    "Resolution",
+                    &serializer.GetPointCloudImporter().GetResolution(), 16,
+                    PointCloudImporter::maxResolution);
+                if (ImGui::MenuItem("Open PLY/XYZ")) {
+                    int res = serializer.ImportPointCloud(voxelManager,
+                                                          paletteManager);
+                    if (res == 0)
+                        SDL_SetWindowTitle(
+                            window,
+                            ("Nuum - " + serializer.GetPath()).c_str());
+                }
+                ImGui::EndMenu();
+            }
+            if (ImGui::BeginMenu("Open Images")) {
+                ImageImporter& images = serializer.GetImageImporter();
+                ImGui::SliderInt("Slice Threshold", &images.GetThreshold(),
+                                 0, 255);
+                if (ImGui::MenuItem("Open Slice Folder")) {
+                    serializer.ImportImageSlices(voxelManager, paletteManager);
+                }
+                ImGui::Separator();
+                ImGui::SliderInt("Height", &images.GetHeightScale(), 1,
+                                 ImageImporter::maxSize);
+                if (ImGui::MenuItem("Open Heightmap")) {
+                    serializer.ImportHeightmap(voxelManager, paletteManager);
+                }
+                ImGui::EndMenu();
+            }
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Edit")) {
@@ -298,6 +473,15 @@ void Nuum::RenderDockspace() {
             if (ImGui::MenuItem("ToolBox", "T", openToolBoxWindow)) {
                 openToolBoxWindow = !openToolBoxWindow;
             }
+            if (ImGui::MenuItem("Generator", "G", openGeneratorWindow)) {
+                openGeneratorWindow = !openGeneratorWindow;
+            }
+            if (ImGui::MenuItem("CSG", "B", openCsgWindow)) {
+                openCsgWindow = !openCsgWindow;
+            }
+            if (ImGui::MenuItem("Render", "R", openRenderWindow)) {
+                openRenderWindow = !openRenderWindow;
+            }
             ImGui::EndMenu();
         }
         ImGui::EndMenuBar();
@@ -336,6 +520,21 @@ void Nuum::HandleEvents() {
                 running = false;
                 continue;
             }
+            if (event.key.keysym.sym == SDLK_c &&
+                SDL_GetModState() & KMOD_CTRL) {
+                toolBox.Copy(voxelManager);
+                continue;
+            }
+            if (event.key.keysym.sym == SDLK_x &&
+                SDL_GetModState() & KMOD_CTRL) {
+                toolBox.Cut(voxelManager);
+                continue;
+            }
+            if (event.key.keysym.sym == SDLK_v &&
+                SDL_GetModState() & KMOD_CTRL) {
+                toolBox.BeginPaste(voxelManager);
+                continue;
+            }
             if (event.key.keysym.sym == SDLK_c) {
                 openCameraWindow = !openCameraWindow;
                 continue;
@@ -352,6 +551,18 @@ void Nuum::HandleEvents() {
                 openToolBoxWindow = !openToolBoxWindow;
                 continue;
             }
+            if (event.key.keysym.sym == SDLK_g) {
+                openGeneratorWindow = !openGeneratorWindow;
+                continue;
+            }
+            if (event.key.keysym.sym == SDLK_b) {
+                openCsgWindow = !openCsgWindow;
+                continue;
+            }
+            if (event.key.keysym.sym == SDLK_r) {
+                openRenderWindow = !openRenderWindow;
+                continue;
+            }
             if (event.key.keysym.sym == SDLK_s &&
                 SDL_GetModState() & KMOD_CTRL) {
                 if (!runOnce) {
@@ -399,6 +610,11 @@ void Nuum::HandleEvents() {
                 continue;
             }
         }
+        // A drag ends wherever the button is released
+        if (event.type == SDL_MOUSEBUTTONUP &&
+            event.button.button == SDL_BUTTON_LEFT) {
+            toolBox.EndDrag(voxelManager);
+        }
         // Skip if not hovering viewport
         if (!isHoveringViewport) {
             continue;
@@ -406,6 +622,15 @@ void Nuum::HandleEvents() {
         if (event.type == SDL_MOUSEMOTION) {
             camera.HandelMouseMotion(event.motion.state, event.motion.xrel,
                                      event.motion.yrel);
+
+            if (toolBox.hasPreview()) {
+                glm::vec2 viewport = glm::vec2(viewportSize.x, viewportSize.y);
+                auto hit = voxelManager.Raycast(
+                    viewportMousePos / viewport, camera.GetPosition(),
+                    camera.GetInvViewProj(), gridSize[3]);
+                toolBox.Preview(hit, voxelManager, paletteManager,
+                                SDL_GetModState() & KMOD_SHIFT);
+            }
         }
         if (event.type == SDL_MOUSEBUTTONDOWN) {
             if (event.button.button == SDL_BUTTON_LEFT && !runOnce) {
@@ -420,6 +645,11 @@ void Nuum::HandleEvents() {
                 if (hit.has_value()) {
                     toolBox.useTool(hit.value(), voxelManager, paletteManager,
                                     hasShiftModifier);
+                    // The ghost shows the next click on the edited volume
+                    if (toolBox.hasPreview()) {
+                        toolBox.Preview(hit, voxelManager, paletteManager,
+                                        hasShiftModifier);
+                    }
                 }
                 runOnce = true;
             }
@@ -474,6 +704,7 @@ int Nuum::Init(int argc, char** argv) {
     paletteManager.Init();
     voxelManager.Init(64, 64, 64, &paletteManager);
     toolBox.Init();
+    pathTracer.Init();
 
     SDL_Window* serializerWindow = nullptr;
 #if BX_PLATFORM_LINUX || BX_PLATFORM_BSD
@@ -505,18 +736,32 @@ void Nuum::Run() {
         RenderViewportWindow();
         camera.RenderDebugWindow(&openCameraWindow);
         RenderDebugWindow();
-        paletteManager.RenderWindow(&openPaletteWindow);
+        paletteManager.RenderWindow(&openPaletteWindow,
+                                    &voxelManager.getUsage());
         serializer.RenderWindow();
-        toolBox.RenderWindow(&openToolBoxWindow);
+        toolBox.RenderWindow(&openToolBoxWindow, voxelManager,
+                              paletteManager);
+        generator.RenderWindow(&openGeneratorWindow, voxelManager,
+                               paletteManager);
+        csg.RenderWindow(&openCsgWindow, voxelManager, paletteManager);
+        if (csg.TakeVolumeRequest()) {
+            serializer.ImportCsgVolume(csg);
+        }
+        pathTracer.RenderWindow(&openRenderWindow, paletteManager);
 
         ImGui::Render();
         ImGui_Implbgfx_RenderDrawLists(ImGui::GetDrawData());
 
         // Update
         camera.Update(viewportAspectRatio);
+        pathTracer.Update(camera, voxelManager, paletteManager,
+                          glm::vec2(viewportSize.x, viewportSize.y),
+                          gridSize[3]);
 
         // Render
         bgfx::touch(0);
+        voxelManager.setViewer(camera.GetPosition(), gridSize[3]);
+        voxelManager.Update();
         paletteManager.UpdateColorData();
         RenderViewport();
 
@@ -527,12 +772,22 @@ void Nuum::Run() {
 
 void Nuum::Shutdown() {
     serializer.Destroy();
+    pathTracer.Destroy();
     voxelManager.Destroy();
     paletteManager.Destroy();
     toolBox.Destroy();
     bgfx::destroy(u_camPos);
     bgfx::destroy(u_camMat);
     bgfx::destroy(u_gridSize);
+    bgfx::destroy(u_lodParams);
+    bgfx::destroy(u_lodSize);
+    bgfx::destroy(u_atlasParams);
+    bgfx::destroy(u_aoParams);
+    bgfx::destroy(u_sdfParams);
+    bgfx::destroy(u_overlayParams);
+    bgfx::destroy(u_overlaySize);
+    bgfx::destroy(u_overlayTextureSize);
+    bgfx::destroy(u_indexParams);
     bgfx::destroy(program);
     bgfx::destroy(vertexBuffer);
     bgfx::destroy(indexBuffer);
@@ -0,0 +1,80 @@
+#include "OverlayVolume.hpp"
+
+OverlayVolume::OverlayVolume() {}
+
+OverlayVolume::~OverlayVolume() {}
+
+void OverlayVolume::Init() {
+    s_overlayTexture =
+        bgfx::createUniform("s_overlayTexture", bgfx::UniformType::Sampler);
+}
+
+void OverlayVolume::Destroy() {
+    if (bgfx::isValid(s_overlayTexture)) {
+        bgfx::destroy(s_overlayTexture);
+        s_overlayTexture.idx = bgfx::kInvalidHandle;
+    }
+    if (bgfx::isValid(textureHandle)) {
+        bgfx::destroy(textureHandle);
+        textureHandle.idx = bgfx::kInvalidHandle;
+    }
+    capacity = glm::ivec3(0);
+    visible = false;
+}
+
+bool OverlayVolume::showsVoxels(const glm::ivec3& size) const {
+    return !outlineOnly &&
+           uint64_t(size.x) * uint64_t(size.y) * uint64_t(size.z) <=
+               maxVoxels;
+}
+
+void OverlayVolume::Set(const glm::ivec3& origin, const glm::ivec3& size,
+                        const std::vector<uint16_t>& values) {
+    if (glm::any(glm::lessThanEqual(size, glm::ivec3(0))) ||
+        values.size() != size_t(size.x) * size.y * size.z) {
+        visible = false;
+        return;
+    }
+    if (!showsVoxels(size)) {
+        SetOutline(origin, size);
+        return;
+    }
+    if (glm::any(glm::greaterThan(size, capacity))) {
+        // Grow only the axes that are too small, unless keeping the others
+        // would take the texture past the budget
+        const glm::ivec3 rounded =
+            (size + granularity - 1) / granularity * granularity;
+        glm::ivec3 grown = glm::max(capacity, rounded);
+        if (uint64_t(grown.x) * uint64_t(grown.y) * uint64_t(grown.z) >
+            maxVoxels) {
+            grown = rounded;
+        }
+        if (bgfx::isValid(textureHandle)) {
+            bgfx::destroy(textureHandle);
+        }
+        capacity = grown;
+        textureHandle = bgfx::createTexture3D(
+            capacity.x, capacity.y, capacity.z, false,
+            bgfx::TextureFormat::R16,
+            BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP, nullptr);
+    }
+    this->origin = origin;
+    this->size = size;
+    bgfx::updateTexture3D(textureHandle, 0, 0, 0, 0, size.x, size.y, size.z,
+                          bgfx::copy(values.data(),
+                                     values.size() * sizeof(uint16_t)));
+    visible = true;
+    outline = false;
+}
+
+void OverlayVolume::SetOutline(const glm::ivec3& origin,
+                               const glm::ivec3& size) {
+    if (glm::any(glm::lessThanEqual(size, glm::ivec3(0)))) {
+        visible = false;
+        return;
+    }
+    this->origin = origin;
+    this->size = size;
+    visible = true;
+    outline = true;
+}
@@ -25,3 +25,22 @@ Palette::Palette(std::string name, std::vector<glm::vec4> colors) {
 }
 
 Palette::~Palette() {}
+
+void Palette::MoveColor(uint16_t from, uint16_t to) {
+    if (from == 0 || to == 0 || from >= colors.size() ||
+        to >= colors.size() || from == to) {
+        return;
+    }
+    glm::vec4 color = colors[from];
+    colors.erase(colors.begin() + from);
+    colors.insert(colors.begin() + to, color);
+    if (selectedColorIndex == from) {
+        selectedColorIndex = to;
+    } else if (from < to && selectedColorIndex > from &&
+               selectedColorIndex <= to) {
+        selectedColorIndex--;
+    } else if (to < from && selectedColorIndex >= to &&
+               selectedColorIndex < from) {
+        selectedColorIndex++;
+    }
+}
@@ -1,6 +1,7 @@
 #include "PaletteManager.hpp"
 #include <bgfx/bgfx.h>
 #include <imgui.h>
+#include <algorithm>
 #include <imgui_stdlib.h>
 #include <vector>
 
@@ -25,7 +26,7 @@ void PaletteManager::Destroy() {
     palettes.clear();
 }
 
-void PaletteManager::RenderWindow(bool* open) {
+void PaletteManager::RenderWindow(bool* open, const PaletteUsage* usage) {
     if (open != nullptr && !*open) {
         return;
     }
@@ -73,16 +74,41 @@ void PaletteManager::RenderWindow(bool* open) {
             shouldUpdate = true;
         }
         ImGui::SameLine();
+        if (ImGui::ArrowButton("##up", ImGuiDir_Up) && i > 1) {
+            MoveColor(i, i - 1);
+        }
+        ImGui::SameLine();
+        if (ImGui::ArrowButton("##down", ImGuiDir_Down) &&
+            i + 1 < colors.size()) {
+            MoveColor(i, i + 1);
+        }
+        ImGui::SameLine();
         if (ImGui::Button("X")) {
-            palettes[currentPaletteIndex].RemoveColor(i);
-            shouldUpdate = true;
+            RemoveColor(i);
+        }
+        if (usage != nullptr && i < usage->size()) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("%llu", (unsigned long long)(*usage)[i]);
         }
         ImGui::PopID();
     }
-    if (ImGui::Button("+")) {
+    if (ImGui::Button("+") &&
+        colors.size() < VoxelIndex<uint16_t>::count) {
         palettes[currentPaletteIndex].AddColor({0.0f, 0.0f, 0.0f, 1.0f});
         shouldUpdate = true;
     }
+
+    ImGui::Separator();
+    const int lastIndex = int(colors.size()) - 1;
+    ImGui::SliderInt("From", &replaceFrom, 1, std::max(lastIndex, 1));
+    ImGui::SliderInt("To", &replaceTo, 0, std::max(lastIndex, 1));
+    if (ImGui::Button("Replace Color")) {
+        ReplaceColor(replaceFrom, replaceTo);
+    }
+    if (usage != nullptr && ImGui::Button("Remove Unused Colors")) {
+        RemoveUnusedColors(*usage);
+    }
+
     // selected color
     ImGui::Text("Selected Color: ");
     ImGui::SameLine();
@@ -164,6 +190,115 @@ void PaletteManager::RemovePalette(size_t index) {
     }
 }
 
+void PaletteManager::QueueRemap(const PaletteRemap& remap) {
+    if (!remapPending) {
+        pendingRemap = remap;
+        remapPending = true;
+        return;
+    }
+    for (uint16_t& index : pendingRemap) {
+        index = remap[index];
+    }
+}
+
+bool PaletteManager::TakeRemap(PaletteRemap& remap) {
+    if (!remapPending) {
+        return false;
+    }
+    remap = pendingRemap;
+    remapPending = false;
+    return true;
+}
+
+void PaletteManager::RemoveColor(uint16_t index) {
+    auto& colors = GetCurrentPalette().getColors();
+    if (index == 0 || index >= colors.size()) {
+        return;
+    }
+    // Voxels of the removed color take the closest remaining one, the
+    // indices above it shift down by one
+    int closest = 0;
+    float closestDistance = 0.0f;
+    for (int i = 1; i < int(colors.size()); ++i) {
+        if (i == index) {
+            continue;
+        }
+        glm::vec4 delta = colors[i] - colors[index];
+        float distance = glm::dot(delta, delta);
+        if (closest == 0 || distance < closestDistance) {
+            closest = i;
+            closestDistance = distance;
+        }
+    }
+    PaletteRemap remap = IdentityRemap();
+    for (size_t i = 0; i < remap.size(); ++i) {
+        int target = i == index ? closest : int(i);
+        remap[i] = static_cast<uint16_t>(target > index ? target - 1 : target);
+    }
+    GetCurrentPalette().RemoveColor(index);
+    QueueRemap(remap);
+    shouldUpdate = true;
+}
+
+void PaletteManager::MoveColor(uint16_t from, uint16_t to) {
+    auto& colors = GetCurrentPalette().getColors();
+    if (from == 0 || to == 0 || from >= colors.size() ||
+        to >= colors.size() || from == to) {
+        return;
+    }
+    // Same shift as the palette entries themselves
+    PaletteRemap remap = IdentityRemap();
+    for (int i = from < to ? from : to; i <= (from < to ? to : from); ++i) {
+        int target = i;
+        if (i == from) {
+            target = to;
+        } else if (from < to && i > from && i <= to) {
+            target = i - 1;
+        } else if (to < from && i >= to && i < from) {
+            target = i + 1;
+        }
+        remap[i] = static_cast<uint16_t>(target);
+    }
+    GetCurrentPalette().MoveColor(from, to);
+    QueueRemap(remap);
+    shouldUpdate = true;
+}
+
+void PaletteManager::ReplaceColor(uint16_t from, uint16_t to) {
+    const uint16_t colorCount = GetCurrentPalette().getColors().size();
+    if (from == 0 || from == to || from >= colorCount || to >= colorCount) {
+        return;
+    }
+    PaletteRemap remap = IdentityRemap();
+    remap[from] = to;
+    QueueRemap(remap);
+}
+
+void PaletteManager::RemoveUnusedColors(const PaletteUsage& usage) {
+    Palette& palette = GetCurrentPalette();
+    auto& colors = palette.getColors();
+    const int selected = palette.getSelectedIndex();
+    // Entries past the volume's index format can't be in use yet
+    const size_t limit = std::min(colors.size(), usage.size());
+    PaletteRemap remap = IdentityRemap();
+    std::vector<glm::vec4> kept = {colors[0]};
+    for (size_t i = 1; i < limit; ++i) {
+        if (usage[i] == 0 && int(i) != selected) {
+            continue;
+        }
+        remap[i] = static_cast<uint16_t>(kept.size());
+        kept.push_back(colors[i]);
+    }
+    if (kept.size() == limit) {
+        return;
+    }
+    kept.insert(kept.end(), colors.begin() + limit, colors.end());
+    colors = std::move(kept);
+    palette.setSelectedColorIndex(remap[selected]);
+    QueueRemap(remap);
+    shouldUpdate = true;
+}
+
 void PaletteManager::SetCurrentPalette(size_t index) {
     if (index < palettes.size() && index != currentPaletteIndex) {
         currentPaletteIndex = index;
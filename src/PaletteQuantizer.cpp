@@ -0,0 +1,234 @@
+#include "PaletteQuantizer.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace {
+constexpr size_t binCount = size_t(PaletteQuantizer::cubeSize) *
+                            PaletteQuantizer::cubeSize *
+                            PaletteQuantizer::cubeSize;
+} // namespace
+
+PaletteQuantizer::PaletteQuantizer() {}
+
+PaletteQuantizer::~PaletteQuantizer() {}
+
+void PaletteQuantizer::Clear() {
+    histogram.clear();
+    centers.clear();
+    cube.clear();
+}
+
+void PaletteQuantizer::Add(const glm::u8vec4* colors, size_t count) {
+    if (histogram.empty()) {
+        histogram.resize(binCount);
+    }
+    // Each part fills a private histogram, merged bin by bin afterwards
+    constexpr size_t partSize = 1 << 18;
+    const uint32_t parts = static_cast<uint32_t>(std::min<size_t>(
+        (count + partSize - 1) / partSize, Parallel::ThreadCount()));
+    if (parts == 0) {
+        return;
+    }
+    std::vector<std::vector<Bin>> local(parts, std::vector<Bin>(binCount));
+    Parallel::For(0, parts, [&](uint32_t p) {
+        std::vector<Bin>& bins = local[p];
+        const size_t end = count * (p + 1) / parts;
+        for (size_t i = count * p / parts; i < end; ++i) {
+            const glm::u8vec4& color = colors[i];
+            if (color.a < 128) {
+                continue;
+            }
+            Bin& bin = bins[Key(color)];
+            bin.count++;
+            bin.sum[0] += color.r;
+            bin.sum[1] += color.g;
+            bin.sum[2] += color.b;
+        }
+    });
+    Parallel::For(
+        0, binCount,
+        [&](uint32_t b) {
+            for (const std::vector<Bin>& bins : local) {
+                histogram[b].count += bins[b].count;
+                for (int c = 0; c < 3; ++c) {
+                    histogram[b].sum[c] += bins[b].sum[c];
+                }
+            }
+        },
+        1024);
+}
+
+int PaletteQuantizer::Build(int maxColors, int iterations) {
+    centers.clear();
+    cube.clear();
+    std::vector<uint32_t> used;
+    for (uint32_t b = 0; b < histogram.size(); ++b) {
+        if (histogram[b].count != 0) {
+            used.push_back(b);
+        }
+    }
+    if (used.empty()) {
+        return 0;
+    }
+    MedianCut(used, std::clamp(maxColors, 1, 255));
+    Refine(used, iterations);
+    BuildCube();
+    return int(centers.size());
+}
+
+Palette PaletteQuantizer::MakePalette(std::string name) const {
+    std::vector<glm::vec4> colors;
+    colors.reserve(centers.size());
+    for (const glm::vec3& center : centers) {
+        colors.emplace_back(center / 255.0f, 1.0f);
+    }
+    return Palette(std::move(name), std::move(colors));
+}
+
+void PaletteQuantizer::Map(const glm::u8vec4* colors, size_t count,
+                           uint8_t* indices) const {
+    constexpr size_t chunk = 1 << 16;
+    Parallel::For(0, static_cast<uint32_t>((count + chunk - 1) / chunk),
+                  [&](uint32_t c) {
+                      const size_t end = std::min(count, (c + 1) * chunk);
+                      for (size_t i = c * chunk; i < end; ++i) {
+                          indices[i] = Map(colors[i]);
+                      }
+                  });
+}
+
+glm::vec3 PaletteQuantizer::BinColor(uint32_t bin) const {
+    const Bin& b = histogram[bin];
+    return glm::vec3(b.sum[0], b.sum[1], b.sum[2]) / float(b.count);
+}
+
+int PaletteQuantizer::Nearest(const glm::vec3& color) const {
+    int nearest = 0;
+    float nearestDistance = std::numeric_limits<float>::max();
+    for (int i = 0; i < int(centers.size()); ++i) {
+        glm::vec3 delta = centers[i] - color;
+        float distance = glm::dot(delta, delta);
+        if (distance < nearestDistance) {
+            nearest = i;
+            nearestDistance = distance;
+        }
+    }
+    return nearest;
+}
+
+void PaletteQuantizer::MedianCut(std::vector<uint32_t>& used,
+                                 int maxColors) {
+    // A box is a range of used bins; the one with the most weight times
+    // extent along its longest axis is split next, at its weighted median
+    struct Box {
+        size_t begin;
+        size_t end;
+        int axis;
+        double score;
+    };
+    auto measure = [&](size_t begin, size_t end) {
+        Box box = {begin, end, 0, 0.0};
+        if (end - begin < 2) {
+            return box;
+        }
+        glm::vec3 min(255.0f);
+        glm::vec3 max(0.0f);
+        uint64_t weight = 0;
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 color = BinColor(used[i]);
+            min = glm::min(min, color);
+            max = glm::max(max, color);
+            weight += histogram[used[i]].count;
+        }
+        glm::vec3 extent = max - min;
+        box.axis = extent.x >= extent.y && extent.x >= extent.z ? 0
+                   : extent.y >= extent.z                      ? 1
+                                                               : 2;
+        box.score = double(weight) * extent[box.axis];
+        return box;
+    };
+
+    std::vector<Box> boxes = {measure(0, used.size())};
+    while (int(boxes.size()) < maxColors) {
+        auto best = std::max_element(
+            boxes.begin(), boxes.end(),
+            [](const Box& a, const Box& b) { return a.score < b.score; });
+        if (best->score <= 0.0) {
+            break;
+        }
+        const Box box = *best;
+        std::sort(used.begin() + box.begin, used.begin() + box.end,
+                  [&](uint32_t a, uint32_t b) {
+                      return BinColor(a)[box.axis] < BinColor(b)[box.axis];
+                  });
+        uint64_t total = 0;
+        for (size_t i = box.begin; i < box.end; ++i) {
+            total += histogram[used[i]].count;
+        }
+        size_t split = box.begin + 1;
+        uint64_t below = histogram[used[box.begin]].count;
+        while (split < box.end - 1 && below * 2 < total) {
+            below += histogram[used[split]].count;
+            ++split;
+        }
+        *best = measure(box.begin, split);
+        boxes.push_back(measure(split, box.end));
+    }
+
+    centers.clear();
+    for (const Box& box : boxes) {
+        glm::dvec3 sum(0.0);
+        uint64_t weight = 0;
+        for (size_t i = box.begin; i < box.end; ++i) {
+            const Bin& bin = histogram[used[i]];
+            sum += glm::dvec3(bin.sum[0], bin.sum[1], bin.sum[2]);
+            weight += bin.count;
+        }
+        centers.push_back(glm::vec3(sum / double(weight)));
+    }
+}
+
+void PaletteQuantizer::Refine(const std::vector<uint32_t>& used,
+                              int iterations) {
+    std::vector<uint8_t> nearest(used.size());
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        Parallel::For(
+            0, static_cast<uint32_t>(used.size()),
+            [&](uint32_t i) { nearest[i] = Nearest(BinColor(used[i])); },
+            256);
+        std::vector<glm::dvec3> sums(centers.size(), glm::dvec3(0.0));
+        std::vector<uint64_t> weights(centers.size(), 0);
+        for (size_t i = 0; i < used.size(); ++i) {
+            const Bin& bin = histogram[used[i]];
+            sums[nearest[i]] += glm::dvec3(bin.sum[0], bin.sum[1], bin.sum[2]);
+            weights[nearest[i]] += bin.count;
+        }
+        // A center that lost all its bins stays where it was
+        for (size_t c = 0; c < centers.size(); ++c) {
+            if (weights[c] != 0) {
+                centers[c] = glm::vec3(sums[c] / double(weights[c]));
+            }
+        }
+    }
+}
+
+void PaletteQuantizer::BuildCube() {
+    // Filled bins look up their mean color, empty ones their cell center
+    cube.resize(binCount);
+    const float cellSize = 256.0f / cubeSize;
+    Parallel::For(
+        0, binCount,
+        [&](uint32_t b) {
+            glm::vec3 color =
+                histogram.empty() || histogram[b].count == 0
+                    ? (glm::vec3(b >> (2 * cubeBits),
+                                 (b >> cubeBits) & (cubeSize - 1),
+                                 b & (cubeSize - 1)) +
+                       0.5f) *
+                          cellSize
+                    : BinColor(b);
+            cube[b] = static_cast<uint8_t>(Nearest(color) + 1);
+        },
+        256);
+}
@@ -0,0 +1,502 @@
+#include "PathTracer.hpp"
+#include "Parallel.hpp"
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/gtc/constants.hpp"
+#include "imgui.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+inline uint32_t PcgHash(uint32_t input) {
+    uint32_t state = input * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+inline float RandomFloat(uint32_t& state) {
+    state = PcgHash(state);
+    return static_cast<float>(state >> 8) * (1.0f / 16777216.0f);
+}
+
+inline glm::vec3 CosineSampleHemisphere(const glm::vec3& n, uint32_t& rng) {
+    float r1 = RandomFloat(rng);
+    float r2 = RandomFloat(rng);
+    float phi = glm::two_pi<float>() * r1;
+    float r = std::sqrt(r2);
+    glm::vec3 t = std::abs(n.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f)
+                                        : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 b = glm::normalize(glm::cross(n, t));
+    t = glm::cross(b, n);
+    return t * (r * std::cos(phi)) + b * (r * std::sin(phi)) +
+           n * std::sqrt(std::max(0.0f, 1.0f - r2));
+}
+
+// ACES filmic curve fit by Krzysztof Narkowicz
+inline float Tonemap(float x) {
+    x = (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+    return std::pow(std::clamp(x, 0.0f, 1.0f), 1.0f / 2.2f);
+}
+
+} // namespace
+
+PathTracer::PathTracer() {}
+
+PathTracer::~PathTracer() { Stop(); }
+
+void PathTracer::Init() {}
+
+void PathTracer::Destroy() {
+    Stop();
+    if (bgfx::isValid(texture)) {
+        bgfx::destroy(texture);
+        texture.idx = bgfx::kInvalidHandle;
+    }
+    voxels.clear();
+    accumulation.clear();
+    pixels.clear();
+}
+
+void PathTracer::Start() {
+    if (running) {
+        return;
+    }
+    active = settings;
+    float elevation = active.sunAngles.x;
+    float azimuth = active.sunAngles.y;
+    sunDir = glm::normalize(glm::vec3(std::cos(elevation) * std::sin(azimuth),
+                                      std::sin(elevation),
+                                      std::cos(elevation) * std::cos(azimuth)));
+    std::fill(accumulation.begin(), accumulation.end(), glm::vec3(0.0f));
+    sampleCount = 0;
+    renderTime = 0;
+    running = true;
+    worker = std::thread(&PathTracer::WorkerLoop, this);
+}
+
+void PathTracer::Stop() {
+    running = false;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void PathTracer::Update(const Camera& camera, VoxelManager& voxelManager,
+                        PaletteManager& paletteManager,
+                        const glm::vec2& viewportSize, float voxelScale) {
+    if (!enabled) {
+        Stop();
+        return;
+    }
+
+    uint32_t w = std::max(1u, static_cast<uint32_t>(viewportSize.x *
+                                                    resolutionScale));
+    uint32_t h = std::max(1u, static_cast<uint32_t>(viewportSize.y *
+                                                    resolutionScale));
+    bool filmChanged = w != imageWidth || h != imageHeight;
+    bool cameraChanged = camera.GetInvViewProj() != invViewProj ||
+                         camera.GetPosition() != camPos;
+    bool voxelsChanged = voxelManager.getRevision() != voxelRevision ||
+                         voxelScale != lastVoxelScale;
+    bool paletteChanged =
+        paletteManager.GetCurrentPalette().getColors() != paletteColors;
+
+    if (filmChanged || cameraChanged || voxelsChanged || paletteChanged ||
+        sceneDirty || !running) {
+        Stop();
+        if (filmChanged) {
+            std::lock_guard<std::mutex> lock(pixelMutex);
+            imageWidth = w;
+            imageHeight = h;
+            accumulation.assign(size_t(w) * h, glm::vec3(0.0f));
+            pixels.assign(size_t(w) * h, 0xff000000u);
+        }
+        if (voxelsChanged || paletteChanged || sceneDirty) {
+            Snapshot(voxelManager, paletteManager, voxelScale);
+        }
+        camPos = camera.GetPosition();
+        invViewProj = camera.GetInvViewProj();
+        sceneDirty = false;
+        Start();
+    }
+
+    if (frameReady.exchange(false)) {
+        std::lock_guard<std::mutex> lock(pixelMutex);
+        if (textureWidth != imageWidth || textureHeight != imageHeight ||
+            !bgfx::isValid(texture)) {
+            if (bgfx::isValid(texture)) {
+                bgfx::destroy(texture);
+            }
+            textureWidth = static_cast<uint16_t>(imageWidth);
+            textureHeight = static_cast<uint16_t>(imageHeight);
+            texture = bgfx::createTexture2D(textureWidth, textureHeight, false,
+                                            1, bgfx::TextureFormat::RGBA8, 0,
+                                            nullptr);
+        }
+        bgfx::updateTexture2D(
+            texture, 0, 0, 0, 0, textureWidth, textureHeight,
+            bgfx::copy(pixels.data(), pixels.size() * sizeof(uint32_t)));
+    }
+}
+
+void PathTracer::Snapshot(VoxelManager& voxelManager,
+                          PaletteManager& paletteManager, float voxelScale) {
+    const glm::vec4 size = voxelManager.getSize();
+    gridSize = glm::ivec3(size.x, size.y, size.z);
+    brickCount = (gridSize + brickSize - 1) / brickSize;
+    regionCount = (gridSize + regionSize - 1) / regionSize;
+
+    gridMin = glm::vec3(-1.0f, 0.0f, -1.0f) * glm::vec3(gridSize) * 0.0625f *
+              voxelScale;
+    voxelSize = 0.125f * voxelScale;
+
+    // Palette indices, one z-slice per task, clamped to the volume's index
+    // format so albedo covers every value
+    const std::vector<float>& source = voxelManager.getVoxel();
+    const size_t slice = size_t(gridSize.x) * gridSize.y;
+    voxels.resize(slice * gridSize.z);
+    const IndexFormat format = voxelManager.getIndexFormat();
+    Parallel::For(0, gridSize.z, [&](uint32_t z) {
+        DispatchIndex(format, [&](auto zero) {
+            using Index = decltype(zero);
+            for (size_t i = z * slice; i < (z + 1) * slice; ++i) {
+                voxels[i] = VoxelIndex<Index>::Encode(source[i]);
+            }
+        });
+    });
+
+    // Brick occupancy, one brick per task
+    brickMask.assign(size_t(brickCount.x) * brickCount.y * brickCount.z, 0);
+    Parallel::For(0, brickMask.size(), [&](uint32_t b) {
+        glm::ivec3 brick(b % brickCount.x, (b / brickCount.x) % brickCount.y,
+                         b / (brickCount.x * brickCount.y));
+        glm::ivec3 start = brick * brickSize;
+        glm::ivec3 end = glm::min(start + brickSize, gridSize);
+        for (int z = start.z; z < end.z; ++z) {
+            for (int y = start.y; y < end.y; ++y) {
+                const uint16_t* row = &voxels[z * slice + y * gridSize.x];
+                for (int x = start.x; x < end.x; ++x) {
+                    if (row[x] != 0) {
+                        brickMask[b] = 1;
+                        return;
+                    }
+                }
+            }
+        }
+    });
+
+    // Region occupancy from the bricks
+    constexpr int bricksPerRegion = regionSize / brickSize;
+    regionMask.assign(size_t(regionCount.x) * regionCount.y * regionCount.z,
+                      0);
+    for (int z = 0; z < brickCount.z; ++z) {
+        for (int y = 0; y < brickCount.y; ++y) {
+            for (int x = 0; x < brickCount.x; ++x) {
+                if (brickMask[(z * brickCount.y + y) * brickCount.x + x]) {
+                    glm::ivec3 r = glm::ivec3(x, y, z) / bricksPerRegion;
+                    regionMask[(r.z * regionCount.y + r.y) * regionCount.x +
+                               r.x] = 1;
+                }
+            }
+        }
+    }
+
+    // Palette colors are authored in sRGB, shading happens in linear space
+    paletteColors = paletteManager.GetCurrentPalette().getColors();
+    // Indices past the palette read as black
+    albedo.assign(IndexCount(format), glm::vec3(0.0f));
+    for (size_t i = 0; i < std::min(paletteColors.size(), albedo.size());
+         ++i) {
+        glm::vec3 c = glm::clamp(glm::vec3(paletteColors[i]), 0.0f, 1.0f);
+        albedo[i] = glm::vec3(std::pow(c.r, 2.2f), std::pow(c.g, 2.2f),
+                              std::pow(c.b, 2.2f));
+    }
+
+    voxelRevision = voxelManager.getRevision();
+    lastVoxelScale = voxelScale;
+}
+
+bool PathTracer::Intersect(const glm::vec3& origin, const glm::vec3& dir,
+                           float& tHit, glm::ivec3& hitNormal,
+                           uint16_t& hitIndex) const {
+    // Everything here is in grid space, one unit per voxel
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    glm::vec3 invDir;
+    for (int a = 0; a < 3; ++a) {
+        invDir[a] = std::abs(dir[a]) < 1e-8f ? inf : 1.0f / dir[a];
+    }
+
+    glm::vec3 t0 = (glm::vec3(0.0f) - origin) * invDir;
+    glm::vec3 t1 = (glm::vec3(gridSize) - origin) * invDir;
+    glm::vec3 tSmaller = glm::min(t0, t1);
+    glm::vec3 tBigger = glm::max(t0, t1);
+    for (int a = 0; a < 3; ++a) {
+        if (invDir[a] == inf) {
+            // Parallel to the slab, either always inside or never
+            bool inside = origin[a] >= 0.0f && origin[a] <= gridSize[a];
+            tSmaller[a] = inside ? -inf : inf;
+            tBigger[a] = inside ? inf : -inf;
+        }
+    }
+    float tMin = std::max({tSmaller.x, tSmaller.y, tSmaller.z, 0.0f});
+    float tMax = std::min({tBigger.x, tBigger.y, tBigger.z});
+    if (tMax <= tMin) {
+        return false;
+    }
+
+    int axis = -1;
+    if (tMin > 0.0f) {
+        axis = tSmaller.x >= tSmaller.y && tSmaller.x >= tSmaller.z ? 0
+               : tSmaller.y >= tSmaller.z                            ? 1
+                                                                     : 2;
+    }
+    glm::vec3 p = origin + dir * tMin;
+    glm::ivec3 voxel =
+        glm::clamp(glm::ivec3(glm::floor(p)), glm::ivec3(0), gridSize - 1);
+    if (axis >= 0) {
+        voxel[axis] = dir[axis] > 0.0f ? 0 : gridSize[axis] - 1;
+    }
+
+    float t = tMin;
+    const size_t slice = size_t(gridSize.x) * gridSize.y;
+    while (true) {
+        if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) ||
+            glm::any(glm::greaterThanEqual(voxel, gridSize))) {
+            return false;
+        }
+
+        // Descend the hierarchy: skip whole regions or bricks when empty
+        int cellSize = 1;
+        glm::ivec3 region = voxel / regionSize;
+        glm::ivec3 brick = voxel / brickSize;
+        if (!regionMask[(region.z * regionCount.y + region.y) * regionCount.x +
+                        region.x]) {
+            cellSize = regionSize;
+        } else if (!brickMask[(brick.z * brickCount.y + brick.y) *
+                                  brickCount.x +
+                              brick.x]) {
+            cellSize = brickSize;
+        } else {
+            uint16_t index =
+                voxels[voxel.z * slice + voxel.y * gridSize.x + voxel.x];
+            if (index != 0) {
+                tHit = t;
+                hitIndex = index;
+                hitNormal = glm::ivec3(0);
+                if (axis >= 0) {
+                    hitNormal[axis] = dir[axis] > 0.0f ? -1 : 1;
+                }
+                return true;
+            }
+        }
+
+        // Leave the current cell through its nearest face
+        glm::ivec3 cellMin = (voxel / cellSize) * cellSize;
+        glm::ivec3 cellMax = cellMin + cellSize;
+        glm::vec3 tExit;
+        for (int a = 0; a < 3; ++a) {
+            tExit[a] = invDir[a] == inf
+                           ? inf
+                           : ((dir[a] > 0.0f ? cellMax[a] : cellMin[a]) -
+                              origin[a]) *
+                                 invDir[a];
+        }
+        axis = tExit.x < tExit.y && tExit.x < tExit.z ? 0
+               : tExit.y < tExit.z                    ? 1
+                                                      : 2;
+        t = tExit[axis];
+        if (t > tMax + 1.0f) {
+            return false;
+        }
+
+        p = origin + dir * t;
+        for (int a = 0; a < 3; ++a) {
+            if (a != axis) {
+                voxel[a] = std::clamp(static_cast<int>(std::floor(p[a])),
+                                      cellMin[a], cellMax[a] - 1);
+            }
+        }
+        voxel[axis] = dir[axis] > 0.0f ? cellMax[axis] : cellMin[axis] - 1;
+    }
+}
+
+glm::vec3 PathTracer::Sky(const glm::vec3& dir) const {
+    const glm::vec3 horizon(0.62f, 0.70f, 0.80f);
+    const glm::vec3 zenith(0.22f, 0.40f, 0.75f);
+    const glm::vec3 ground(0.18f, 0.17f, 0.16f);
+    glm::vec3 color = dir.y >= 0.0f
+                          ? glm::mix(horizon, zenith, std::sqrt(dir.y))
+                          : glm::mix(horizon, ground,
+                                     std::min(1.0f, -dir.y * 4.0f));
+    return color * active.skyStrength;
+}
+
+glm::vec3 PathTracer::TracePath(glm::vec3 origin, glm::vec3 dir,
+                                uint32_t& rng) const {
+    glm::vec3 radiance(0.0f);
+    glm::vec3 throughput(1.0f);
+
+    for (int bounce = 0; bounce <= active.maxBounces; ++bounce) {
+        float t;
+        glm::ivec3 normal;
+        uint16_t index;
+        if (!Intersect(origin, dir, t, normal, index)) {
+            radiance += throughput * Sky(dir);
+            break;
+        }
+
+        const glm::vec3 n(normal);
+        const glm::vec3& color = albedo[index];
+        if (index < active.emission.size()) {
+            radiance += throughput * color * active.emission[index];
+        }
+
+        origin = origin + dir * t + n * 1e-3f;
+
+        // Next event estimation towards the sun
+        float cosSun = glm::dot(n, sunDir);
+        if (cosSun > 0.0f && active.sunStrength > 0.0f) {
+            float tShadow;
+            glm::ivec3 shadowNormal;
+            uint16_t shadowIndex;
+            if (!Intersect(origin, sunDir, tShadow, shadowNormal,
+                           shadowIndex)) {
+                radiance += throughput * color * active.sunStrength * cosSun;
+            }
+        }
+
+        throughput *= color;
+        if (bounce >= 2) {
+            // Russian roulette once the path has lost most of its energy
+            float survive = std::max({throughput.r, throughput.g, throughput.b});
+            if (RandomFloat(rng) >= survive) {
+                break;
+            }
+            throughput /= survive;
+        }
+        dir = CosineSampleHemisphere(n, rng);
+    }
+    return radiance;
+}
+
+void PathTracer::WorkerLoop() {
+    using Clock = std::chrono::steady_clock;
+    while (running) {
+        uint32_t sample = sampleCount;
+        if (sample >= static_cast<uint32_t>(active.maxSamples)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            continue;
+        }
+
+        auto start = Clock::now();
+        Parallel::For(0, imageHeight, [&](uint32_t y) {
+            if (!running) {
+                return;
+            }
+            for (uint32_t x = 0; x < imageWidth; ++x) {
+                uint32_t pixel = y * imageWidth + x;
+                uint32_t rng = PcgHash(pixel ^ PcgHash(sample + 1));
+
+                // Jittered camera ray, same convention as fs_ray.sc
+                glm::vec2 uv((x + RandomFloat(rng)) / imageWidth,
+                             (y + RandomFloat(rng)) / imageHeight);
+                glm::vec2 ndc = uv * 2.0f - glm::vec2(1.0f, 1.0f);
+                ndc.y = -ndc.y;
+                glm::vec4 nearPlane = invViewProj * glm::vec4(ndc, -1.0f, 1.0f);
+                glm::vec4 farPlane = invViewProj * glm::vec4(ndc, 1.0f, 1.0f);
+                nearPlane /= nearPlane.w;
+                farPlane /= farPlane.w;
+                glm::vec3 dir =
+                    glm::normalize(glm::vec3(farPlane) - glm::vec3(nearPlane));
+
+                glm::vec3 origin = (camPos - gridMin) / voxelSize;
+                accumulation[pixel] += TracePath(origin, dir, rng);
+            }
+        });
+        if (!running) {
+            break;
+        }
+        sampleCount = sample + 1;
+        Resolve();
+        renderTime += std::chrono::duration_cast<std::chrono::milliseconds>(
+                          Clock::now() - start)
+                          .count();
+    }
+}
+
+void PathTracer::Resolve() {
+    const float scale = active.exposure / std::max(1u, sampleCount.load());
+    std::lock_guard<std::mutex> lock(pixelMutex);
+    Parallel::For(0, imageHeight, [&](uint32_t y) {
+        for (uint32_t x = 0; x < imageWidth; ++x) {
+            uint32_t pixel = y * imageWidth + x;
+            glm::vec3 c = accumulation[pixel] * scale;
+            uint32_t r = static_cast<uint32_t>(Tonemap(c.r) * 255.0f + 0.5f);
+            uint32_t g = static_cast<uint32_t>(Tonemap(c.g) * 255.0f + 0.5f);
+            uint32_t b = static_cast<uint32_t>(Tonemap(c.b) * 255.0f + 0.5f);
+            pixels[pixel] = r | (g << 8) | (b << 16) | 0xff000000u;
+        }
+    });
+    frameReady = true;
+}
+
+void PathTracer::GetImage(std::vector<uint8_t>& rgba, uint32_t& w,
+                          uint32_t& h) {
+    std::lock_guard<std::mutex> lock(pixelMutex);
+    w = imageWidth;
+    h = imageHeight;
+    rgba.resize(pixels.size() * sizeof(uint32_t));
+    std::memcpy(rgba.data(), pixels.data(), rgba.size());
+}
+
+void PathTracer::RenderWindow(bool* open, PaletteManager& paletteManager) {
+    if (open != nullptr && !*open) {
+        return;
+    }
+    ImGui::Begin("Render", open);
+
+    ImGui::Checkbox("Path Tracing", &enabled);
+    ImGui::SameLine();
+    ImGui::Checkbox("Show in Viewport", &showInViewport);
+
+    bool changed = false;
+    changed |= ImGui::SliderInt("Bounces", &settings.maxBounces, 1, 8);
+    changed |= ImGui::SliderInt("Max Samples", &settings.maxSamples, 1, 8192);
+    changed |= ImGui::SliderFloat("Resolution", &resolutionScale, 0.1f, 1.0f);
+    changed |= ImGui::SliderFloat("Exposure", &settings.exposure, 0.1f, 8.0f);
+    changed |= ImGui::SliderFloat("Sky", &settings.skyStrength, 0.0f, 4.0f);
+    changed |= ImGui::SliderFloat("Sun", &settings.sunStrength, 0.0f, 10.0f);
+    changed |= ImGui::SliderFloat("Sun Elevation", &settings.sunAngles.x, 0.0f,
+                                  glm::half_pi<float>());
+    changed |= ImGui::SliderFloat("Sun Azimuth", &settings.sunAngles.y,
+                                  -glm::pi<float>(), glm::pi<float>());
+
+    // Emission is edited for the currently selected palette color
+    uint16_t selected = paletteManager.GetCurrentPalette().getSelectedIndex();
+    if (selected < settings.emission.size()) {
+        changed |= ImGui::SliderFloat("Emission (selected color)",
+                                      &settings.emission[selected], 0.0f,
+                                      20.0f);
+    }
+    if (changed) {
+        sceneDirty = true;
+    }
+
+    ImGui::Separator();
+    uint32_t samples = sampleCount;
+    ImGui::Text("Resolution: %ux%u", imageWidth, imageHeight);
+    ImGui::Text("Samples: %u / %d", samples, active.maxSamples);
+    ImGui::Text("Time: %.1f s", renderTime / 1000.0f);
+
+    if (bgfx::isValid(texture) && enabled) {
+        ImVec2 avail = ImGui::GetContentRegionAvail();
+        float aspect = float(textureHeight) / float(textureWidth);
+        ImGui::Image(texture.idx, ImVec2(avail.x, avail.x * aspect));
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,533 @@
+#include "PointCloudImporter.hpp"
+#include "PaletteQuantizer.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <sstream>
+
+namespace {
+
+// Bytes per streamed read, the parsed points of one block stay resident
+constexpr size_t blockBytes = 32 << 20;
+// Cells copied out per task when the merged grid is flattened
+constexpr size_t flattenChunk = 1 << 16;
+
+uint32_t TypeSize(int type) {
+    static constexpr uint32_t sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+    return sizes[type];
+}
+
+template <typename T> inline double ReadValue(const char* data, bool swap) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, data, sizeof(T));
+    if (swap) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return double(value);
+}
+
+inline bool IsSeparator(char c) {
+    return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+}
+
+} // namespace
+
+PointCloudImporter::PointCloudImporter() {}
+
+PointCloudImporter::~PointCloudImporter() {}
+
+int PointCloudImporter::ReadHeader(std::ifstream& file,
+                                   const std::string& path,
+                                   std::string& error) {
+    layout = Layout();
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (extension != ".ply") {
+        // XYZ: one "x y z [r g b]" line per point, nothing else to read
+        layout.hasColor = true;
+        layout.dataStart = file.tellg();
+        return 0;
+    }
+    layout.ply = true;
+
+    std::string line;
+    std::getline(file, line);
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    if (line != "ply") {
+        error = "Invalid PLY header";
+        return 1;
+    }
+
+    static const std::pair<const char*, Type> typeNames[] = {
+        {"char", Type::Int8},     {"int8", Type::Int8},
+        {"uchar", Type::UInt8},   {"uint8", Type::UInt8},
+        {"short", Type::Int16},   {"int16", Type::Int16},
+        {"ushort", Type::UInt16}, {"uint16", Type::UInt16},
+        {"int", Type::Int32},     {"int32", Type::Int32},
+        {"uint", Type::UInt32},   {"uint32", Type::UInt32},
+        {"float", Type::Float},   {"float32", Type::Float},
+        {"double", Type::Double}, {"float64", Type::Double}};
+    static const std::pair<const char*, Field> fieldNames[] = {
+        {"x", X},
+        {"y", Y},
+        {"z", Z},
+        {"red", Red},
+        {"r", Red},
+        {"diffuse_red", Red},
+        {"green", Green},
+        {"g", Green},
+        {"diffuse_green", Green},
+        {"blue", Blue},
+        {"b", Blue},
+        {"diffuse_blue", Blue}};
+
+    bool ended = false;
+    bool inVertex = false;
+    int elements = 0;
+    bool found[FieldCount] = {};
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            tokens >> format;
+            if (format == "ascii") {
+                layout.encoding = Encoding::Ascii;
+            } else if (format == "binary_little_endian") {
+                layout.encoding = Encoding::BinaryLittleEndian;
+            } else if (format == "binary_big_endian") {
+                layout.encoding = Encoding::BinaryBigEndian;
+            } else {
+                error = "Unknown PLY format: " + format;
+                return 1;
+            }
+        } else if (keyword == "element") {
+            std::string name;
+            uint64_t count = 0;
+            tokens >> name >> count;
+            inVertex = name == "vertex";
+            // Records are streamed from the start of the data, so anything
+            // stored before the vertices could not be skipped
+            if (inVertex && elements != 0) {
+                error = "PLY vertices must be the first element";
+                return 1;
+            }
+            if (inVertex) {
+                layout.count = count;
+            }
+            ++elements;
+        } else if (keyword == "property" && inVertex) {
+            std::string typeName, name;
+            tokens >> typeName >> name;
+            if (typeName == "list") {
+                error = "List properties on vertices are not supported";
+                return 1;
+            }
+            auto type = std::find_if(
+                std::begin(typeNames), std::end(typeNames),
+                [&](const auto& entry) { return typeName == entry.first; });
+            if (type == std::end(typeNames)) {
+                error = "Unknown PLY property type: " + typeName;
+                return 1;
+            }
+            Property property = {type->second, -1, layout.stride};
+            for (const auto& [fieldName, field] : fieldNames) {
+                if (name == fieldName && !found[field]) {
+                    property.field = field;
+                    found[field] = true;
+                }
+            }
+            layout.properties.push_back(property);
+            layout.stride += TypeSize(int(type->second));
+        } else if (keyword == "end_header") {
+            ended = true;
+            break;
+        }
+    }
+    if (!ended) {
+        error = "PLY header is missing end_header";
+        return 1;
+    }
+    if (!found[X] || !found[Y] || !found[Z]) {
+        error = "PLY vertices have no x, y and z properties";
+        return 1;
+    }
+    layout.hasColor = found[Red] && found[Green] && found[Blue];
+    layout.dataStart = file.tellg();
+    return 0;
+}
+
+void PointCloudImporter::Rewind(std::ifstream& file) {
+    file.clear();
+    file.seekg(layout.dataStart);
+    carried = 0;
+    remaining =
+        layout.ply ? layout.count : std::numeric_limits<uint64_t>::max();
+}
+
+bool PointCloudImporter::ReadBlock(std::ifstream& file) {
+    for (std::vector<Point>& part : parts) {
+        part.clear();
+    }
+    if (remaining == 0) {
+        return false;
+    }
+    const uint32_t partCount = static_cast<uint32_t>(parts.size());
+
+    if (layout.encoding != Encoding::Ascii) {
+        const size_t records = std::min<uint64_t>(
+            remaining, std::max<size_t>(blockBytes / layout.stride, 1));
+        block.resize(records * layout.stride);
+        file.read(block.data(), block.size());
+        if (size_t(file.gcount()) != block.size()) {
+            return false;
+        }
+        remaining -= records;
+        Parallel::For(0, partCount, [&](uint32_t p) {
+            const size_t begin = records * p / partCount;
+            const size_t end = records * (p + 1) / partCount;
+            DecodeBinary(block.data() + begin * layout.stride, end - begin,
+                         parts[p]);
+        });
+        return true;
+    }
+
+    // Text is cut after the last full line, the rest moves to the front of
+    // the next block. Parts start on line boundaries.
+    block.resize(carried + blockBytes);
+    file.read(block.data() + carried, blockBytes);
+    const size_t size = carried + size_t(file.gcount());
+    if (size == 0) {
+        return false;
+    }
+    size_t end = size;
+    if (!file.eof()) {
+        while (end > 0 && block[end - 1] != '\n') {
+            --end;
+        }
+        if (end == 0) {
+            end = size;
+        }
+    }
+    std::vector<size_t> cuts(partCount + 1, end);
+    cuts[0] = 0;
+    for (uint32_t p = 1; p < partCount; ++p) {
+        size_t cut = std::max(end * p / partCount, cuts[p - 1]);
+        const char* newline = static_cast<const char*>(
+            std::memchr(block.data() + cut, '\n', end - cut));
+        cuts[p] = newline ? size_t(newline - block.data()) + 1 : end;
+    }
+    Parallel::For(0, partCount, [&](uint32_t p) {
+        ParseText(block.data() + cuts[p], block.data() + cuts[p + 1],
+                  parts[p]);
+    });
+
+    // PLY text may carry faces after the vertices, those lines are dropped
+    for (std::vector<Point>& part : parts) {
+        if (part.size() > remaining) {
+            part.resize(size_t(remaining));
+        }
+        remaining -= part.size();
+    }
+    carried = size - end;
+    std::memmove(block.data(), block.data() + end, carried);
+    if (file.eof() && carried == 0 && !layout.ply) {
+        remaining = 0;
+    }
+    return true;
+}
+
+void PointCloudImporter::ParseText(const char* begin, const char* end,
+                                   std::vector<Point>& points) const {
+    const size_t valueCount = layout.ply ? layout.properties.size() : 6;
+    std::vector<double> values(valueCount);
+    const char* cursor = begin;
+    while (cursor < end) {
+        const char* lineEnd = static_cast<const char*>(
+            std::memchr(cursor, '\n', size_t(end - cursor)));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        size_t count = 0;
+        const char* c = cursor;
+        while (count < valueCount) {
+            while (c < lineEnd && IsSeparator(*c)) {
+                ++c;
+            }
+            if (c < lineEnd && *c == '+') {
+                ++c;
+            }
+            auto [next, ec] = std::from_chars(c, lineEnd, values[count]);
+            if (ec != std::errc()) {
+                break;
+            }
+            c = next;
+            ++count;
+        }
+        cursor = lineEnd + 1;
+        // Blank lines, comments and anything without a position are skipped
+        if (count < (layout.ply ? valueCount : 3)) {
+            continue;
+        }
+
+        Point point = {glm::dvec3(0.0), glm::vec3(255.0f)};
+        if (!layout.ply) {
+            point.position = glm::dvec3(values[0], values[1], values[2]);
+            if (count >= 6) {
+                point.color = glm::vec3(values[3], values[4], values[5]);
+            }
+        } else {
+            for (size_t i = 0; i < valueCount; ++i) {
+                const Property& property = layout.properties[i];
+                if (property.field < 0) {
+                    continue;
+                }
+                if (property.field <= Z) {
+                    point.position[property.field] = values[i];
+                } else if (layout.hasColor) {
+                    point.color[property.field - Red] =
+                        float(ColorValue(property.type, values[i]));
+                }
+            }
+        }
+        points.push_back(point);
+    }
+}
+
+void PointCloudImporter::DecodeBinary(const char* data, size_t count,
+                                      std::vector<Point>& points) const {
+    const bool swap = (layout.encoding == Encoding::BinaryBigEndian) !=
+                      (std::endian::native == std::endian::big);
+    points.resize(count, {glm::dvec3(0.0), glm::vec3(255.0f)});
+    for (size_t i = 0; i < count; ++i, data += layout.stride) {
+        Point& point = points[i];
+        for (const Property& property : layout.properties) {
+            if (property.field < 0) {
+                continue;
+            }
+            const char* source = data + property.offset;
+            double value = 0.0;
+            switch (property.type) {
+            case Type::Int8:
+                value = ReadValue<int8_t>(source, swap);
+                break;
+            case Type::UInt8:
+                value = ReadValue<uint8_t>(source, swap);
+                break;
+            case Type::Int16:
+                value = ReadValue<int16_t>(source, swap);
+                break;
+            case Type::UInt16:
+                value = ReadValue<uint16_t>(source, swap);
+                break;
+            case Type::Int32:
+                value = ReadValue<int32_t>(source, swap);
+                break;
+            case Type::UInt32:
+                value = ReadValue<uint32_t>(source, swap);
+                break;
+            case Type::Float:
+                value = ReadValue<float>(source, swap);
+                break;
+            case Type::Double:
+                value = ReadValue<double>(source, swap);
+                break;
+            }
+            if (property.field <= Z) {
+                point.position[property.field] = value;
+            } else if (layout.hasColor) {
+                point.color[property.field - Red] =
+                    float(ColorValue(property.type, value));
+            }
+        }
+    }
+}
+
+double PointCloudImporter::ColorValue(Type type, double value) {
+    switch (type) {
+    case Type::Int16:
+    case Type::UInt16:
+        return value / 257.0;
+    case Type::Float:
+    case Type::Double:
+        return value * 255.0;
+    default:
+        return value;
+    }
+}
+
+int PointCloudImporter::Import(const std::string& path,
+                               VoxelManager& voxelManager,
+                               PaletteManager& paletteManager,
+                               std::string& log, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        error = "Failed to open file: " + path;
+        return 1;
+    }
+    if (ReadHeader(file, path, error) != 0) {
+        return 1;
+    }
+    const uint32_t partCount = Parallel::ThreadCount();
+    parts.assign(partCount, {});
+
+    // First pass: bounds, and whether XYZ colors are written as 0..1
+    std::vector<glm::dvec3> partMin(
+        partCount, glm::dvec3(std::numeric_limits<double>::max()));
+    std::vector<glm::dvec3> partMax(
+        partCount, glm::dvec3(std::numeric_limits<double>::lowest()));
+    std::vector<float> partColor(partCount, 0.0f);
+    uint64_t pointCount = 0;
+    Rewind(file);
+    while (ReadBlock(file)) {
+        Parallel::For(0, partCount, [&](uint32_t p) {
+            for (const Point& point : parts[p]) {
+                partMin[p] = glm::min(partMin[p], point.position);
+                partMax[p] = glm::max(partMax[p], point.position);
+                partColor[p] = std::max(
+                    partColor[p],
+                    std::max(point.color.r,
+                             std::max(point.color.g, point.color.b)));
+            }
+        });
+        for (const std::vector<Point>& part : parts) {
+            pointCount += part.size();
+        }
+    }
+    if (layout.ply && remaining != 0) {
+        error = "Unexpected end of file";
+        return 1;
+    }
+    if (pointCount == 0) {
+        error = "No points found in " + path;
+        return 1;
+    }
+    glm::dvec3 min = partMin[0];
+    glm::dvec3 max = partMax[0];
+    float maxColor = 0.0f;
+    for (uint32_t p = 0; p < partCount; ++p) {
+        min = glm::min(min, partMin[p]);
+        max = glm::max(max, partMax[p]);
+        maxColor = std::max(maxColor, partColor[p]);
+    }
+    const float colorScale = !layout.ply && maxColor <= 1.0f ? 255.0f : 1.0f;
+
+    // The longest axis gets `resolution` voxels, the others keep the aspect
+    const int cells = std::clamp(resolution, 1, maxResolution);
+    const glm::dvec3 extent = max - min;
+    double longest = std::max(extent.x, std::max(extent.y, extent.z));
+    if (longest <= 0.0) {
+        longest = 1.0;
+    }
+    const double scale = cells / longest;
+    const glm::ivec3 size =
+        glm::clamp(glm::ivec3(glm::ceil(extent * scale)), glm::ivec3(1),
+                   glm::ivec3(cells));
+    log += "Points: " + std::to_string(pointCount) + "\n";
+    log += "Voxel grid size: " + std::to_string(size.x) + "x" +
+           std::to_string(size.y) + "x" + std::to_string(size.z) + "\n";
+
+    // Second pass: every part sums colors into its own partial grid
+    std::vector<Grid> partials(partCount, Grid(shardCount));
+    Rewind(file);
+    while (ReadBlock(file)) {
+        Parallel::For(0, partCount, [&](uint32_t p) {
+            Grid& grid = partials[p];
+            for (const Point& point : parts[p]) {
+                const glm::ivec3 voxel = glm::clamp(
+                    glm::ivec3(glm::floor((point.position - min) * scale)),
+                    glm::ivec3(0), size - 1);
+                const uint64_t key =
+                    (uint64_t(voxel.z) * size.y + voxel.y) * size.x + voxel.x;
+                Cell& cell = grid[Shard(key)][key];
+                for (int c = 0; c < 3; ++c) {
+                    cell.sum[c] += uint64_t(std::clamp(
+                        point.color[c] * colorScale + 0.5f, 0.0f, 255.0f));
+                }
+                ++cell.count;
+            }
+        });
+    }
+    if (layout.ply && remaining != 0) {
+        error = "Unexpected end of file";
+        return 1;
+    }
+    file.close();
+    parts.clear();
+    block = std::vector<char>();
+
+    // Shards hold disjoint keys, so each one is merged by a single thread
+    Grid& merged = partials[0];
+    Parallel::For(0, shardCount, [&](uint32_t s) {
+        for (uint32_t p = 1; p < partCount; ++p) {
+            for (const auto& [key, cell] : partials[p][s]) {
+                Cell& target = merged[s][key];
+                for (int c = 0; c < 3; ++c) {
+                    target.sum[c] += cell.sum[c];
+                }
+                target.count += cell.count;
+            }
+            partials[p][s] = {};
+        }
+    });
+
+    std::vector<size_t> offsets(shardCount + 1, 0);
+    for (uint32_t s = 0; s < shardCount; ++s) {
+        offsets[s + 1] = offsets[s] + merged[s].size();
+    }
+    const size_t voxelCount = offsets[shardCount];
+    std::vector<uint64_t> keys(voxelCount);
+    std::vector<glm::u8vec4> colors(voxelCount);
+    Parallel::For(0, shardCount, [&](uint32_t s) {
+        size_t i = offsets[s];
+        for (const auto& [key, cell] : merged[s]) {
+            keys[i] = key;
+            colors[i] = glm::u8vec4(
+                (cell.sum[0] + cell.count / 2) / cell.count,
+                (cell.sum[1] + cell.count / 2) / cell.count,
+                (cell.sum[2] + cell.count / 2) / cell.count, 255);
+            ++i;
+        }
+        merged[s] = {};
+    });
+    partials.clear();
+
+    PaletteQuantizer quantizer;
+    quantizer.Add(colors.data(), voxelCount);
+    const int colorCount = quantizer.Build();
+    std::vector<uint8_t> voxelIndices(voxelCount);
+    quantizer.Map(colors.data(), voxelCount, voxelIndices.data());
+
+    std::vector<uint8_t> indices(size_t(size.x) * size.y * size.z, 0);
+    const size_t chunks = (voxelCount + flattenChunk - 1) / flattenChunk;
+    Parallel::For(0, static_cast<uint32_t>(chunks), [&](uint32_t c) {
+        const size_t end = std::min(voxelCount, (c + 1) * flattenChunk);
+        for (size_t i = c * flattenChunk; i < end; ++i) {
+            indices[keys[i]] = voxelIndices[i];
+        }
+    });
+    log += "Filled " + std::to_string(voxelCount) + " voxels with " +
+           std::to_string(colorCount) + " colors.\n";
+
+    const std::string name = std::filesystem::path(path).stem().string();
+    paletteManager.SetCurrentPalette(
+        paletteManager.AddPalette(quantizer.MakePalette(name)));
+    voxelManager.setSize(size.x, size.y, size.z);
+    voxelManager.newVoxelData(indices, size.x, size.y, size.z);
+    return 0;
+}
@@ -0,0 +1,280 @@
+#include "SelectionMask.hpp"
+#include "glm/common.hpp"
+#include <bit>
+#include <cmath>
+
+SelectionMask::SelectionMask() {}
+
+SelectionMask::~SelectionMask() {}
+
+void SelectionMask::Resize(const glm::ivec3& size) {
+    this->size = glm::max(size, glm::ivec3(0));
+    wordsPerRow = (this->size.x + 63) / 64;
+    const int tailBits = this->size.x & 63;
+    tailMask = tailBits == 0 ? ~0ull : (1ull << tailBits) - 1;
+    words.assign(wordsPerRow * this->size.y * this->size.z, 0);
+    count = 0;
+}
+
+void SelectionMask::Clear() {
+    std::fill(words.begin(), words.end(), 0);
+    count = 0;
+}
+
+void SelectionMask::SelectAll() {
+    if (words.empty()) {
+        return;
+    }
+    Apply(Op::Replace, [&](int, int, uint64_t* row) {
+        std::fill_n(row, wordsPerRow, ~0ull);
+        row[wordsPerRow - 1] = tailMask;
+    });
+}
+
+void SelectionMask::Invert() {
+    if (words.empty()) {
+        return;
+    }
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        for (int y = 0; y < size.y; ++y) {
+            uint64_t* row = &words[rowOffset(y, z)];
+            for (size_t w = 0; w < wordsPerRow; ++w) {
+                row[w] = ~row[w];
+            }
+            row[wordsPerRow - 1] &= tailMask;
+        }
+    });
+    Recount();
+}
+
+void SelectionMask::Combine(const SelectionMask& other, Op op) {
+    if (other.size != size) {
+        return;
+    }
+    const size_t sliceWords = wordsPerRow * size.y;
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        Merge(&words[z * sliceWords], &other.words[z * sliceWords], sliceWords,
+              op);
+    });
+    Recount();
+}
+
+void SelectionMask::Merge(uint64_t* dst, const uint64_t* src, size_t count,
+                          Op op) {
+    // One plain loop per op, so the compiler vectorizes each of them
+    switch (op) {
+    case Op::Replace:
+        std::copy_n(src, count, dst);
+        break;
+    case Op::Add:
+        for (size_t i = 0; i < count; ++i) {
+            dst[i] |= src[i];
+        }
+        break;
+    case Op::Subtract:
+        for (size_t i = 0; i < count; ++i) {
+            dst[i] &= ~src[i];
+        }
+        break;
+    case Op::Intersect:
+        for (size_t i = 0; i < count; ++i) {
+            dst[i] &= src[i];
+        }
+        break;
+    }
+}
+
+void SelectionMask::Grow(int steps) {
+    for (int i = 0; i < steps; ++i) {
+        Morph(true);
+    }
+}
+
+void SelectionMask::Shrink(int steps) {
+    for (int i = 0; i < steps; ++i) {
+        Morph(false);
+    }
+}
+
+void SelectionMask::Morph(bool grow) {
+    if (words.empty()) {
+        return;
+    }
+    // Growing ORs the six neighbors in, shrinking ANDs them; outside the
+    // grid counts as unselected for the first and selected for the second
+    const uint64_t outside = grow ? 0 : ~0ull;
+    const std::vector<uint64_t> source = words;
+    const std::vector<uint64_t> outsideRow(wordsPerRow, outside);
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        for (int y = 0; y < size.y; ++y) {
+            const uint64_t* row = &source[rowOffset(y, z)];
+            auto neighbor = [&](int ny, int nz) {
+                if (ny < 0 || ny >= size.y || nz < 0 || nz >= size.z) {
+                    return outsideRow.data();
+                }
+                return &source[rowOffset(ny, nz)];
+            };
+            const uint64_t* down = neighbor(y - 1, z);
+            const uint64_t* up = neighbor(y + 1, z);
+            const uint64_t* back = neighbor(y, int(z) - 1);
+            const uint64_t* front = neighbor(y, int(z) + 1);
+            uint64_t* dst = &words[rowOffset(y, z)];
+            for (size_t w = 0; w < wordsPerRow; ++w) {
+                uint64_t current = row[w];
+                if (!grow && w + 1 == wordsPerRow) {
+                    current |= ~tailMask; // padding is outside the grid
+                }
+                const uint64_t previous = w > 0 ? row[w - 1] : outside;
+                const uint64_t next = w + 1 < wordsPerRow ? row[w + 1] : outside;
+                const uint64_t left = (current << 1) | (previous >> 63);
+                const uint64_t right = (current >> 1) | (next << 63);
+                dst[w] = grow ? current | left | right | down[w] | up[w] |
+                                    back[w] | front[w]
+                              : current & left & right & down[w] & up[w] &
+                                    back[w] & front[w];
+            }
+            dst[wordsPerRow - 1] &= tailMask;
+        }
+    });
+    Recount();
+}
+
+void SelectionMask::SetRange(uint64_t* row, int begin, int end) {
+    if (begin >= end) {
+        return;
+    }
+    const int first = begin >> 6;
+    const int last = (end - 1) >> 6;
+    for (int w = first; w <= last; ++w) {
+        const int lo = w == first ? begin & 63 : 0;
+        const int hi = w == last ? ((end - 1) & 63) + 1 : 64;
+        const uint64_t upper = hi == 64 ? ~0ull : (1ull << hi) - 1;
+        row[w] |= upper & ~((1ull << lo) - 1);
+    }
+}
+
+void SelectionMask::SelectBox(const glm::ivec3& min, const glm::ivec3& max,
+                              Op op) {
+    const glm::ivec3 boxMin = glm::clamp(min, glm::ivec3(0), size);
+    const glm::ivec3 boxMax = glm::clamp(max, boxMin, size);
+    Apply(op, [&](int y, int z, uint64_t* row) {
+        if (y >= boxMin.y && y < boxMax.y && z >= boxMin.z && z < boxMax.z) {
+            SetRange(row, boxMin.x, boxMax.x);
+        }
+    });
+}
+
+void SelectionMask::SelectSphere(const glm::vec3& center, float radius,
+                                 Op op) {
+    Apply(op, [&](int y, int z, uint64_t* row) {
+        // Voxel centers within radius, solved for the span along x
+        const float dy = y + 0.5f - center.y;
+        const float dz = z + 0.5f - center.z;
+        const float span2 = radius * radius - dy * dy - dz * dz;
+        if (span2 <= 0.0f) {
+            return;
+        }
+        const float span = std::sqrt(span2);
+        const int begin =
+            std::max(int(std::ceil(center.x - span - 0.5f)), 0);
+        const int end =
+            std::min(int(std::floor(center.x + span - 0.5f)) + 1, size.x);
+        SetRange(row, begin, end);
+    });
+}
+
+void SelectionMask::SelectColor(const std::vector<float>& voxels, float value,
+                                Op op) {
+    const int index = int(value * 255.0f + 0.5f);
+    Apply(op, [&](int y, int z, uint64_t* row) {
+        const float* src = &voxels[(size_t(z) * size.y + y) * size.x];
+        for (int x = 0; x < size.x; ++x) {
+            if (int(src[x] * 255.0f + 0.5f) == index) {
+                row[x >> 6] |= 1ull << (x & 63);
+            }
+        }
+    });
+}
+
+void SelectionMask::SelectLabel(const std::vector<uint32_t>& labels,
+                                uint32_t label, Op op) {
+    if (labels.size() != size_t(size.x) * size.y * size.z) {
+        return;
+    }
+    Apply(op, [&](int y, int z, uint64_t* row) {
+        const uint32_t* src = &labels[(size_t(z) * size.y + y) * size.x];
+        for (int x = 0; x < size.x; ++x) {
+            if (src[x] == label) {
+                row[x >> 6] |= 1ull << (x & 63);
+            }
+        }
+    });
+}
+
+void SelectionMask::SelectRegion(const std::vector<uint8_t>& region,
+                                 const glm::ivec3& min,
+                                 const glm::ivec3& regionSize, Op op) {
+    Apply(op, [&](int y, int z, uint64_t* row) {
+        const int ry = y - min.y;
+        const int rz = z - min.z;
+        if (ry < 0 || ry >= regionSize.y || rz < 0 || rz >= regionSize.z) {
+            return;
+        }
+        const uint8_t* src =
+            &region[(size_t(rz) * regionSize.y + ry) * regionSize.x];
+        const int begin = std::max(min.x, 0);
+        const int end = std::min(min.x + regionSize.x, size.x);
+        for (int x = begin; x < end; ++x) {
+            if (src[x - min.x]) {
+                row[x >> 6] |= 1ull << (x & 63);
+            }
+        }
+    });
+}
+
+void SelectionMask::Recount() {
+    std::vector<uint64_t> sliceCounts(size.z, 0);
+    const size_t sliceWords = wordsPerRow * size.y;
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        const uint64_t* slice = &words[z * sliceWords];
+        uint64_t sum = 0;
+        for (size_t i = 0; i < sliceWords; ++i) {
+            sum += std::popcount(slice[i]);
+        }
+        sliceCounts[z] = sum;
+    });
+    count = 0;
+    for (uint64_t sliceCount : sliceCounts) {
+        count += sliceCount;
+    }
+}
+
+bool SelectionMask::getBounds(glm::ivec3& min, glm::ivec3& max) const {
+    if (count == 0) {
+        return false;
+    }
+    std::vector<glm::ivec3> sliceMin(size.z, size);
+    std::vector<glm::ivec3> sliceMax(size.z, glm::ivec3(0));
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        for (int y = 0; y < size.y; ++y) {
+            const uint64_t* row = &words[rowOffset(y, z)];
+            for (size_t w = 0; w < wordsPerRow; ++w) {
+                if (row[w] == 0) {
+                    continue;
+                }
+                const int first = int(w * 64) + std::countr_zero(row[w]);
+                const int last = int(w * 64) + 63 - std::countl_zero(row[w]);
+                sliceMin[z] = glm::min(sliceMin[z], glm::ivec3(first, y, z));
+                sliceMax[z] =
+                    glm::max(sliceMax[z], glm::ivec3(last + 1, y + 1, z + 1));
+            }
+        }
+    });
+    min = size;
+    max = glm::ivec3(0);
+    for (int z = 0; z < size.z; ++z) {
+        min = glm::min(min, sliceMin[z]);
+        max = glm::max(max, sliceMax[z]);
+    }
+    return true;
+}
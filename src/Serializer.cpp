@@ -1,51 +1,151 @@
 #include "Serializer.hpp"
 #include "Palette.hpp"
+#include "PaletteQuantizer.hpp"
+#include "Parallel.hpp"
 #include "VoxelManager.hpp"
 #include "imgui.h"
 #include "imgui_stdlib.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <tiny_obj_loader.h>
 
-Serializer::Serializer() {}
+namespace {
 
-Serializer::~Serializer() {}
+// Voxels per read while streaming a .nupr file, 4 MB of RGBA
+constexpr size_t nuprChunk = 1 << 20;
 
-int Serializer::Import(VoxelManager& voxelManager,
-                       PaletteManager& paletteManager) {
-    int res = fileDialog.OpenFileDialog(path);
-    if (res == 2) {
-        return 2; // User canceled the dialog
-    } else if (res == 1) {
-        errorText = "Failed to open save dialog";
-        showModal = true;
-        return 1;
+// RGBA8 as one key, fully transparent colors all map to 0 (empty)
+inline uint32_t PackColor(const glm::u8vec4& color) {
+    if (color.a == 0) {
+        return 0;
     }
+    return uint32_t(color.r) | uint32_t(color.g) << 8 |
+           uint32_t(color.b) << 16 | uint32_t(color.a) << 24;
+}
 
-    // Check if the import path is valid
-    if (path.empty()) {
-        errorText = "Import path is empty!";
-        showModal = true;
-        return 1;
+// Exact colors of an RGBA file in first-seen order, id = position + 1.
+// Open addressing over a fixed table four times the largest palette.
+class ColorTable {
+  public:
+    static constexpr size_t maxColors = 255;
+
+  private:
+    static constexpr uint32_t capacity = 1024;
+    std::vector<uint32_t> keys = std::vector<uint32_t>(capacity, 0);
+    std::vector<uint16_t> ids = std::vector<uint16_t>(capacity, 0);
+    std::vector<uint32_t> colors;
+
+    static inline uint32_t Slot(uint32_t key) {
+        return (key * 2654435761u) >> 22;
     }
 
+  public:
+    // 0 when the color is not in the table
+    inline uint16_t Find(uint32_t key) const {
+        for (uint32_t s = Slot(key);; s = (s + 1) & (capacity - 1)) {
+            if (keys[s] == key || keys[s] == 0) {
+                return ids[s];
+            }
+        }
+    }
+    // False once the table already holds maxColors
+    inline bool Insert(uint32_t key) {
+        uint32_t s = Slot(key);
+        while (keys[s] != 0 && keys[s] != key) {
+            s = (s + 1) & (capacity - 1);
+        }
+        if (keys[s] == key) {
+            return true;
+        }
+        if (colors.size() >= maxColors) {
+            return false;
+        }
+        colors.push_back(key);
+        keys[s] = key;
+        ids[s] = static_cast<uint16_t>(colors.size());
+        return true;
+    }
+    inline const std::vector<uint32_t>& getColors() const { return colors; }
+};
+
+// Adds the new colors of a chunk to the table and writes the id of every
+// voxel; false when the chunk needs more colors than the table takes
+bool MapExactColors(const glm::u8vec4* voxels, size_t count,
+                    ColorTable& table, uint16_t* ids) {
+    constexpr size_t partSize = 1 << 16;
+    const uint32_t parts =
+        static_cast<uint32_t>((count + partSize - 1) / partSize);
+
+    // Unknown colors per part, runs of one color cost a single compare
+    std::vector<std::vector<uint32_t>> found(parts);
+    Parallel::For(0, parts, [&](uint32_t p) {
+        const size_t end = std::min(count, (p + 1) * partSize);
+        uint32_t last = 0;
+        for (size_t i = p * partSize; i < end; ++i) {
+            const uint32_t key = PackColor(voxels[i]);
+            if (key == 0 || key == last) {
+                continue;
+            }
+            last = key;
+            if (table.Find(key) != 0 ||
+                std::find(found[p].begin(), found[p].end(), key) !=
+                    found[p].end()) {
+                continue;
+            }
+            found[p].push_back(key);
+            if (found[p].size() > ColorTable::maxColors) {
+                return;
+            }
+        }
+    });
+    for (const std::vector<uint32_t>& keys : found) {
+        for (uint32_t key : keys) {
+            if (!table.Insert(key)) {
+                return false;
+            }
+        }
+    }
+
+    // The table is read-only from here on
+    Parallel::For(0, parts, [&](uint32_t p) {
+        const size_t end = std::min(count, (p + 1) * partSize);
+        uint32_t lastKey = 0;
+        uint16_t lastId = 0;
+        for (size_t i = p * partSize; i < end; ++i) {
+            const uint32_t key = PackColor(voxels[i]);
+            if (key != lastKey) {
+                lastKey = key;
+                lastId = key == 0 ? 0 : table.Find(key);
+            }
+            ids[i] = lastId;
+        }
+    });
+    return true;
+}
+
+} // namespace
+
+Serializer::Serializer() {}
+
+Serializer::~Serializer() {}
+
+int Serializer::ReadNuum(const std::string& path, NuumFile& nuum) {
     // Attempt to open the file for reading
     std::ifstream file(path, std::ios::binary);
     if (!file.is_open()) {
         errorText = "Failed to open file: " + path;
-        showModal = true;
         return 1;
     }
-    logString = "Importing from: " + path + "\n";
     // Read magic numbers
     char magic[5] = {0};
     file.read(magic, 4);
     if (file.fail() || std::string(magic) != "NUUM") {
         errorText = "Invalid file format";
-        file.close();
-        showModal = true;
         return 1;
     }
     // Read the version number
@@ -53,14 +153,11 @@ int Serializer::Import(VoxelManager& voxelManager,
     file.read(reinterpret_cast<char*>(&version), sizeof(uint16_t));
     if (file.fail()) {
         errorText = "Failed to read version";
-        file.close();
-        showModal = true;
         return 1;
     }
-    if (version != 1) {
+    // Version 2 stores 16-bit indices, for palettes past 256 entries
+    if (version != 1 && version != 2) {
         errorText = "Unsupported file version: " + std::to_string(version);
-        file.close();
-        showModal = true;
         return 1;
     }
     logString += "Version: " + std::to_string(version) + "\n";
@@ -75,87 +172,111 @@ int Serializer::Import(VoxelManager& voxelManager,
         (w > 0 && h > 0 && d > 0) && (w < 65535 && h < 65535 && d < 65535);
     if (file.fail() || !validDimensions) {
         errorText = "Failed to read dimensions";
-        file.close();
-        showModal = true;
         return 1;
     }
+    nuum.size = glm::ivec3(w, h, d);
     logString += "Dimensions: " + std::to_string(w) + "x" + std::to_string(h) +
                  "x" + std::to_string(d) + "\n";
 
     // Read palette data from the file
-    std::string paletteName;
     size_t nameLength;
     file.read(reinterpret_cast<char*>(&nameLength), sizeof(size_t));
     if (file.fail() || nameLength == 0) {
         errorText = "Failed to read palette name length";
-        file.close();
-        showModal = true;
         return 1;
     }
-    paletteName.resize(nameLength);
-    file.read(paletteName.data(), nameLength);
+    nuum.paletteName.resize(nameLength);
+    file.read(nuum.paletteName.data(), nameLength);
     if (file.fail()) {
         errorText = "Failed to read palette name";
-        file.close();
-        showModal = true;
         return 1;
     }
-    logString += "Palette: " + paletteName + "\n";
-    uint16_t selectedColorIndex;
-    file.read(reinterpret_cast<char*>(&selectedColorIndex), sizeof(uint16_t));
+    logString += "Palette: " + nuum.paletteName + "\n";
+    file.read(reinterpret_cast<char*>(&nuum.selectedIndex), sizeof(uint16_t));
     if (file.fail()) {
         errorText = "Failed to read selected color index";
-        file.close();
-        showModal = true;
         return 1;
     }
     logString +=
-        "Selected color index: " + std::to_string(selectedColorIndex) + "\n";
+        "Selected color index: " + std::to_string(nuum.selectedIndex) + "\n";
     uint16_t colorCount;
     file.read(reinterpret_cast<char*>(&colorCount), sizeof(uint16_t));
     if (file.fail() || colorCount == 0) {
         errorText = "Failed to read color count";
-        file.close();
-        showModal = true;
         return 1;
     }
     logString += "Color count: " + std::to_string(colorCount) + "\n";
-    std::vector<glm::vec4> colors(colorCount);
+    nuum.colors.resize(colorCount);
     for (uint16_t i = 0; i < colorCount; i++) {
-        file.read(reinterpret_cast<char*>(&colors[i]), sizeof(glm::vec4));
+        file.read(reinterpret_cast<char*>(&nuum.colors[i]), sizeof(glm::vec4));
         if (file.fail()) {
             errorText = "Failed to read color " + std::to_string(i);
-            file.close();
-            showModal = true;
             return 1;
         }
     }
     logString += "Colors read successfully.\n";
 
-    // Create a new palette with the read data
-    Palette palette(std::move(paletteName), std::move(colors));
-    palette.setSelectedColorIndex(selectedColorIndex);
-    paletteManager.ClearPalettes(); // Clear existing palettes
-    auto index = paletteManager.AddPalette(std::move(palette));
-    paletteManager.SetCurrentPalette(index);
-
-    // Set the dimensions
-    voxelManager.setSize(w, h, d);
-
     // Read voxel data from the file
-    std::vector<uint8_t> intVoxelData(w * h * d);
-    file.read(reinterpret_cast<char*>(intVoxelData.data()),
-              intVoxelData.size() * sizeof(uint8_t));
-    if (file.fail()) {
+    int readResult = DispatchIndex(
+        version == 2 ? IndexFormat::U16 : IndexFormat::U8, [&](auto zero) {
+            using Index = decltype(zero);
+            std::vector<Index> intVoxelData(size_t(w) * h * d);
+            file.read(reinterpret_cast<char*>(intVoxelData.data()),
+                      intVoxelData.size() * sizeof(Index));
+            if (file.fail()) {
+                return 1;
+            }
+            nuum.voxels.resize(intVoxelData.size());
+            std::transform(intVoxelData.begin(), intVoxelData.end(),
+                           nuum.voxels.begin(), VoxelIndex<Index>::Decode);
+            return 0;
+        });
+    if (readResult != 0) {
         errorText = "Failed to read voxel data";
-        file.close();
-        showModal = true;
         return 1;
     }
-    file.close();
     logString += "Voxel data read successfully.";
+    return 0;
+}
 
-    voxelManager.newVoxelData(intVoxelData, w, h, d);
+int Serializer::Import(VoxelManager& voxelManager,
+                       PaletteManager& paletteManager) {
+    int res = fileDialog.OpenFileDialog(path);
+    if (res == 2) {
+        return 2; // User canceled the dialog
+    } else if (res == 1) {
+        errorText = "Failed to open save dialog";
+        showModal = true;
+        return 1;
+    }
+
+    // Check if the import path is valid
+    if (path.empty()) {
+        errorText = "Import path is empty!";
+        showModal = true;
+        return 1;
+    }
+    logString = "Importing from: " + path + "\n";
+    NuumFile nuum;
+    if (ReadNuum(path, nuum) != 0) {
+        showModal = true;
+        return 1;
+    }
+
+    // Create a new palette with the read data
+    Palette palette(std::move(nuum.paletteName), std::move(nuum.colors));
+    palette.setSelectedColorIndex(nuum.selectedIndex);
+    paletteManager.ClearPalettes(); // Clear existing palettes
+    auto index = paletteManager.AddPalette(std::move(palette));
+    paletteManager.SetCurrentPalette(index);
+
+    // Set the dimensions and take over the voxels
+    voxelManager.setSize(nuum.size.x, nuum.size.y, nuum.size.z);
+    voxelManager.newVoxelData(std::move(nuum.voxels), nuum.size.x,
+                              nuum.size.y, nuum.size.z);
+
+    // Saved palettes often carry colors the model never uses
+    paletteManager.RemoveUnusedColors(voxelManager.getUsage());
 
     std::cout << "Import log:\n" << logString << std::endl;
 
@@ -204,8 +325,9 @@ int Serializer::Export(VoxelManager& voxelManager,
         return 1;
     }
 
-    // Wrtie the version number
-    const uint16_t version = 1; // Version number for the file format
+    // Wrtie the version number, 2 when indices need 16 bits
+    const IndexFormat format = voxelManager.getIndexFormat();
+    const uint16_t version = format == IndexFormat::U16 ? 2 : 1;
     file.write(reinterpret_cast<const char*>(&version), sizeof(uint16_t));
     logString += "Version: " + std::to_string(version) + "\n";
 
@@ -275,17 +397,16 @@ int Serializer::Export(VoxelManager& voxelManager,
     }
     logString += "Colors written successfully.\n";
 
-    // Prepare voxel data for writing
-    auto intVoxelData = std::vector<uint8_t>(size.x * size.y * size.z);
-    for (size_t i = 0; i < intVoxelData.size(); ++i) {
-        // Convert float voxel data to uint8_t (0-255)
-        intVoxelData[i] =
-            static_cast<uint8_t>(voxelManager.getVoxel()[i] * 255.0f);
-    }
-
-    // Write voxel data to the file, binary
-    file.write(reinterpret_cast<const char*>(intVoxelData.data()),
-               intVoxelData.size() * sizeof(uint8_t));
+    // Pack the voxel data to the file's index width and write it
+    DispatchIndex(format, [&](auto zero) {
+        using Index = decltype(zero);
+        const std::vector<float>& voxels = voxelManager.getVoxel();
+        std::vector<Index> intVoxelData(voxels.size());
+        std::transform(voxels.begin(), voxels.end(), intVoxelData.begin(),
+                       VoxelIndex<Index>::Encode);
+        file.write(reinterpret_cast<const char*>(intVoxelData.data()),
+                   intVoxelData.size() * sizeof(Index));
+    });
     if (file.fail()) {
         errorText = "Failed to write voxel data";
         file.close();
@@ -451,6 +572,281 @@ int Serializer::ImportFromObj(VoxelManager& voxelManager,
     return 0;
 }
 
+int Serializer::ImportFromNUPR(VoxelManager& voxelManager,
+                               PaletteManager& paletteManager) {
+    int res = fileDialog.OpenFileDialog(path);
+    if (res == 2) {
+        return 2; // User canceled the dialog
+    } else if (res == 1) {
+        errorText = "Failed to open file dialog";
+        showModal = true;
+        return 1;
+    }
+
+    if (path.empty()) {
+        errorText = "Import path is empty!";
+        showModal = true;
+        return 1;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        errorText = "Failed to open file: " + path;
+        showModal = true;
+        return 1;
+    }
+    logString = "Importing from .nupr file: " + path + "\n";
+
+    // Same layout ExportToNUPR writes
+    char magic[5] = {0};
+    file.read(magic, sizeof(magic));
+    if (file.fail() || std::string(magic) != "NUPR") {
+        errorText = "Invalid file format";
+        file.close();
+        showModal = true;
+        return 1;
+    }
+    uint32_t sizeX, sizeY, sizeZ;
+    uint64_t count;
+    file.read(reinterpret_cast<char*>(&sizeX), sizeof(sizeX));
+    file.read(reinterpret_cast<char*>(&sizeY), sizeof(sizeY));
+    file.read(reinterpret_cast<char*>(&sizeZ), sizeof(sizeZ));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    bool validDimensions = sizeX > 0 && sizeY > 0 && sizeZ > 0 &&
+                           sizeX <= 2048 && sizeY <= 2048 && sizeZ <= 2048 &&
+                           count == uint64_t(sizeX) * sizeY * sizeZ;
+    if (file.fail() || !validDimensions) {
+        errorText = "Failed to read voxel grid size";
+        file.close();
+        showModal = true;
+        return 1;
+    }
+    logString += "Voxel grid size: " + std::to_string(sizeX) + "x" +
+                 std::to_string(sizeY) + "x" + std::to_string(sizeZ) + "\n";
+
+    // Files written from a palette have few distinct colors, those are
+    // matched exactly in one streamed pass. Anything richer is quantized
+    // in two more passes over the file.
+    const std::streampos dataStart = file.tellg();
+    std::vector<glm::u8vec4> chunk(std::min<uint64_t>(count, nuprChunk));
+    auto readChunk = [&](uint64_t offset) {
+        const size_t n = std::min<uint64_t>(nuprChunk, count - offset);
+        file.read(reinterpret_cast<char*>(chunk.data()),
+                  n * sizeof(glm::u8vec4));
+        return file.fail() ? size_t(0) : n;
+    };
+
+    ColorTable table;
+    std::vector<uint16_t> ids(count);
+    bool exact = true;
+    for (uint64_t offset = 0; offset < count && exact; offset += nuprChunk) {
+        const size_t n = readChunk(offset);
+        if (n == 0) {
+            errorText = "Failed to read voxels";
+            file.close();
+            showModal = true;
+            return 1;
+        }
+        exact = MapExactColors(chunk.data(), n, table, &ids[offset]);
+    }
+
+    if (exact) {
+        // Reuse the current palette when it has every color, so exported
+        // models come back with their original indices
+        const std::vector<uint32_t>& colors = table.getColors();
+        const auto& current = paletteManager.GetCurrentPalette().getColors();
+        std::vector<uint16_t> lut(colors.size() + 1, 0);
+        for (size_t c = 0; c < colors.size(); ++c) {
+            for (size_t i = 1; i < current.size() && lut[c + 1] == 0; ++i) {
+                const glm::vec4& color = current[i];
+                glm::u8vec4 rgba(static_cast<uint8_t>(color.r * 255),
+                                 static_cast<uint8_t>(color.g * 255),
+                                 static_cast<uint8_t>(color.b * 255),
+                                 static_cast<uint8_t>(color.a * 255));
+                if (PackColor(rgba) == colors[c]) {
+                    lut[c + 1] = static_cast<uint16_t>(i);
+                }
+            }
+        }
+        if (std::find(lut.begin() + 1, lut.end(), 0) != lut.end()) {
+            std::vector<glm::vec4> paletteColors;
+            for (uint32_t key : colors) {
+                paletteColors.emplace_back(
+                    (key & 0xff) / 255.0f, ((key >> 8) & 0xff) / 255.0f,
+                    ((key >> 16) & 0xff) / 255.0f, (key >> 24) / 255.0f);
+                lut[paletteColors.size()] =
+                    static_cast<uint16_t>(paletteColors.size());
+            }
+            paletteManager.SetCurrentPalette(paletteManager.AddPalette(
+                "Imported NUPR", std::move(paletteColors)));
+        }
+        Parallel::For(
+            0, static_cast<uint32_t>((count + nuprChunk - 1) / nuprChunk),
+            [&](uint32_t c) {
+                const size_t end =
+                    std::min<uint64_t>(count, (c + 1) * nuprChunk);
+                for (size_t i = c * nuprChunk; i < end; ++i) {
+                    ids[i] = lut[ids[i]];
+                }
+            });
+        logString += "Matched " + std::to_string(colors.size()) +
+                     " exact colors.\n";
+        voxelManager.setSize(sizeX, sizeY, sizeZ);
+        voxelManager.newVoxelData(ids, sizeX, sizeY, sizeZ);
+    } else {
+        ids = std::vector<uint16_t>();
+        PaletteQuantizer quantizer;
+        file.clear();
+        file.seekg(dataStart);
+        for (uint64_t offset = 0; offset < count; offset += nuprChunk) {
+            const size_t n = readChunk(offset);
+            quantizer.Add(chunk.data(), n);
+        }
+        const int colorCount = quantizer.Build();
+        std::vector<uint8_t> indices(count);
+        file.clear();
+        file.seekg(dataStart);
+        for (uint64_t offset = 0; offset < count; offset += nuprChunk) {
+            const size_t n = readChunk(offset);
+            quantizer.Map(chunk.data(), n, &indices[offset]);
+        }
+        if (file.fail()) {
+            errorText = "Failed to read voxels";
+            file.close();
+            showModal = true;
+            return 1;
+        }
+        paletteManager.SetCurrentPalette(
+            paletteManager.AddPalette(quantizer.MakePalette("Imported NUPR")));
+        logString += "Quantized to " + std::to_string(colorCount) +
+                     " colors.\n";
+        voxelManager.setSize(sizeX, sizeY, sizeZ);
+        voxelManager.newVoxelData(indices, sizeX, sizeY, sizeZ);
+    }
+    file.close();
+
+    std::cout << "Import log:\n" << logString << std::endl;
+    logString.clear();
+    return 0;
+}
+
+int Serializer::ImportPointCloud(VoxelManager& voxelManager,
+                                 PaletteManager& paletteManager) {
+    int res = fileDialog.OpenFileDialog(path);
+    if (res == 2) {
+        return 2; // User canceled the dialog
+    } else if (res == 1) {
+        errorText = "Failed to open file dialog";
+        showModal = true;
+        return 1;
+    }
+    if (path.empty()) {
+        errorText = "Import path is empty!";
+        showModal = true;
+        return 1;
+    }
+    logString = "Importing point cloud: " + path + "\n";
+
+    auto start = std::chrono::steady_clock::now();
+    if (pointCloudImporter.Import(path, voxelManager, paletteManager,
+                                  logString, errorText) != 0) {
+        showModal = true;
+        return 1;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    logString += "Voxelized in " + std::to_string(elapsed.count()) + " ms\n";
+
+    std::cout << "Import log:\n" << logString << std::endl;
+    logString.clear();
+    return 0;
+}
+
+int Serializer::ImportImageSlices(VoxelManager& voxelManager,
+                                  PaletteManager& paletteManager) {
+    int res = fileDialog.PickFolderDialog(path);
+    if (res == 2) {
+        return 2; // User canceled the dialog
+    } else if (res == 1) {
+        errorText = "Failed to open folder dialog";
+        showModal = true;
+        return 1;
+    }
+    if (path.empty()) {
+        errorText = "Import path is empty!";
+        showModal = true;
+        return 1;
+    }
+    logString = "Importing image slices from: " + path + "\n";
+
+    auto start = std::chrono::steady_clock::now();
+    if (imageImporter.ImportSlices(path, voxelManager, paletteManager,
+                                   logString, errorText) != 0) {
+        showModal = true;
+        return 1;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    logString += "Slices read in " + std::to_string(elapsed.count()) + " ms\n";
+
+    std::cout << "Import log:\n" << logString << std::endl;
+    logString.clear();
+    return 0;
+}
+
+int Serializer::ImportHeightmap(VoxelManager& voxelManager,
+                                PaletteManager& paletteManager) {
+    int res = fileDialog.OpenFileDialog(path);
+    if (res == 2) {
+        return 2; // User canceled the dialog
+    } else if (res == 1) {
+        errorText = "Failed to open file dialog";
+        showModal = true;
+        return 1;
+    }
+    if (path.empty()) {
+        errorText = "Import path is empty!";
+        showModal = true;
+        return 1;
+    }
+    logString = "Importing heightmap: " + path + "\n";
+
+    if (imageImporter.ImportHeightmap(path, voxelManager, paletteManager,
+                                      logString, errorText) != 0) {
+        showModal = true;
+        return 1;
+    }
+
+    std::cout << "Import log:\n" << logString << std::endl;
+    logString.clear();
+    return 0;
+}
+
+int Serializer::ImportCsgVolume(Csg& csg) {
+    // The document path stays, the operand is not the open file
+    std::string volumePath;
+    int res = fileDialog.OpenFileDialog(volumePath);
+    if (res == 2) {
+        return 2; // User canceled the dialog
+    } else if (res == 1) {
+        errorText = "Failed to open file dialog";
+        showModal = true;
+        return 1;
+    }
+    logString = "Reading CSG volume: " + volumePath + "\n";
+    NuumFile nuum;
+    if (ReadNuum(volumePath, nuum) != 0) {
+        showModal = true;
+        return 1;
+    }
+    csg.SetVolume(std::filesystem::path(volumePath).stem().string(), nuum.size,
+                  std::move(nuum.voxels), std::move(nuum.colors));
+
+    std::cout << "Import log:\n" << logString << std::endl;
+    logString.clear();
+    return 0;
+}
+
 int Serializer::ExportToNUPR(VoxelManager& voxelManager,
                              PaletteManager& paletteManager) {
     // Open file dialog to get the export path
@@ -511,13 +907,17 @@ int Serializer::ExportToNUPR(VoxelManager& voxelManager,
 
     auto& voxelData = voxelManager.getVoxel();
     auto& palette = paletteManager.GetCurrentPalette().getColors();
+    const SelectionMask* selection = ExportSelection(voxelManager);
     std::vector<glm::u8vec4> voxelColorsVec(sizeX * sizeY * sizeZ);
     for (uint32_t x = 0; x < sizeX; x++) {
         for (uint32_t y = 0; y < sizeY; y++) {
             for (uint32_t z = 0; z < sizeZ; z++) {
                 uint32_t index = x + y * sizeX + z * sizeX * sizeY;
-                uint16_t voxelValue = voxelData[index] * 255.0f;
-                if (voxelValue == 0) {
+                const int voxelValue =
+                    VoxelManager::paletteIndex(voxelData[index]);
+                // Indices past the palette are exported as empty
+                if (voxelValue == 0 || voxelValue >= int(palette.size()) ||
+                    (selection && !selection->test(glm::ivec3(x, y, z)))) {
                     voxelColorsVec[index] = glm::u8vec4(0, 0, 0, 0);
                 } else {
                     glm::vec4 color = palette[voxelValue];
@@ -561,6 +961,117 @@ int Serializer::ExportToNUPR(VoxelManager& voxelManager,
 
     return 0;
 }
+int Serializer::ExportMesh(VoxelManager& voxelManager,
+                           PaletteManager& paletteManager,
+                           MeshExporter::Format format) {
+    const char* defaultName = format == MeshExporter::Format::OBJ ? "Untitled.obj"
+                              : format == MeshExporter::Format::PLY
+                                  ? "Untitled.ply"
+                                  : "Untitled.gltf";
+    std::string meshPath;
+    int res = fileDialog.SaveFileDialog(meshPath, defaultName);
+    if (res == 2) {
+        return 2; // User canceled the dialog
+    } else if (res == 1) {
+        errorText = "Failed to open save dialog";
+        showModal = true;
+        return 1;
+    }
+    if (meshPath.empty()) {
+        errorText = "Export path is empty!";
+        showModal = true;
+        return 1;
+    }
+    logString = "Exporting mesh to: " + meshPath + "\n";
+
+    auto start = std::chrono::steady_clock::now();
+    if (meshExporter.Export(meshPath, format, voxelManager, paletteManager,
+                            logString, errorText,
+                            ExportSelection(voxelManager)) != 0) {
+        showModal = true;
+        return 1;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    logString += "Mesh written in " + std::to_string(elapsed.count()) + " ms\n";
+
+    std::cout << "Export log:\n" << logString << std::endl;
+
+    logString.clear();
+    return 0;
+}
+
+const SelectionMask* Serializer::ExportSelection(VoxelManager& voxelManager) {
+    const SelectionMask& selection = voxelManager.getSelection();
+    if (!exportSelectionOnly || selection.isEmpty()) {
+        return nullptr;
+    }
+    logString += "Exporting " + std::to_string(selection.getCount()) +
+                 " selected voxels\n";
+    return &selection;
+}
+
+int Serializer::ExportRender(PathTracer& pathTracer) {
+    std::vector<uint8_t> rgba;
+    uint32_t w = 0, h = 0;
+    pathTracer.GetImage(rgba, w, h);
+    if (rgba.empty() || w > 65535 || h > 65535) {
+        errorText = "No rendered image, enable path tracing first";
+        showModal = true;
+        return 1;
+    }
+
+    std::string imagePath;
+    int res = fileDialog.SaveFileDialog(imagePath, "Render.tga");
+    if (res == 2) {
+        return 2; // User canceled the dialog
+    } else if (res == 1) {
+        errorText = "Failed to open save dialog";
+        showModal = true;
+        return 1;
+    }
+
+    std::ofstream file(imagePath, std::ios::binary);
+    if (!file.is_open()) {
+        errorText = "Failed to open file: " + imagePath;
+        showModal = true;
+        return 1;
+    }
+    logString = "Exporting render to: " + imagePath + "\n";
+
+    // Uncompressed 32-bit truecolor TGA, top-left origin
+    uint8_t header[18] = {0};
+    header[2] = 2;
+    header[12] = w & 0xff;
+    header[13] = (w >> 8) & 0xff;
+    header[14] = h & 0xff;
+    header[15] = (h >> 8) & 0xff;
+    header[16] = 32;
+    header[17] = 0x28;
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    // TGA stores BGRA
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        std::swap(rgba[i], rgba[i + 2]);
+    }
+    file.write(reinterpret_cast<const char*>(rgba.data()), rgba.size());
+    if (file.fail()) {
+        errorText = "Failed to write image data";
+        file.close();
+        showModal = true;
+        return 1;
+    }
+    file.close();
+    logString += "Image: " + std::to_string(w) + "x" + std::to_string(h) +
+                 ", " + std::to_string(pathTracer.getSampleCount()) +
+                 " samples\n";
+
+    std::cout << "Export log:\n" << logString << std::endl;
+
+    logString.clear();
+    return 0;
+}
+
 void Serializer::Init(SDL_Window* window) {
     this->window = window;
     fileDialog.Init(window);
@@ -0,0 +1,310 @@
+#include "SpanRaster.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace SpanRaster {
+
+namespace {
+
+inline size_t VoxelOffset(const glm::ivec3& voxel, const glm::ivec3& size) {
+    return (size_t(voxel.z) * size.y + voxel.y) * size.x + voxel.x;
+}
+
+// Adds a voxel, growing the last span when it continues its row
+inline void Append(std::vector<Span>& spans, const glm::ivec3& voxel,
+                   float value) {
+    if (!spans.empty()) {
+        Span& last = spans.back();
+        if (last.start.y == voxel.y && last.start.z == voxel.z &&
+            last.value == value) {
+            if (voxel.x == last.start.x + last.length) {
+                ++last.length;
+                return;
+            }
+            if (voxel.x == last.start.x - 1) {
+                --last.start.x;
+                ++last.length;
+                return;
+            }
+        }
+    }
+    spans.push_back({voxel, 1, value});
+}
+
+} // namespace
+
+void Line(const glm::ivec3& a, const glm::ivec3& b, float value,
+          std::vector<Span>& spans) {
+    const glm::ivec3 delta = glm::abs(b - a);
+    const glm::ivec3 step = glm::sign(b - a);
+    // Steps along the longest axis, the other two follow by their errors
+    int major = 0;
+    if (delta.y > delta[major]) {
+        major = 1;
+    }
+    if (delta.z > delta[major]) {
+        major = 2;
+    }
+    const int first = (major + 1) % 3;
+    const int second = (major + 2) % 3;
+    int errorFirst = 2 * delta[first] - delta[major];
+    int errorSecond = 2 * delta[second] - delta[major];
+    glm::ivec3 voxel = a;
+    for (int i = 0; i <= delta[major]; ++i) {
+        Append(spans, voxel, value);
+        if (errorFirst > 0) {
+            voxel[first] += step[first];
+            errorFirst -= 2 * delta[major];
+        }
+        if (errorSecond > 0) {
+            voxel[second] += step[second];
+            errorSecond -= 2 * delta[major];
+        }
+        errorFirst += 2 * delta[first];
+        errorSecond += 2 * delta[second];
+        voxel[major] += step[major];
+    }
+}
+
+void Sphere(const glm::ivec3& center, int diameter, float value,
+            std::vector<Span>& spans) {
+    const int reach = diameter / 2;
+    const float radius2 = (diameter / 2.0f) * (diameter / 2.0f);
+    for (int z = center.z - reach; z <= center.z + reach; ++z) {
+        for (int y = center.y - reach; y <= center.y + reach; ++y) {
+            // The sphere cuts every row down to one span
+            const float dy = float(y - center.y);
+            const float dz = float(z - center.z);
+            const float rest = radius2 - dy * dy - dz * dz;
+            if (rest <= 0.0f) {
+                continue;
+            }
+            const int half =
+                std::min(int(std::ceil(std::sqrt(rest))) - 1, reach);
+            spans.push_back(
+                {glm::ivec3(center.x - half, y, z), 2 * half + 1, value});
+        }
+    }
+}
+
+void Box(const glm::ivec3& a, const glm::ivec3& b, bool hollow, float value,
+         std::vector<Span>& spans) {
+    const glm::ivec3 min = glm::min(a, b);
+    const glm::ivec3 max = glm::max(a, b);
+    const int length = max.x - min.x + 1;
+    for (int z = min.z; z <= max.z; ++z) {
+        for (int y = min.y; y <= max.y; ++y) {
+            // Inside the shell only the two ends of a row are solid
+            if (!hollow || y == min.y || y == max.y || z == min.z ||
+                z == max.z || length <= 2) {
+                spans.push_back({glm::ivec3(min.x, y, z), length, value});
+            } else {
+                spans.push_back({glm::ivec3(min.x, y, z), 1, value});
+                spans.push_back({glm::ivec3(max.x, y, z), 1, value});
+            }
+        }
+    }
+}
+
+bool Extrude(const std::vector<float>& voxels, const glm::ivec3& size,
+             const glm::ivec3& voxel, const glm::ivec3& normal, int depth,
+             bool push, std::vector<Span>& spans) {
+    int axis = 0;
+    while (axis < 2 && normal[axis] == 0) {
+        ++axis;
+    }
+    if (normal == glm::ivec3(0) || depth <= 0 ||
+        glm::any(glm::lessThan(voxel, glm::ivec3(0))) ||
+        glm::any(glm::greaterThanEqual(voxel, size))) {
+        return false;
+    }
+    // A face voxel is solid and open towards the normal inside the grid
+    auto isFace = [&](const glm::ivec3& p) {
+        const glm::ivec3 front = p + normal;
+        return voxels[VoxelOffset(p, size)] > 0.003f &&
+               front[axis] >= 0 && front[axis] < size[axis] &&
+               voxels[VoxelOffset(front, size)] <= 0.003f;
+    };
+    if (!isFace(voxel)) {
+        return false;
+    }
+
+    // Flood the plane, marking the face in a mask over its two axes
+    const int spanAxis = axis == 0 ? 1 : 0;
+    const int rowAxis = 3 - axis - spanAxis;
+    const int planeWidth = size[spanAxis];
+    std::vector<uint8_t> face(size_t(planeWidth) * size[rowAxis], 0);
+    auto faceIndex = [&](const glm::ivec3& p) {
+        return size_t(p[rowAxis]) * planeWidth + p[spanAxis];
+    };
+    FloodFill(
+        size, voxel, spanAxis, {rowAxis},
+        [&](const glm::ivec3& p) { return !face[faceIndex(p)] && isFace(p); },
+        [&](const glm::ivec3& p) { face[faceIndex(p)] = 1; });
+
+    // Layers out from the face, or the face and the ones behind it
+    const int layerFirst = push ? 1 - depth : 1;
+    const int layerLast = push ? 0 : depth;
+    const int sign = normal[axis];
+    glm::ivec3 p = voxel;
+    for (p[rowAxis] = 0; p[rowAxis] < size[rowAxis]; ++p[rowAxis]) {
+        for (p[spanAxis] = 0; p[spanAxis] < planeWidth; ++p[spanAxis]) {
+            if (!face[faceIndex(p)]) {
+                continue;
+            }
+            const float value = voxels[VoxelOffset(p, size)];
+            if (axis == 0) {
+                // Along x a whole column of layers is a single span
+                const int a = p.x + sign * layerFirst;
+                const int b = p.x + sign * layerLast;
+                spans.push_back({glm::ivec3(std::min(a, b), p.y, p.z),
+                                 depth, value});
+                continue;
+            }
+            for (int layer = layerFirst; layer <= layerLast; ++layer) {
+                glm::ivec3 q = p;
+                q[axis] += sign * layer;
+                spans.push_back({q, 1, value});
+            }
+        }
+    }
+    if (axis != 0) {
+        // Rows of the face run along x, join them into spans per layer
+        std::stable_sort(spans.begin(), spans.end(),
+                         [](const Span& a, const Span& b) {
+                             return a.start.z != b.start.z
+                                        ? a.start.z < b.start.z
+                                        : a.start.y < b.start.y;
+                         });
+        std::vector<Span> joined;
+        joined.reserve(spans.size());
+        for (const Span& span : spans) {
+            Append(joined, span.start, span.value);
+        }
+        spans.swap(joined);
+    }
+    return true;
+}
+
+bool Clip(std::vector<Span>& spans, const glm::ivec3& size, glm::ivec3& min,
+          glm::ivec3& max) {
+    min = size;
+    max = glm::ivec3(0);
+    size_t kept = 0;
+    for (const Span& span : spans) {
+        if (span.start.y < 0 || span.start.y >= size.y || span.start.z < 0 ||
+            span.start.z >= size.z) {
+            continue;
+        }
+        const int begin = std::max(span.start.x, 0);
+        const int end = std::min(span.start.x + span.length, size.x);
+        if (begin >= end) {
+            continue;
+        }
+        const glm::ivec3 start(begin, span.start.y, span.start.z);
+        spans[kept++] = {start, end - begin, span.value};
+        min = glm::min(min, start);
+        max = glm::max(max, glm::ivec3(end, start.y + 1, start.z + 1));
+    }
+    spans.resize(kept);
+    return kept > 0;
+}
+
+uint64_t Write(VoxelManager& voxelManager, const std::vector<Span>& spans,
+               bool erase) {
+    if (spans.empty()) {
+        return 0;
+    }
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    std::vector<float>& voxels = voxelManager.getVoxel();
+
+    // Spans never overlap, so runs of them are written in parallel; small
+    // shapes like a brush stamp stay on the calling thread
+    size_t voxelCount = 0;
+    for (const Span& span : spans) {
+        voxelCount += span.length;
+    }
+    const uint32_t parts = static_cast<uint32_t>(std::clamp<size_t>(
+        voxelCount / 65536, 1,
+        std::min<size_t>(spans.size(), Parallel::ThreadCount() * 4)));
+    std::vector<glm::ivec3> partMin(parts, size);
+    std::vector<glm::ivec3> partMax(parts, glm::ivec3(0));
+    std::vector<uint64_t> partChanged(parts, 0);
+    Parallel::For(0, parts, [&](uint32_t part) {
+        VoxelManager::UsageDelta delta = voxelManager.newUsageDelta();
+        const size_t end = spans.size() * (part + 1) / parts;
+        for (size_t i = spans.size() * part / parts; i < end; ++i) {
+            const Span& span = spans[i];
+            const size_t row = VoxelOffset(span.start, size);
+            for (int x = 0; x < span.length; ++x) {
+                float& current = voxels[row + x];
+                const glm::ivec3 voxel(span.start.x + x, span.start.y,
+                                       span.start.z);
+                if ((current <= 0.003f) == erase ||
+                    !voxelManager.isEditable(voxel)) {
+                    continue;
+                }
+                const float target = erase ? 0.0f : span.value;
+                VoxelManager::countChange(delta, current, target);
+                current = target;
+                partMin[part] = glm::min(partMin[part], voxel);
+                partMax[part] = glm::max(partMax[part], voxel + 1);
+                ++partChanged[part];
+            }
+        }
+        voxelManager.applyUsage(delta);
+    });
+
+    glm::ivec3 min = size;
+    glm::ivec3 max(0);
+    uint64_t changed = 0;
+    for (uint32_t part = 0; part < parts; ++part) {
+        min = glm::min(min, partMin[part]);
+        max = glm::max(max, partMax[part]);
+        changed += partChanged[part];
+    }
+    voxelManager.markDirty(min, max);
+    return changed;
+}
+
+void Preview(VoxelManager& voxelManager, const std::vector<Span>& spans,
+             bool erase) {
+    OverlayVolume& overlay = voxelManager.getOverlay();
+    if (spans.empty()) {
+        overlay.Hide();
+        return;
+    }
+    glm::ivec3 min = spans.front().start;
+    glm::ivec3 max = min;
+    for (const Span& span : spans) {
+        min = glm::min(min, span.start);
+        max = glm::max(max, span.start + glm::ivec3(span.length, 1, 1));
+    }
+    const glm::ivec3 extent = max - min;
+    if (!overlay.showsVoxels(extent)) {
+        overlay.SetOutline(min, extent);
+        return;
+    }
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    const std::vector<float>& voxels = voxelManager.getVoxel();
+
+    // Erasing shows the voxels that go away in their own colors
+    std::vector<uint16_t> values(size_t(extent.x) * extent.y * extent.z, 0);
+    for (const Span& span : spans) {
+        const glm::ivec3 local = span.start - min;
+        uint16_t* out =
+            &values[(size_t(local.z) * extent.y + local.y) * extent.x +
+                    local.x];
+        const float* in = &voxels[VoxelOffset(span.start, size)];
+        for (int x = 0; x < span.length; ++x) {
+            if ((in[x] <= 0.003f) != erase) {
+                out[x] = VoxelIndex<uint16_t>::Encode(erase ? in[x]
+                                                            : span.value);
+            }
+        }
+    }
+    overlay.Set(min, extent, values);
+}
+
+} // namespace SpanRaster
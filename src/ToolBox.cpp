@@ -1,9 +1,19 @@
 #include "ToolBox.hpp"
+#include "Parallel.hpp"
+#include "glm/common.hpp"
 #include "glm/fwd.hpp"
 #include "imgui.h"
 #include <iostream>
 #include <vector>
 
+namespace {
+
+inline size_t VoxelOffset(const glm::ivec3& voxel, const glm::ivec3& size) {
+    return (size_t(voxel.z) * size.y + voxel.y) * size.x + voxel.x;
+}
+
+} // namespace
+
 ToolBox::ToolBox() {}
 
 ToolBox::~ToolBox() {}
@@ -21,76 +31,527 @@ int ToolBox::useTool(const HitInfo& hit, VoxelManager& voxelManager,
         return useBucket(hit, voxelManager, paletteManager, altAction);
     case 2: // Brush
         return useBrush(hit, voxelManager, paletteManager, altAction);
+    case 3: // Island
+        return useIsland(hit, voxelManager, paletteManager, altAction);
+    case 4: // Select
+        return useSelect(hit, voxelManager, paletteManager, altAction);
+    case 5: // Paste
+        return usePaste(hit, voxelManager, paletteManager, altAction);
+    case 6: // Line
+        return useLine(hit, voxelManager, paletteManager, altAction);
+    case 7: // Box
+        return useBox(hit, voxelManager, paletteManager, altAction);
+    case 8: // Extrude
+        return useExtrude(hit, voxelManager, paletteManager, altAction);
     default:
         return -1; // Invalid tool
     }
 }
 
+std::vector<glm::ivec3> ToolBox::MirrorImages(const glm::ivec3& voxel,
+                                              const glm::ivec3& size) const {
+    std::vector<glm::ivec3> images = {voxel};
+    for (int axis = 0; axis < 3; ++axis) {
+        if (!(mirrorAxes & (1 << axis))) {
+            continue;
+        }
+        // Each plane doubles what is there, a voxel on it maps to itself
+        const size_t count = images.size();
+        for (size_t i = 0; i < count; ++i) {
+            glm::ivec3 image = images[i];
+            image[axis] = size[axis] - 1 - image[axis];
+            if (image != images[i]) {
+                images.push_back(image);
+            }
+        }
+    }
+    return images;
+}
+
 int ToolBox::useBucket(const HitInfo& hit, VoxelManager& voxelManager,
-                       PaletteManager& paletteManager, bool altAction) {}
+                       PaletteManager& paletteManager, bool altAction) {
+    // Clicks on the grid floor hit no voxel to start from
+    if (hit.edge) {
+        return -1;
+    }
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    std::vector<float>& voxels = voxelManager.getVoxel();
+    const float paint = VoxelIndex<uint16_t>::Decode(
+        paletteManager.GetCurrentPalette().getSelectedIndex());
+    const float face = voxels[VoxelOffset(hit.pos, size)];
+    int normalAxis = 0;
+    while (normalAxis < 2 && hit.normal[normalAxis] == 0) {
+        ++normalAxis;
+    }
+
+    // All mirrored fills share one usage delta, each marks its own box
+    VoxelManager::UsageDelta delta = voxelManager.newUsageDelta();
+    for (const glm::ivec3& seed : MirrorImages(hit.pos, size)) {
+        glm::ivec3 min = size;
+        glm::ivec3 max(0);
+        auto paintVoxel = [&](const glm::ivec3& voxel, float value) {
+            float& current = voxels[VoxelOffset(voxel, size)];
+            VoxelManager::countChange(delta, current, value);
+            current = value;
+            min = glm::min(min, voxel);
+            max = glm::max(max, voxel + 1);
+        };
+        if (fillColor || altAction) {
+            // The connected region of the clicked color, recolored or
+            // erased
+            const float source = voxels[VoxelOffset(seed, size)];
+            const float target = altAction ? 0.0f : paint;
+            if (source <= 0.003f || source == target) {
+                continue;
+            }
+            SpanRaster::FloodFill(
+                size, seed, 0, {1, 2},
+                [&](const glm::ivec3& voxel) {
+                    return voxels[VoxelOffset(voxel, size)] == source &&
+                           voxelManager.isEditable(voxel);
+                },
+                [&](const glm::ivec3& voxel) { paintVoxel(voxel, target); });
+        } else {
+            // A layer of voxels on the connected face of the clicked color;
+            // the normal flips along the axes the image was mirrored on
+            glm::ivec3 normal = hit.normal;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (seed[axis] != hit.pos[axis]) {
+                    normal[axis] = -normal[axis];
+                }
+            }
+            const glm::ivec3 layer = seed + normal;
+            if (paint <= 0.003f || normal == glm::ivec3(0) ||
+                glm::any(glm::lessThan(layer, glm::ivec3(0))) ||
+                glm::any(glm::greaterThanEqual(layer, size))) {
+                continue;
+            }
+            const int spanAxis = normalAxis == 0 ? 1 : 0;
+            const int rowAxis = 3 - normalAxis - spanAxis;
+            SpanRaster::FloodFill(
+                size, layer, spanAxis, {rowAxis},
+                [&](const glm::ivec3& voxel) {
+                    return voxels[VoxelOffset(voxel, size)] <= 0.003f &&
+                           voxels[VoxelOffset(voxel - normal, size)] == face &&
+                           voxelManager.isEditable(voxel);
+                },
+                [&](const glm::ivec3& voxel) { paintVoxel(voxel, paint); });
+        }
+        voxelManager.markDirty(min, max);
+    }
+    voxelManager.applyUsage(delta);
+    return 0;
+}
 
 int ToolBox::usePencil(const HitInfo& hit, VoxelManager& voxelManager,
                        PaletteManager& paletteManager, bool altAction) {
-    if (altAction) {
-        voxelManager.setVoxel(hit.pos.x, hit.pos.y, hit.pos.z, 0.0f);
-    } else {
-        glm::ivec3 placeVoxel = hit.pos;
+    glm::ivec3 target = hit.pos;
+    float value = 0.0f;
+    if (!altAction) {
         if (!hit.edge)
-            placeVoxel += hit.normal;
+            target += hit.normal;
+        value = hit.value;
+    }
 
-        voxelManager.setVoxel(placeVoxel.x, placeVoxel.y, placeVoxel.z,
-                              hit.value);
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    std::vector<float>& voxels = voxelManager.getVoxel();
+    VoxelManager::UsageDelta delta = voxelManager.newUsageDelta();
+    for (const glm::ivec3& voxel : MirrorImages(target, size)) {
+        if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) ||
+            glm::any(glm::greaterThanEqual(voxel, size)) ||
+            !voxelManager.isEditable(voxel)) {
+            continue;
+        }
+        float& current = voxels[VoxelOffset(voxel, size)];
+        VoxelManager::countChange(delta, current, value);
+        current = value;
+        voxelManager.markDirty(voxel, voxel + 1);
     }
+    voxelManager.applyUsage(delta);
     return 0;
 }
 
 int ToolBox::useBrush(const HitInfo& hit, VoxelManager& voxelManager,
                       PaletteManager& paletteManager, bool altAction) {
-    float color =
-        altAction ? -255.0f
-                  : static_cast<float>(
-                        paletteManager.GetCurrentPalette().getSelectedIndex());
-    auto& size = voxelManager.getSize();
-    glm::ivec3 center = hit.pos + hit.normal;
-    glm::ivec3 start = center - glm::ivec3(brushSide / 2 );
-    glm::ivec3 end = center + glm::ivec3(brushSide / 2 + 1);
-
-    // if start or end is out of bounds, clamp them
-    start = glm::clamp(start, glm::ivec3(0), glm::ivec3(size) - glm::ivec3(1));
-    end = glm::clamp(end, glm::ivec3(0), glm::ivec3(size) - glm::ivec3(1));
-    // Calculate length of the brush sides
-    glm::ivec3 brushSides = end - start;
-    std::vector<float> voxels(brushSides.x * brushSides.y * brushSides.z, 0.0f);
-    std::cout << "Brush sides: " << brushSides.x << ", " << brushSides.y << ", "
-              << brushSides.z << ", Start: " << start.x << ", " << start.y
-              << ", " << start.z << ", End: " << end.x << ", " << end.y << ", "
-              << end.z << ", Voxels count:" << voxels.size() << std::endl;
-
-    for (int x = 0; x < brushSides.x; x++) {
-        for (int y = 0; y < brushSides.y; y++) {
-            for (int z = 0; z < brushSides.z; z++) {
-                // Check if inside the shpere with radius brushSide
-                glm::vec3 pos = glm::vec3(start) + glm::vec3(x, y, z);
-                float distance = glm::length(pos - glm::vec3(center));
-                if (distance >= static_cast<float>(brushSide/2.0f)) {
-                    continue; // Skip voxels outside the brush radius
+    const float value = VoxelIndex<uint16_t>::Decode(
+        paletteManager.GetCurrentPalette().getSelectedIndex());
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+
+    // Every mirrored stamp is written on its own and marks only its own
+    // box, so the upload stays as small as the stamps. Painting fills
+    // empty voxels, erasing clears solid ones.
+    std::vector<SpanRaster::Span> spans;
+    for (const glm::ivec3& center :
+         MirrorImages(hit.pos + hit.normal, size)) {
+        spans.clear();
+        SpanRaster::Sphere(center, brushSide, value, spans);
+        glm::ivec3 min, max;
+        if (SpanRaster::Clip(spans, size, min, max)) {
+            SpanRaster::Write(voxelManager, spans, altAction);
+        }
+    }
+    return 0;
+}
+
+int ToolBox::useIsland(const HitInfo& hit, VoxelManager& voxelManager,
+                       PaletteManager& paletteManager, bool altAction) {
+    // Clicks on the grid floor hit no island
+    if (hit.edge) {
+        return -1;
+    }
+    UpdateComponents(voxelManager);
+    uint32_t label = components.getLabel(hit.pos);
+    if (label == 0) {
+        return -1;
+    }
+    if (altAction) {
+        std::vector<uint8_t> remove(components.getComponentCount() + 1, 0);
+        remove[label] = 1;
+        ReplaceComponents(voxelManager, remove, 0.0f);
+        islandSeed = glm::ivec3(-1);
+        islandSize = 0;
+    } else {
+        islandSeed = hit.pos;
+        islandSize = components.getSizes()[label];
+    }
+    return 0;
+}
+
+int ToolBox::useSelect(const HitInfo& hit, VoxelManager& voxelManager,
+                       PaletteManager& paletteManager, bool altAction) {
+    SelectionMask& selection = voxelManager.getSelection();
+    // Shift always takes away from the selection
+    const SelectionMask::Op op =
+        altAction ? SelectionMask::Op::Subtract : selectOp;
+    switch (selectMode) {
+    case SelectMode::Box:
+        if (!hasBoxAnchor) {
+            boxAnchor = hit.pos;
+            hasBoxAnchor = true;
+            return 0;
+        }
+        selection.SelectBox(glm::min(boxAnchor, hit.pos),
+                            glm::max(boxAnchor, hit.pos) + 1, op);
+        hasBoxAnchor = false;
+        break;
+    case SelectMode::Sphere:
+        selection.SelectSphere(glm::vec3(hit.pos) + 0.5f, selectRadius + 0.5f,
+                               op);
+        break;
+    case SelectMode::Color: {
+        if (hit.edge) {
+            return -1;
+        }
+        // hit.value is the palette selection, the clicked color is in the
+        // store
+        const std::vector<float>& voxels = voxelManager.getVoxel();
+        const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+        selection.SelectColor(voxels, voxels[VoxelOffset(hit.pos, size)], op);
+        break;
+    }
+    case SelectMode::Island: {
+        if (hit.edge) {
+            return -1;
+        }
+        UpdateComponents(voxelManager);
+        uint32_t label = components.getLabel(hit.pos);
+        if (label == 0) {
+            return -1;
+        }
+        selection.SelectLabel(components.getLabels(), label, op);
+        break;
+    }
+    }
+    return 0;
+}
+
+glm::ivec3 ToolBox::PasteOrigin(const HitInfo& hit) const {
+    glm::ivec3 anchor = hit.pos;
+    if (!hit.edge) {
+        anchor += hit.normal;
+    }
+    // Centered on the cursor in x and z, standing on the hit face
+    const glm::ivec3& size = clipboard.getSize();
+    return anchor - glm::ivec3(size.x / 2, 0, size.z / 2);
+}
+
+int ToolBox::usePaste(const HitInfo& hit, VoxelManager& voxelManager,
+                      PaletteManager& paletteManager, bool altAction) {
+    if (clipboard.isEmpty()) {
+        return -1;
+    }
+    clipboard.Paste(voxelManager, PasteOrigin(hit));
+    return 0;
+}
+
+glm::ivec3 ToolBox::DragTarget(const HitInfo& hit, bool erase) const {
+    if (erase || hit.edge) {
+        return hit.pos;
+    }
+    return hit.pos + hit.normal;
+}
+
+void ToolBox::UpdateDrag(const glm::ivec3& target,
+                         VoxelManager& voxelManager) {
+    dragSpans.clear();
+    if (selectedTool == 6) {
+        SpanRaster::Line(dragStart, target, dragValue, dragSpans);
+    } else {
+        SpanRaster::Box(dragStart, target, boxHollow, dragValue, dragSpans);
+    }
+    glm::ivec3 min, max;
+    SpanRaster::Clip(dragSpans, glm::ivec3(voxelManager.getSize()), min, max);
+    ShowPreview(dragSpans, dragErase, voxelManager);
+}
+
+void ToolBox::ShowPreview(const std::vector<SpanRaster::Span>& spans,
+                          bool erase, VoxelManager& voxelManager) {
+    // Most moves stay within the same voxel, those upload nothing
+    OverlayVolume& overlay = voxelManager.getOverlay();
+    if (spans == previewSpans && erase == previewErase &&
+        voxelManager.getRevision() == previewRevision &&
+        (overlay.isVisible() || spans.empty())) {
+        return;
+    }
+    previewSpans = spans;
+    previewErase = erase;
+    previewRevision = voxelManager.getRevision();
+    SpanRaster::Preview(voxelManager, spans, erase);
+}
+
+int ToolBox::useLine(const HitInfo& hit, VoxelManager& voxelManager,
+                     PaletteManager& paletteManager, bool altAction) {
+    dragValue = VoxelIndex<uint16_t>::Decode(
+        paletteManager.GetCurrentPalette().getSelectedIndex());
+    dragErase = altAction || dragValue <= 0.003f;
+    dragStart = DragTarget(hit, dragErase);
+    dragging = true;
+    UpdateDrag(dragStart, voxelManager);
+    return 0;
+}
+
+int ToolBox::useBox(const HitInfo& hit, VoxelManager& voxelManager,
+                    PaletteManager& paletteManager, bool altAction) {
+    // Same drag as the line, only the shape differs
+    return useLine(hit, voxelManager, paletteManager, altAction);
+}
+
+int ToolBox::useExtrude(const HitInfo& hit, VoxelManager& voxelManager,
+                        PaletteManager& paletteManager, bool altAction) {
+    if (hit.edge) {
+        return -1;
+    }
+    std::vector<SpanRaster::Span> spans;
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    if (!SpanRaster::Extrude(voxelManager.getVoxel(), size, hit.pos,
+                             hit.normal, extrudeDepth, altAction, spans)) {
+        return -1;
+    }
+    glm::ivec3 min, max;
+    if (SpanRaster::Clip(spans, size, min, max)) {
+        SpanRaster::Write(voxelManager, spans, altAction);
+    }
+    return 0;
+}
+
+void ToolBox::EndDrag(VoxelManager& voxelManager) {
+    if (!dragging) {
+        return;
+    }
+    SpanRaster::Write(voxelManager, dragSpans, dragErase);
+    dragSpans.clear();
+    dragging = false;
+    voxelManager.getOverlay().Hide();
+}
+
+int ToolBox::Copy(VoxelManager& voxelManager) {
+    SelectionMask& selection = voxelManager.getSelection();
+    glm::ivec3 min, max;
+    if (!selection.getBounds(min, max)) {
+        std::cerr << "Nothing selected to copy" << std::endl;
+        return 1;
+    }
+    clipboard.Copy(voxelManager.getVoxel(), glm::ivec3(voxelManager.getSize()),
+                   min, max, &selection);
+    ghostStale = true;
+    return 0;
+}
+
+int ToolBox::Cut(VoxelManager& voxelManager) {
+    if (Copy(voxelManager) != 0) {
+        return 1;
+    }
+    // Clear the copied voxels in one pass and one dirty region
+    SelectionMask& selection = voxelManager.getSelection();
+    glm::ivec3 min, max;
+    selection.getBounds(min, max);
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    std::vector<float>& voxels = voxelManager.getVoxel();
+    Parallel::For(min.z, max.z, [&](uint32_t z) {
+        VoxelManager::UsageDelta delta = voxelManager.newUsageDelta();
+        for (int y = min.y; y < max.y; ++y) {
+            size_t row = (size_t(z) * size.y + y) * size.x;
+            for (int x = min.x; x < max.x; ++x) {
+                if (selection.test(glm::ivec3(x, y, z))) {
+                    VoxelManager::countChange(delta, voxels[row + x], 0.0f);
+                    voxels[row + x] = 0.0f;
                 }
-                // Calculate the index in the voxel array
-                int index = x * brushSides.y * brushSides.z +
-                            y * brushSides.z + z;
-                // std::cout << "Index: " << index << ", Position: " << pos.x
-                //           << ", " << pos.y << ", " << pos.z << std::endl;
-                voxels[index] = color / 255.0f;
             }
         }
+        voxelManager.applyUsage(delta);
+    });
+    voxelManager.markDirty(min, max);
+    return 0;
+}
+
+void ToolBox::BeginPaste(VoxelManager& voxelManager) {
+    if (clipboard.isEmpty()) {
+        return;
     }
-    // Set the voxels in the voxel manager
-    voxelManager.setVoxelAABB(std::move(voxels), start, end);
+    selectedTool = 5;
+}
 
-    return 0;
+void ToolBox::Preview(const std::optional<HitInfo>& hit,
+                      VoxelManager& voxelManager,
+                      PaletteManager& paletteManager, bool altAction) {
+    OverlayVolume& overlay = voxelManager.getOverlay();
+    if (dragging) {
+        // Off the volume the shape stays where it was last
+        if (hit.has_value()) {
+            UpdateDrag(DragTarget(hit.value(), dragErase), voxelManager);
+        }
+        return;
+    }
+    if (!hasPreview() || !hit.has_value()) {
+        overlay.Hide();
+        return;
+    }
+    if (selectedTool == 5) {
+        PreviewPaste(hit.value(), voxelManager);
+        return;
+    }
+
+    // The other tools show what a click would write, rasterized like the
+    // click itself but only into the overlay
+    const HitInfo& at = hit.value();
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    const float value = VoxelIndex<uint16_t>::Decode(
+        paletteManager.GetCurrentPalette().getSelectedIndex());
+    std::vector<SpanRaster::Span> spans;
+    bool erase = altAction;
+    switch (selectedTool) {
+    case 2: // Brush
+        for (const glm::ivec3& center :
+             MirrorImages(at.pos + at.normal, size)) {
+            SpanRaster::Sphere(center, brushSide, value, spans);
+        }
+        break;
+    case 6: // Line
+    case 7: // Box
+        // The voxel a drag would start at
+        erase = altAction || value <= 0.003f;
+        spans.push_back({DragTarget(at, erase), 1, value});
+        break;
+    case 8: // Extrude
+        if (at.edge) {
+            break;
+        }
+        // The flood covers the whole face, only redo it when it can differ
+        if (at.pos != extrudePos || at.normal != extrudeNormal ||
+            voxelManager.getRevision() != extrudeRevision ||
+            extrudeDepth != extrudeLayers || altAction != extrudeErase) {
+            extrudePos = at.pos;
+            extrudeNormal = at.normal;
+            extrudeRevision = voxelManager.getRevision();
+            extrudeLayers = extrudeDepth;
+            extrudeErase = altAction;
+            extrudeSpans.clear();
+            SpanRaster::Extrude(voxelManager.getVoxel(), size, at.pos,
+                                at.normal, extrudeDepth, altAction,
+                                extrudeSpans);
+            glm::ivec3 min, max;
+            SpanRaster::Clip(extrudeSpans, size, min, max);
+        }
+        ShowPreview(extrudeSpans, erase, voxelManager);
+        return;
+    }
+    glm::ivec3 min, max;
+    SpanRaster::Clip(spans, size, min, max);
+    ShowPreview(spans, erase, voxelManager);
+}
+
+void ToolBox::PreviewPaste(const HitInfo& hit, VoxelManager& voxelManager) {
+    OverlayVolume& overlay = voxelManager.getOverlay();
+    if (clipboard.isEmpty()) {
+        overlay.Hide();
+        return;
+    }
+    // The clipboard is only decoded when it changes, moving the ghost
+    // around is just a new origin
+    if (ghostStale || !overlay.isVisible()) {
+        if (overlay.showsVoxels(clipboard.getSize())) {
+            std::vector<uint16_t> values;
+            clipboard.Decode(values);
+            overlay.Set(PasteOrigin(hit), clipboard.getSize(), values);
+        } else {
+            overlay.SetOutline(PasteOrigin(hit), clipboard.getSize());
+        }
+        ghostStale = false;
+    } else {
+        overlay.setOrigin(PasteOrigin(hit));
+    }
+}
+
+void ToolBox::UpdateComponents(VoxelManager& voxelManager) {
+    components.Label(voxelManager.getVoxel(),
+                     glm::ivec3(voxelManager.getSize()),
+                     voxelManager.getRevision());
+}
+
+void ToolBox::ReplaceComponents(VoxelManager& voxelManager,
+                                const std::vector<uint8_t>& remove,
+                                float value) {
+    const glm::ivec3 size = glm::ivec3(voxelManager.getSize());
+    const size_t sliceStride = size_t(size.x) * size.y;
+    const std::vector<uint32_t>& labels = components.getLabels();
+    std::vector<float>& voxels = voxelManager.getVoxel();
+    if (labels.size() != voxels.size()) {
+        return;
+    }
+
+    // Each slice tracks the box it touched, merged afterwards
+    std::vector<glm::ivec3> sliceMin(size.z, size);
+    std::vector<glm::ivec3> sliceMax(size.z, glm::ivec3(0));
+    Parallel::For(0, size.z, [&](uint32_t z) {
+        VoxelManager::UsageDelta delta = voxelManager.newUsageDelta();
+        for (int y = 0; y < size.y; ++y) {
+            size_t row = z * sliceStride + size_t(y) * size.x;
+            for (int x = 0; x < size.x; ++x) {
+                glm::ivec3 voxel(x, y, z);
+                if (!remove[labels[row + x]] || voxels[row + x] == value ||
+                    !voxelManager.isEditable(voxel)) {
+                    continue;
+                }
+                VoxelManager::countChange(delta, voxels[row + x], value);
+                voxels[row + x] = value;
+                sliceMin[z] = glm::min(sliceMin[z], voxel);
+                sliceMax[z] = glm::max(sliceMax[z], voxel + 1);
+            }
+        }
+        voxelManager.applyUsage(delta);
+    });
+
+    glm::ivec3 min = size;
+    glm::ivec3 max(0);
+    for (int z = 0; z < size.z; ++z) {
+        min = glm::min(min, sliceMin[z]);
+        max = glm::max(max, sliceMax[z]);
+    }
+    voxelManager.markDirty(min, max);
 }
 
-void ToolBox::RenderWindow(bool* open) {
+void ToolBox::RenderWindow(bool* open, VoxelManager& voxelManager,
+                           PaletteManager& paletteManager) {
     if (!*open) {
         return;
     }
@@ -101,11 +562,29 @@ void ToolBox::RenderWindow(bool* open) {
     for (size_t i = 0; i < toolNames.size(); ++i) {
         if (ImGui::RadioButton(toolNames[i].c_str(), selectedTool == i)) {
             selectedTool = i; // Update selected tool
+            dragging = false;
+            voxelManager.getOverlay().Hide();
         }
     }
 
     ImGui::Separator();
     ImGui::Text("Tool Settings:");
+    if (hasPreview()) {
+        OverlayVolume& overlay = voxelManager.getOverlay();
+        if (ImGui::Checkbox("Outline Preview", &overlay.getOutlineOnly())) {
+            overlay.Hide(); // shown again in the new style on the next move
+        }
+    }
+    if (selectedTool <= 2) {
+        // Planes through the volume center, combined they mirror to 8
+        ImGui::Text("Mirror:");
+        ImGui::SameLine();
+        ImGui::CheckboxFlags("X##Mirror", &mirrorAxes, 1);
+        ImGui::SameLine();
+        ImGui::CheckboxFlags("Y##Mirror", &mirrorAxes, 2);
+        ImGui::SameLine();
+        ImGui::CheckboxFlags("Z##Mirror", &mirrorAxes, 4);
+    }
     switch (selectedTool) {
     // case 0: // Pencil
     //     break;
@@ -122,9 +601,270 @@ void ToolBox::RenderWindow(bool* open) {
             brushSide = brushSize * 2 + 1;
         }
         break;
+    case 3: { // Island
+        ImGui::TextWrapped("Click selects an island, Shift+Click deletes it.");
+        UpdateComponents(voxelManager);
+        const uint32_t count = components.getComponentCount();
+        ImGui::Text("Islands: %u", count);
+
+        const uint32_t label = components.getLabel(islandSeed);
+        if (label == 0) {
+            ImGui::Text("Selected: none");
+        } else {
+            islandSize = components.getSizes()[label];
+            ImGui::Text("Selected: %u voxels", islandSize);
+            if (ImGui::Button("Delete Island")) {
+                std::vector<uint8_t> remove(count + 1, 0);
+                remove[label] = 1;
+                ReplaceComponents(voxelManager, remove, 0.0f);
+                islandSeed = glm::ivec3(-1);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Paint Island")) {
+                std::vector<uint8_t> remove(count + 1, 0);
+                remove[label] = 1;
+                const float color = VoxelIndex<uint16_t>::Decode(
+                    paletteManager.GetCurrentPalette().getSelectedIndex());
+                ReplaceComponents(voxelManager, remove, color);
+            }
+        }
+
+        ImGui::Separator();
+        ImGui::SliderInt("Min Size", &minComponentSize, 1, 1024);
+        if (ImGui::Button("Delete Small Islands")) {
+            std::vector<uint8_t> remove(count + 1, 0);
+            for (uint32_t i = 1; i <= count; ++i) {
+                remove[i] = components.getSizes()[i] <
+                            static_cast<uint32_t>(minComponentSize);
+            }
+            ReplaceComponents(voxelManager, remove, 0.0f);
+        }
+        if (ImGui::Button("Keep Largest Island") && count > 1) {
+            std::vector<uint8_t> remove(count + 1, 1);
+            remove[0] = 0;
+            remove[components.getLargest()] = 0;
+            ReplaceComponents(voxelManager, remove, 0.0f);
+        }
+        break;
+    }
+    case 4: { // Select
+        SelectionMask& selection = voxelManager.getSelection();
+        const std::array<const char*, 4> modes = {"Box", "Sphere", "Color",
+                                                  "Island"};
+        for (size_t i = 0; i < modes.size(); ++i) {
+            SelectMode mode = static_cast<SelectMode>(i);
+            if (ImGui::RadioButton(modes[i], selectMode == mode)) {
+                selectMode = mode;
+                hasBoxAnchor = false;
+            }
+            if (i + 1 < modes.size()) {
+                ImGui::SameLine();
+            }
+        }
+        const std::array<const char*, 4> ops = {"Replace", "Add", "Subtract",
+                                                "Intersect"};
+        for (size_t i = 0; i < ops.size(); ++i) {
+            SelectionMask::Op op = static_cast<SelectionMask::Op>(i);
+            if (ImGui::RadioButton(ops[i], selectOp == op)) {
+                selectOp = op;
+            }
+            if (i + 1 < ops.size()) {
+                ImGui::SameLine();
+            }
+        }
+        if (selectMode == SelectMode::Box) {
+            ImGui::Text(hasBoxAnchor ? "Click the opposite corner"
+                                     : "Click the first corner");
+        } else if (selectMode == SelectMode::Sphere) {
+            ImGui::SliderInt("Radius", &selectRadius, 0, 64);
+        }
+        ImGui::TextWrapped("Shift+Click subtracts from the selection.");
+
+        ImGui::Separator();
+        ImGui::Text("Selected: %llu voxels",
+                    static_cast<unsigned long long>(selection.getCount()));
+        if (ImGui::Button("All")) {
+            selection.SelectAll();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("None")) {
+            selection.Clear();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Invert")) {
+            selection.Invert();
+        }
+        ImGui::SliderInt("Steps", &selectSteps, 1, 16);
+        if (ImGui::Button("Grow")) {
+            selection.Grow(selectSteps);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Shrink")) {
+            selection.Shrink(selectSteps);
+        }
+        ImGui::Checkbox("Edit Selection Only",
+                        &voxelManager.getEditSelectionOnly());
+        break;
+    }
+    case 5: // Paste
+        ImGui::TextWrapped("Ctrl+C / Ctrl+X copy or cut the selection, "
+                           "click pastes where the ghost is shown.");
+        if (ImGui::Button("Copy")) {
+            Copy(voxelManager);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Cut")) {
+            Cut(voxelManager);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear")) {
+            clipboard.Clear();
+            voxelManager.getOverlay().Hide();
+        }
+        if (clipboard.isEmpty()) {
+            ImGui::Text("Clipboard: empty");
+        } else {
+            const glm::ivec3& size = clipboard.getSize();
+            ImGui::Text("Clipboard: %dx%dx%d, %llu voxels", size.x, size.y,
+                        size.z,
+                        static_cast<unsigned long long>(
+                            clipboard.getVoxelCount()));
+            ImGui::Text("Stored in %.1f KB",
+                        clipboard.getByteSize() / 1024.0f);
+        }
+        break;
+    case 6: // Line
+        ImGui::TextWrapped("Drag to draw a line, Shift+Drag erases.");
+        break;
+    case 7: // Box
+        ImGui::Checkbox("Hollow", &boxHollow);
+        ImGui::TextWrapped("Drag between two corners, Shift+Drag erases.");
+        break;
+    case 8: // Extrude
+        ImGui::SliderInt("Depth", &extrudeDepth, 1, 64);
+        ImGui::TextWrapped("Click pulls the connected face out, Shift+Click "
+                           "pushes it in.");
+        break;
     default: // No settings for tool
         break;
     }
 
+    ImGui::Separator();
+    RenderTransform(voxelManager);
+    RenderFilters(voxelManager);
+
     ImGui::End();
 }
+
+void ToolBox::RenderTransform(VoxelManager& voxelManager) {
+    if (!ImGui::CollapsingHeader("Transform")) {
+        return;
+    }
+    const bool hasSelection = !voxelManager.getSelection().isEmpty();
+    if (!hasSelection) {
+        transformSelection = false;
+    }
+    ImGui::BeginDisabled(!hasSelection);
+    ImGui::Checkbox("Selection Only", &transformSelection);
+    ImGui::EndDisabled();
+
+    std::optional<VolumeTransform::AxisMap> map;
+    const char* axes[] = {"X", "Y", "Z"};
+    for (int axis = 0; axis < 3; ++axis) {
+        ImGui::PushID(axis);
+        ImGui::Text("%s:", axes[axis]);
+        ImGui::SameLine();
+        if (ImGui::Button("Flip")) {
+            map = VolumeTransform::Flip(axis);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Rotate +90")) {
+            map = VolumeTransform::Rotate(axis);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Rotate -90")) {
+            map = VolumeTransform::Rotate(axis, true);
+        }
+        ImGui::PopID();
+    }
+    if (ImGui::Button("Swap XY")) {
+        map = VolumeTransform::Swap(0, 1);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Swap YZ")) {
+        map = VolumeTransform::Swap(1, 2);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Swap XZ")) {
+        map = VolumeTransform::Swap(0, 2);
+    }
+
+    if (map.has_value()) {
+        if (transformSelection) {
+            voxelManager.ReorientSelection(map.value());
+        } else {
+            voxelManager.Reorient(map.value());
+        }
+    }
+
+    ImGui::Separator();
+    ImGui::InputFloat3("Scale", &resampleScale[0]);
+    if (ImGui::RadioButton("Nearest",
+                           resampleFilter == ResampleFilter::Nearest)) {
+        resampleFilter = ResampleFilter::Nearest;
+    }
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Majority", resampleFilter == ResampleFilter::Mode)) {
+        resampleFilter = ResampleFilter::Mode;
+    }
+    const glm::vec4 size = voxelManager.getSize();
+    const glm::ivec3 newSize = glm::max(
+        glm::ivec3(glm::round(glm::vec3(size) * resampleScale)),
+        glm::ivec3(1));
+    ImGui::Text("%dx%dx%d -> %dx%dx%d", int(size.x), int(size.y),
+                int(size.z), newSize.x, newSize.y, newSize.z);
+    if (ImGui::Button("Resample")) {
+        voxelManager.Resample(resampleScale, resampleFilter);
+    }
+}
+
+void ToolBox::RenderFilters(VoxelManager& voxelManager) {
+    if (!ImGui::CollapsingHeader("Filters")) {
+        return;
+    }
+    static const char* opNames[] = {"Dilate", "Erode",  "Open",
+                                    "Close",  "Smooth", "Hollow"};
+    int opIndex = static_cast<int>(filterOp);
+    if (ImGui::Combo("Filter", &opIndex, opNames, 6)) {
+        filterOp = static_cast<Morphology::Op>(opIndex);
+    }
+    const char* radiusLabel = "Radius";
+    if (filterOp == Morphology::Op::Smooth) {
+        radiusLabel = "Iterations";
+    } else if (filterOp == Morphology::Op::Hollow) {
+        radiusLabel = "Thickness";
+    }
+    ImGui::SliderInt(radiusLabel, &filterRadius, 1, 16);
+
+    const SelectionMask& selection = voxelManager.getSelection();
+    const bool hasSelection = !selection.isEmpty();
+    if (!hasSelection) {
+        filterSelection = false;
+    }
+    ImGui::BeginDisabled(!hasSelection);
+    ImGui::Checkbox("Selection Only##Filters", &filterSelection);
+    ImGui::EndDisabled();
+
+    if (ImGui::Button("Apply")) {
+        const bool limit =
+            hasSelection &&
+            (filterSelection || voxelManager.getEditSelectionOnly());
+        filterChanged = static_cast<long long>(
+            morphology.Apply(voxelManager, filterOp, filterRadius,
+                             limit ? &selection : nullptr));
+    }
+    if (filterChanged >= 0) {
+        ImGui::SameLine();
+        ImGui::Text("%lld voxels changed", filterChanged);
+    }
+}
@@ -0,0 +1,109 @@
+#include "UploadScheduler.hpp"
+#include <iostream>
+
+UploadScheduler::UploadScheduler() {}
+
+UploadScheduler::~UploadScheduler() {}
+
+void UploadScheduler::Init(uint32_t ringSize) {
+    ring.resize(ringSize);
+    head = 0;
+}
+
+void UploadScheduler::Destroy() {
+    // bgfx may still hold references into the ring, let it consume them
+    for (int i = 0; i < 3 && !inFlight.empty(); ++i) {
+        bgfx::frame();
+        Reclaim();
+    }
+    if (!inFlight.empty()) {
+        std::cerr << "Upload ring destroyed with " << inFlight.size()
+                  << " slices in flight" << std::endl;
+    }
+    inFlight.clear();
+    ring.clear();
+    ring.shrink_to_fit();
+}
+
+void UploadScheduler::Release(void* ptr, void* userData) {
+    static_cast<std::atomic<uint32_t>*>(userData)->fetch_sub(
+        1, std::memory_order_release);
+}
+
+void UploadScheduler::Reclaim() {
+    while (!inFlight.empty() &&
+           inFlight.front().pending.load(std::memory_order_acquire) == 0) {
+        inFlight.pop_front();
+    }
+    if (inFlight.empty()) {
+        head = 0;
+    }
+}
+
+void UploadScheduler::BeginFrame() {
+    frameBytes = 0;
+    Reclaim();
+}
+
+const bgfx::Memory* UploadScheduler::Allocate(uint32_t size) {
+    const bgfx::Memory* mem = nullptr;
+    return Allocate({size}, &mem) ? mem : nullptr;
+}
+
+bool UploadScheduler::Allocate(std::initializer_list<uint32_t> sizes,
+                               const bgfx::Memory** out) {
+    uint32_t size = 0;
+    for (uint32_t part : sizes) {
+        size += part;
+    }
+    // Always let one slice through, so a budget smaller than a slice still
+    // makes progress
+    if (frameBytes > 0 && frameBytes + size > frameBudget) {
+        return false;
+    }
+    if (size > ring.size()) {
+        frameBytes += size;
+        totalBytes += size;
+        for (uint32_t part : sizes) {
+            *out++ = bgfx::alloc(part);
+        }
+        return true;
+    }
+
+    Reclaim();
+    uint32_t offset = 0;
+    if (!inFlight.empty()) {
+        const uint32_t tail = inFlight.front().offset;
+        if (head == tail) {
+            return false; // ring is full
+        } else if (head > tail) {
+            if (ring.size() - head >= size) {
+                offset = head;
+            } else if (size <= tail) {
+                offset = 0; // wrap around, the end of the ring stays unused
+            } else {
+                return false;
+            }
+        } else if (tail - head >= size) {
+            offset = head;
+        } else {
+            return false;
+        }
+    }
+
+    // One ring allocation, freed once bgfx released every slice of it
+    Allocation& allocation = inFlight.emplace_back();
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.pending.store(uint32_t(sizes.size()), std::memory_order_relaxed);
+    head = offset + size;
+
+    frameBytes += size;
+    totalBytes += size;
+    for (uint32_t part : sizes) {
+        *out++ = bgfx::makeRef(ring.data() + offset, part,
+                               &UploadScheduler::Release, &allocation.pending);
+        offset += part;
+    }
+    return true;
+}
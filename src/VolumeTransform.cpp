@@ -0,0 +1,34 @@
+#include "VolumeTransform.hpp"
+
+namespace VolumeTransform {
+
+AxisMap Flip(int axis) {
+    AxisMap map;
+    map.flip[axis] = true;
+    return map;
+}
+
+AxisMap Rotate(int axis, bool clockwise) {
+    // Counterclockwise takes u to v and v to -u
+    const int u = (axis + 1) % 3;
+    const int v = (axis + 2) % 3;
+    AxisMap map;
+    map.source[u] = v;
+    map.source[v] = u;
+    map.flip[clockwise ? v : u] = true;
+    return map;
+}
+
+AxisMap Swap(int a, int b) {
+    AxisMap map;
+    map.source[a] = b;
+    map.source[b] = a;
+    return map;
+}
+
+glm::ivec3 MappedSize(const glm::ivec3& size, const AxisMap& map) {
+    return glm::ivec3(size[map.source.x], size[map.source.y],
+                      size[map.source.z]);
+}
+
+} // namespace VolumeTransform
@@ -1,10 +1,14 @@
 #include "VoxelManager.hpp"
+#include "Parallel.hpp"
 #include "bgfx/bgfx.h"
 #include "glm/common.hpp"
 #include "glm/fwd.hpp"
 #include "glm/geometric.hpp"
 #include "glm/vector_relational.hpp"
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
 #include <glm/glm.hpp>
@@ -40,44 +44,48 @@ void VoxelManager::Init(uint32_t width, uint32_t height, uint32_t depth,
         }
     }
 
-    const bgfx::Memory* mem =
-        bgfx::makeRef(voxelData.data(), width * height * depth * sizeof(float));
-    if (!mem) {
-        std::cerr << "Failed to allocate memory for voxel texture."
-                  << std::endl;
-        return;
-    }
-
-    textureHandle = bgfx::createTexture3D(
-        width, height, depth, false, bgfx::TextureFormat::R32F, 0, nullptr);
-    bgfx::updateTexture3D(textureHandle, 0, 0, 0, 0, width, height, depth, mem);
     s_voxelTexture =
         bgfx::createUniform("s_voxelTexture", bgfx::UniformType::Sampler);
+
+    uploads.Init();
+    SyncIndexFormat();
+    atlas.Init();
+    distanceField.Init();
+    overlay.Init();
+    occlusion.Build(voxelData, glm::ivec3(width, height, depth));
+    distanceField.Build(voxelData, glm::ivec3(width, height, depth));
+    atlas.Build(voxelData, glm::ivec3(width, height, depth));
+    mipChain.Init();
+    mipChain.Build(voxelData, glm::ivec3(width, height, depth));
+    selection.Resize(glm::ivec3(width, height, depth));
+    CountUsage();
 }
 
 void VoxelManager::Destroy() {
+    uploads.Destroy();
+    mipChain.Destroy();
+    distanceField.Destroy();
+    overlay.Destroy();
+    atlas.Destroy();
     if (s_voxelTexture.idx != bgfx::kInvalidHandle) {
         bgfx::destroy(s_voxelTexture);
         s_voxelTexture.idx = bgfx::kInvalidHandle;
     }
-    if (textureHandle.idx != bgfx::kInvalidHandle) {
-        bgfx::destroy(textureHandle);
-        textureHandle.idx = bgfx::kInvalidHandle;
-    }
 }
 
 void VoxelManager::setVoxel(uint32_t x, uint32_t y, uint32_t z, float value) {
     if (x >= width || y >= height || z >= depth) {
         return; // Out of bounds
     }
+    if (!isEditable(glm::ivec3(x, y, z))) {
+        return;
+    }
     int index = z * width * height + y * width + x;
+    countChange(usage, voxelData[index], value);
     voxelData[index] = value;
 
-    float voxColor = static_cast<float>(value);
-    const bgfx::Memory* updateMem = bgfx::copy(&voxColor, sizeof(voxColor));
-
-    // Update just the one voxel in the 3D texture
-    bgfx::updateTexture3D(textureHandle, 0, x, y, z, 1, 1, 1, updateMem);
+    // Uploaded together with the other edits of this frame in Update()
+    markDirty(glm::ivec3(x, y, z), glm::ivec3(x + 1, y + 1, z + 1));
 }
 
 void VoxelManager::setVoxelAABB(std::vector<float> data,
@@ -101,12 +109,17 @@ void VoxelManager::setVoxelAABB(std::vector<float> data,
                     std::cerr << "Index out of bounds: " << index << std::endl;
                     continue; // Out of bounds
                 }
+                if (!isEditable(glm::ivec3(x, y, z))) {
+                    continue;
+                }
                 uint32_t newVoxelIndex =
                     (z - aabbMin.z) * (aabbMax.y - aabbMin.y) *
                         (aabbMax.x - aabbMin.x) +
                     (y - aabbMin.y) * (aabbMax.x - aabbMin.x) + (x - aabbMin.x);
+                float before = voxelData[index];
                 if (voxelData[index] < 0.003f && voxelData[index] > -0.003f) {
-                    voxelData[index] = data[newVoxelIndex];
+                    // Erasing an empty voxel leaves it empty
+                    voxelData[index] = std::max(data[newVoxelIndex], 0.0f);
                     // std::cout << "Setting voxel at (" << x << ", " << y << ", "
                     //           << z << ") to " << data[newVoxelIndex]
                     //           << std::endl;
@@ -115,10 +128,7 @@ void VoxelManager::setVoxelAABB(std::vector<float> data,
                     // If the color is -1.0f, remove the voxel
                     voxelData[index] = 0.0f;
                 }
-                if (voxelData[index] > 0.003f){
-                    // update data with voxelData content
-                    data[newVoxelIndex] = voxelData[index];
-                }
+                countChange(usage, before, voxelData[index]);
             }
         }
     }
@@ -133,16 +143,80 @@ void VoxelManager::setVoxelAABB(std::vector<float> data,
         return; // Invalid dimensions
     }
 
-    // Update the 3D texture with the new cutout data
-    const bgfx::Memory* mem =
-        bgfx::makeRef(data.data(), data.size() * sizeof(float));
-    if (!mem) {
-        std::cerr << "Failed to allocate memory for voxel texture update."
-                  << std::endl;
+    markDirty(aabbMin, aabbMax);
+}
+
+void VoxelManager::markDirty(const glm::ivec3& min, const glm::ivec3& max) {
+    glm::ivec3 size(width, height, depth);
+    glm::ivec3 clampedMin = glm::clamp(min, glm::ivec3(0), size);
+    glm::ivec3 clampedMax = glm::clamp(max, clampedMin, size);
+    if (glm::any(glm::greaterThanEqual(clampedMin, clampedMax))) {
         return;
     }
-    bgfx::updateTexture3D(textureHandle, 0, aabbMin.x, aabbMin.y, aabbMin.z, w,
-                          h, d, mem);
+    revision++;
+    // A merged box can reach further ones, so merging repeats until the
+    // new box touches none of the others
+    for (size_t i = 0; i < dirtyRegions.size();) {
+        const auto& [regionMin, regionMax] = dirtyRegions[i];
+        if (glm::any(glm::greaterThan(clampedMin, regionMax)) ||
+            glm::any(glm::greaterThan(regionMin, clampedMax))) {
+            ++i;
+            continue;
+        }
+        clampedMin = glm::min(clampedMin, regionMin);
+        clampedMax = glm::max(clampedMax, regionMax);
+        dirtyRegions.erase(dirtyRegions.begin() + i);
+        i = 0;
+    }
+    dirtyRegions.emplace_back(clampedMin, clampedMax);
+    if (dirtyRegions.size() > maxDirtyRegions) {
+        for (const auto& [regionMin, regionMax] : dirtyRegions) {
+            clampedMin = glm::min(clampedMin, regionMin);
+            clampedMax = glm::max(clampedMax, regionMax);
+        }
+        dirtyRegions.assign(1, {clampedMin, clampedMax});
+    }
+}
+
+void VoxelManager::setViewer(const glm::vec3& worldPos, float voxelScale) {
+    glm::vec3 gridSize(width, height, depth);
+    glm::vec3 gridMin =
+        glm::vec3(-1.0f, 0.0f, -1.0f) * gridSize * voxelScale / 16.0f;
+    atlas.setViewer((worldPos - gridMin) / (voxelScale * 0.125f));
+}
+
+void VoxelManager::Update() {
+    uploads.BeginFrame();
+    // Palette edits that moved indices, uploaded with this frame's edits.
+    // They are applied in the format the indices were written in, before
+    // a palette that crossed 256 colors switches it.
+    PaletteRemap remap;
+    if (paletteManager && paletteManager->TakeRemap(remap)) {
+        Remap(remap);
+    }
+    // A palette that outgrew 8-bit indices needs the 16-bit textures
+    if (SyncIndexFormat()) {
+        Rebuild();
+    }
+    for (const auto& [dirtyMin, dirtyMax] : dirtyRegions) {
+        occlusion.Update(voxelData, dirtyMin, dirtyMax);
+        distanceField.Update(voxelData, dirtyMin, dirtyMax);
+        // Re-uploads only the bricks touched by this frame's edits, grown
+        // by the occlusion radius since their neighbors darken too
+        glm::ivec3 size(width, height, depth);
+        atlas.Update(voxelData,
+                     glm::max(dirtyMin - AmbientOcclusion::radius,
+                              glm::ivec3(0)),
+                     glm::min(dirtyMax + AmbientOcclusion::radius, size));
+        mipChain.Update(voxelData, dirtyMin, dirtyMax);
+    }
+    dirtyRegions.clear();
+    atlas.UpdateResidency();
+
+    // The LOD chain goes first, it stands in for bricks still streaming
+    mipChain.Flush(uploads);
+    atlas.Flush(voxelData, occlusion.getValues(), uploads);
+    distanceField.Flush(uploads);
 }
 
 uint16_t VoxelManager::getVoxel(uint32_t x, uint32_t y, uint32_t z) const {
@@ -150,35 +224,61 @@ uint16_t VoxelManager::getVoxel(uint32_t x, uint32_t y, uint32_t z) const {
         return 0; // Out of bounds
     }
     int index = z * width * height + y * width + x;
-    return 0; // FIXME: Return the actual voxel value
+    return VoxelIndex<uint16_t>::Encode(voxelData[index]);
 }
 
 void VoxelManager::newVoxelData(std::vector<uint8_t>& newVoxelData, uint32_t w,
                                 uint32_t h, uint32_t d) {
-    if (newVoxelData.size() != w * h * d) {
+    LoadIndices(newVoxelData, w, h, d);
+}
+
+void VoxelManager::newVoxelData(std::vector<uint16_t>& newVoxelData,
+                                uint32_t w, uint32_t h, uint32_t d) {
+    LoadIndices(newVoxelData, w, h, d);
+}
+
+void VoxelManager::newVoxelData(std::vector<float>&& newVoxelData, uint32_t w,
+                                uint32_t h, uint32_t d) {
+    if (newVoxelData.size() != size_t(w) * h * d) {
+        std::cerr << "New voxel data size does not match specified dimensions."
+                  << std::endl;
+        return;
+    }
+    voxelData = std::move(newVoxelData);
+    Rebuild();
+}
+
+template <typename T>
+void VoxelManager::LoadIndices(const std::vector<T>& indices, uint32_t w,
+                               uint32_t h, uint32_t d) {
+    if (indices.size() != size_t(w) * h * d) {
         std::cerr << "New voxel data size does not match specified dimensions."
                   << std::endl;
         return; // Size mismatch
     }
     // Resize the voxel data vector to match the new dimensions
     voxelData.clear();
-    voxelData.resize(w * h * d, 0.0f);
+    voxelData.resize(indices.size(), 0.0f);
 
-    // Convert uint8_t voxel data to float (0.0f - 1.0f)
-    for (size_t i = 0; i < newVoxelData.size(); ++i) {
-        voxelData[i] = static_cast<float>(newVoxelData[i]) / 255.0f;
+    for (size_t i = 0; i < indices.size(); ++i) {
+        voxelData[i] = VoxelIndex<T>::Decode(indices[i]);
     }
+    Rebuild();
+}
 
-    // Update the texture
-    if (textureHandle.idx != bgfx::kInvalidHandle) {
-        bgfx::destroy(textureHandle); // Destroy old texture if it exists
+bool VoxelManager::SyncIndexFormat() {
+    if (!paletteManager) {
+        return false;
+    }
+    IndexFormat format = IndexFormatFor(
+        paletteManager->GetCurrentPalette().getColors().size());
+    if (format == indexFormat) {
+        return false;
     }
-    textureHandle =
-        bgfx::createTexture3D(w, h, d, false, bgfx::TextureFormat::R32F,
-                              BGFX_TEXTURE_COMPUTE_WRITE, nullptr);
-    const bgfx::Memory* mem =
-        bgfx::makeRef(voxelData.data(), voxelData.size() * sizeof(float));
-    bgfx::updateTexture3D(textureHandle, 0, 0, 0, 0, w, h, d, mem);
+    indexFormat = format;
+    atlas.setIndexFormat(format);
+    mipChain.setIndexFormat(format);
+    return true;
 }
 
 void VoxelManager::Resize(uint32_t newWidth, uint32_t newHeight,
@@ -201,20 +301,278 @@ void VoxelManager::Resize(uint32_t newWidth, uint32_t newHeight,
     }
     voxelData = std::move(newVoxelData);
 
-    const bgfx::Memory* newMem = bgfx::makeRef(
-        voxelData.data(), newWidth * newHeight * newDepth * sizeof(float));
-
-    // Destroy the old texture and update the handle
-    bgfx::destroy(textureHandle);
-    textureHandle = bgfx::createTexture3D(newWidth, newHeight, newDepth, false,
-                                          bgfx::TextureFormat::R32F,
-                                          BGFX_TEXTURE_COMPUTE_WRITE, nullptr);
-    bgfx::updateTexture3D(textureHandle, 0, 0, 0, 0, newWidth, newHeight,
-                          newDepth, newMem);
-
     width = newWidth;
     height = newHeight;
     depth = newDepth;
+    Rebuild();
+}
+
+void VoxelManager::applyUsage(const UsageDelta& delta) {
+    // Both are sized by the index format, 65536 slots for 16 bit palettes
+    const size_t count = std::min(delta.size(), usage.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (delta[i] != 0) {
+            std::atomic_ref<uint64_t>(usage[i]).fetch_add(
+                uint64_t(delta[i]), std::memory_order_relaxed);
+        }
+    }
+}
+
+void VoxelManager::CountUsage() {
+    // Only for whole new volumes, edits keep the counts up to date
+    usage.assign(IndexCount(indexFormat), 0);
+    const size_t sliceStride = size_t(width) * height;
+    Parallel::For(0, depth, [&](uint32_t z) {
+        UsageDelta counts = newUsageDelta();
+        const float* slice = &voxelData[z * sliceStride];
+        for (size_t i = 0; i < sliceStride; ++i) {
+            counts[usageSlot(counts, slice[i])]++;
+        }
+        applyUsage(counts);
+    });
+}
+
+void VoxelManager::Rebuild() {
+    SyncIndexFormat();
+    CountUsage();
+    revision++;
+    dirtyRegions.clear();
+    glm::ivec3 size(width, height, depth);
+    occlusion.Build(voxelData, size);
+    distanceField.Build(voxelData, size);
+    atlas.Build(voxelData, size);
+    mipChain.Build(voxelData, size);
+    selection.Resize(size);
+}
+
+void VoxelManager::Reorient(const VolumeTransform::AxisMap& map) {
+    glm::ivec3 size(width, height, depth);
+    std::vector<float> reoriented;
+    VolumeTransform::Remap(voxelData, size, reoriented, map);
+    voxelData = std::move(reoriented);
+
+    glm::ivec3 newSize = VolumeTransform::MappedSize(size, map);
+    width = newSize.x;
+    height = newSize.y;
+    depth = newSize.z;
+    Rebuild();
+}
+
+int VoxelManager::ReorientSelection(const VolumeTransform::AxisMap& map) {
+    glm::ivec3 min, max;
+    if (!selection.getBounds(min, max)) {
+        return 1;
+    }
+    const glm::ivec3 size(width, height, depth);
+    const glm::ivec3 extent = max - min;
+
+    // Lift the selected voxels out, together with their selection bits
+    std::vector<float> region(size_t(extent.x) * extent.y * extent.z, 0.0f);
+    std::vector<uint8_t> regionMask(region.size(), 0);
+    Parallel::For(0, extent.z, [&](uint32_t z) {
+        UsageDelta delta = newUsageDelta();
+        for (int y = 0; y < extent.y; ++y) {
+            size_t row = (size_t(min.z + z) * size.y + min.y + y) * size.x;
+            size_t local = (size_t(z) * extent.y + y) * extent.x;
+            for (int x = 0; x < extent.x; ++x) {
+                if (selection.test(min + glm::ivec3(x, y, z))) {
+                    region[local + x] = voxelData[row + min.x + x];
+                    regionMask[local + x] = 1;
+                    countChange(delta, region[local + x], 0.0f);
+                    voxelData[row + min.x + x] = 0.0f;
+                }
+            }
+        }
+        applyUsage(delta);
+    });
+
+    std::vector<float> rotated;
+    std::vector<uint8_t> rotatedMask;
+    VolumeTransform::Remap(region, extent, rotated, map);
+    VolumeTransform::Remap(regionMask, extent, rotatedMask, map);
+
+    // Put them back around the same center, clipped to the grid
+    const glm::ivec3 newExtent = VolumeTransform::MappedSize(extent, map);
+    const glm::ivec3 newMin = min + (extent - newExtent) / 2;
+    Parallel::For(0, newExtent.z, [&](uint32_t z) {
+        const int vz = newMin.z + z;
+        if (vz < 0 || vz >= size.z) {
+            return;
+        }
+        UsageDelta delta = newUsageDelta();
+        for (int y = 0; y < newExtent.y; ++y) {
+            const int vy = newMin.y + y;
+            if (vy < 0 || vy >= size.y) {
+                continue;
+            }
+            size_t row = (size_t(vz) * size.y + vy) * size.x;
+            size_t local = (size_t(z) * newExtent.y + y) * newExtent.x;
+            for (int x = 0; x < newExtent.x; ++x) {
+                const int vx = newMin.x + x;
+                if (vx >= 0 && vx < size.x && rotatedMask[local + x]) {
+                    countChange(delta, voxelData[row + vx], rotated[local + x]);
+                    voxelData[row + vx] = rotated[local + x];
+                }
+            }
+        }
+        applyUsage(delta);
+    });
+    selection.SelectRegion(rotatedMask, newMin, newExtent,
+                           SelectionMask::Op::Replace);
+
+    markDirty(glm::min(min, newMin), glm::max(max, newMin + newExtent));
+    return 0;
+}
+
+void VoxelManager::Remap(const PaletteRemap& remap) {
+    // Only indices the current format can hold need a table entry
+    const int count = std::min<int>(IndexCount(indexFormat), remap.size());
+    bool identity = true;
+    for (int i = 0; i < count; ++i) {
+        identity = identity && remap[i] == i;
+    }
+    if (identity) {
+        return;
+    }
+    PaletteUsage remapped(usage.size(), 0);
+    for (int i = 0; i < count; ++i) {
+        remapped[std::min<size_t>(remap[i], usage.size() - 1)] += usage[i];
+    }
+    usage = std::move(remapped);
+
+    const size_t sliceStride = size_t(width) * height;
+    std::vector<glm::ivec3> sliceMin(depth, glm::ivec3(width, height, depth));
+    std::vector<glm::ivec3> sliceMax(depth, glm::ivec3(0));
+    Parallel::For(0, depth, [&](uint32_t z) {
+        float* slice = &voxelData[z * sliceStride];
+        for (uint32_t y = 0; y < height; ++y) {
+            float* row = slice + size_t(y) * width;
+            int first = -1, last = -1;
+            for (uint32_t x = 0; x < width; ++x) {
+                const int index = std::min(paletteIndex(row[x]), count - 1);
+                if (remap[index] != index) {
+                    row[x] = VoxelIndex<uint16_t>::Decode(remap[index]);
+                    last = x;
+                    first = first < 0 ? x : first;
+                }
+            }
+            if (first >= 0) {
+                sliceMin[z] = glm::min(sliceMin[z], glm::ivec3(first, y, z));
+                sliceMax[z] =
+                    glm::max(sliceMax[z], glm::ivec3(last + 1, y + 1, z + 1));
+            }
+        }
+    });
+
+    glm::ivec3 min(width, height, depth);
+    glm::ivec3 max(0);
+    for (uint32_t z = 0; z < depth; ++z) {
+        min = glm::min(min, sliceMin[z]);
+        max = glm::max(max, sliceMax[z]);
+    }
+    markDirty(min, max);
+}
+
+int VoxelManager::Resample(const glm::vec3& scale, ResampleFilter filter) {
+    const glm::ivec3 size(width, height, depth);
+    const glm::ivec3 newSize =
+        glm::max(glm::ivec3(glm::round(glm::vec3(size) * scale)),
+                 glm::ivec3(1));
+    if (glm::any(glm::lessThanEqual(scale, glm::vec3(0.0f))) ||
+        glm::any(glm::greaterThan(newSize, glm::ivec3(2048)))) {
+        std::cerr << "Invalid resample size: " << newSize.x << "x"
+                  << newSize.y << "x" << newSize.z << std::endl;
+        return 1;
+    }
+    if (newSize == size) {
+        return 0;
+    }
+
+    // Source voxels [first, last) under every output row, column and slice
+    std::array<std::vector<int>, 3> first, last;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float ratio = float(size[axis]) / newSize[axis];
+        first[axis].resize(newSize[axis]);
+        last[axis].resize(newSize[axis]);
+        for (int i = 0; i < newSize[axis]; ++i) {
+            if (filter == ResampleFilter::Nearest) {
+                first[axis][i] =
+                    std::min(int((i + 0.5f) * ratio), size[axis] - 1);
+                last[axis][i] = first[axis][i] + 1;
+            } else {
+                first[axis][i] = std::min(int(i * ratio), size[axis] - 1);
+                last[axis][i] = std::clamp(int(std::ceil((i + 1) * ratio)),
+                                           first[axis][i] + 1, size[axis]);
+            }
+        }
+    }
+
+    // Output tiles are filled in parallel straight into the new store
+    const int tileSize = 32;
+    const glm::ivec3 tiles = (newSize + tileSize - 1) / tileSize;
+    std::vector<float> resampled(size_t(newSize.x) * newSize.y * newSize.z);
+    Parallel::For(0, tiles.x * tiles.y * tiles.z, [&](uint32_t t) {
+        const glm::ivec3 start =
+            glm::ivec3(t % tiles.x, (t / tiles.x) % tiles.y,
+                       t / (tiles.x * tiles.y)) *
+            tileSize;
+        const glm::ivec3 end = glm::min(start + tileSize, newSize);
+        std::vector<uint32_t> votes(IndexCount(indexFormat), 0);
+        std::vector<int> seen; // indices with a non-zero vote
+        for (int z = start.z; z < end.z; ++z) {
+            for (int y = start.y; y < end.y; ++y) {
+                float* out =
+                    &resampled[(size_t(z) * newSize.y + y) * newSize.x];
+                for (int x = start.x; x < end.x; ++x) {
+                    const glm::ivec3 from(first[0][x], first[1][y],
+                                          first[2][z]);
+                    const glm::ivec3 to(last[0][x], last[1][y], last[2][z]);
+                    // Upscaling and Nearest read a single voxel
+                    if (to - from == glm::ivec3(1)) {
+                        out[x] = voxelData[(size_t(from.z) * size.y + from.y) *
+                                               size.x +
+                                           from.x];
+                        continue;
+                    }
+                    for (int sz = from.z; sz < to.z; ++sz) {
+                        for (int sy = from.y; sy < to.y; ++sy) {
+                            const float* src =
+                                &voxelData[(size_t(sz) * size.y + sy) * size.x];
+                            for (int sx = from.x; sx < to.x; ++sx) {
+                                int index = std::min<int>(
+                                    paletteIndex(src[sx]), votes.size() - 1);
+                                if (votes[index]++ == 0) {
+                                    seen.push_back(index);
+                                }
+                            }
+                        }
+                    }
+                    // Ties go to solid over empty, then the lower index
+                    int best = seen[0];
+                    for (int index : seen) {
+                        bool tie = votes[index] == votes[best];
+                        bool preferred =
+                            best == 0 || (index != 0 && index < best);
+                        if (votes[index] > votes[best] || (tie && preferred)) {
+                            best = index;
+                        }
+                    }
+                    out[x] = best / 255.0f;
+                    for (int index : seen) {
+                        votes[index] = 0;
+                    }
+                    seen.clear();
+                }
+            }
+        }
+    });
+    voxelData = std::move(resampled);
+
+    width = newSize.x;
+    height = newSize.y;
+    depth = newSize.z;
+    Rebuild();
+    return 0;
 }
 
 std::optional<HitInfo> VoxelManager::Raycast(const glm::vec2& mousePos,
@@ -284,8 +642,13 @@ std::optional<HitInfo> VoxelManager::Raycast(const glm::vec2& mousePos,
             break; // Out of bounds
         }
 
+        // Follow the same page table as the shader: empty bricks are skipped
+        // and bricks streamed out of the atlas are drawn, and hit, as solid
+        BrickAtlas::PageState page =
+            atlas.getPageState(voxel / BrickAtlas::brickSize);
         size_t index = voxel.z * width * height + voxel.y * width + voxel.x;
-        if (voxelData[index] > 0.003f) {
+        if (page == BrickAtlas::NonResident ||
+            (page == BrickAtlas::Resident && voxelData[index] > 0.003f)) {
             glm::ivec3 normal(0);
             if (lastAxis == 0)
                 normal.x = -step.x;
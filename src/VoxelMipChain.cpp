@@ -0,0 +1,278 @@
+#include "VoxelMipChain.hpp"
+#include "Parallel.hpp"
+#include "glm/common.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Most frequent non-zero value, ties going to the lower palette index
+inline uint16_t Dominant(const uint16_t* values, int count) {
+    uint16_t best = 0;
+    int bestCount = 0;
+    for (int i = 0; i < count; ++i) {
+        uint16_t value = values[i];
+        if (value == 0) {
+            continue;
+        }
+        int matches = 0;
+        for (int j = 0; j < count; ++j) {
+            matches += values[j] == value;
+        }
+        if (matches > bestCount || (matches == bestCount && value < best)) {
+            best = value;
+            bestCount = matches;
+        }
+    }
+    return best;
+}
+
+inline int NextPow2(int value) {
+    int result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+VoxelMipChain::VoxelMipChain() {}
+
+VoxelMipChain::~VoxelMipChain() {}
+
+void VoxelMipChain::Init() {
+    s_lodTexture =
+        bgfx::createUniform("s_lodTexture", bgfx::UniformType::Sampler);
+}
+
+void VoxelMipChain::setIndexFormat(IndexFormat format) {
+    if (format == indexFormat) {
+        return;
+    }
+    indexFormat = format;
+    // Recreated in the new format by the next Build()
+    if (bgfx::isValid(textureHandle)) {
+        bgfx::destroy(textureHandle);
+        textureHandle.idx = bgfx::kInvalidHandle;
+    }
+}
+
+void VoxelMipChain::Destroy() {
+    if (bgfx::isValid(s_lodTexture)) {
+        bgfx::destroy(s_lodTexture);
+        s_lodTexture.idx = bgfx::kInvalidHandle;
+    }
+    if (bgfx::isValid(textureHandle)) {
+        bgfx::destroy(textureHandle);
+        textureHandle.idx = bgfx::kInvalidHandle;
+    }
+    levels.clear();
+    levelSizes.clear();
+    pendingSlices.clear();
+}
+
+void VoxelMipChain::Build(const std::vector<float>& voxels,
+                          const glm::ivec3& size) {
+    baseSize = size;
+    levelSizes.clear();
+    glm::ivec3 levelSize = size;
+    while (glm::any(glm::greaterThan(levelSize, glm::ivec3(1)))) {
+        levelSize = (levelSize + 1) / 2;
+        levelSizes.push_back(levelSize);
+    }
+    levels.resize(levelSizes.size());
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const glm::ivec3& s = levelSizes[i];
+        levels[i].assign(size_t(s.x) * s.y * s.z, 0);
+    }
+
+    for (int level = 1; level <= getLevelCount(); ++level) {
+        Downsample(voxels, level, glm::ivec3(0), levelSizes[level - 1]);
+    }
+
+    // Mip sizes of a bgfx texture round down, so pad the first level to a
+    // power of two; every mip is then at least as large as its level. The
+    // finer levels of a large grid are left out of the texture.
+    glm::ivec3 newTextureSize(0);
+    firstTextureLevel = 1;
+    for (int level = 1; level <= getLevelCount(); ++level) {
+        const glm::ivec3& first = levelSizes[level - 1];
+        newTextureSize = glm::ivec3(NextPow2(first.x), NextPow2(first.y),
+                                    NextPow2(first.z));
+        firstTextureLevel = level;
+        if (glm::all(glm::lessThanEqual(newTextureSize,
+                                        glm::ivec3(maxTextureEdge)))) {
+            break;
+        }
+    }
+    if (newTextureSize != textureSize || !bgfx::isValid(textureHandle)) {
+        if (bgfx::isValid(textureHandle)) {
+            bgfx::destroy(textureHandle);
+            textureHandle.idx = bgfx::kInvalidHandle;
+        }
+        textureSize = newTextureSize;
+        if (levels.empty()) {
+            return;
+        }
+        const bgfx::TextureFormat::Enum format =
+            DispatchIndex(indexFormat, [](auto zero) {
+                return VoxelIndex<decltype(zero)>::textureFormat;
+            });
+        textureHandle = bgfx::createTexture3D(
+            textureSize.x, textureSize.y, textureSize.z, true, format,
+            BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP, nullptr);
+    }
+    // Coarsest levels first, they are tiny and give a usable picture early
+    pendingSlices.clear();
+    for (int level = getLevelCount(); level >= firstTextureLevel; --level) {
+        QueueUpload(level, glm::ivec3(0), levelSizes[level - 1]);
+    }
+}
+
+void VoxelMipChain::Update(const std::vector<float>& voxels,
+                           const glm::ivec3& min, const glm::ivec3& max) {
+    glm::ivec3 cellMin = min;
+    glm::ivec3 cellMax = max;
+    for (int level = 1; level <= getLevelCount(); ++level) {
+        cellMin = cellMin / 2;
+        cellMax = (cellMax - 1) / 2 + 1;
+        cellMin = glm::clamp(cellMin, glm::ivec3(0), levelSizes[level - 1]);
+        cellMax = glm::clamp(cellMax, cellMin, levelSizes[level - 1]);
+        Downsample(voxels, level, cellMin, cellMax);
+        if (level >= firstTextureLevel) {
+            QueueUpload(level, cellMin, cellMax);
+        }
+    }
+}
+
+uint16_t VoxelMipChain::getCell(int level, const glm::ivec3& cell) const {
+    if (level < 1 || level > getLevelCount()) {
+        return 0;
+    }
+    const glm::ivec3& s = levelSizes[level - 1];
+    if (glm::any(glm::lessThan(cell, glm::ivec3(0))) ||
+        glm::any(glm::greaterThanEqual(cell, s))) {
+        return 0;
+    }
+    return levels[level - 1][(size_t(cell.z) * s.y + cell.y) * s.x + cell.x];
+}
+
+void VoxelMipChain::Downsample(const std::vector<float>& voxels, int level,
+                               const glm::ivec3& cellMin,
+                               const glm::ivec3& cellMax) {
+    if (glm::any(glm::greaterThanEqual(cellMin, cellMax))) {
+        return;
+    }
+    const glm::ivec3 childSize = level == 1 ? baseSize : levelSizes[level - 2];
+    const uint16_t* childLevel =
+        level == 1 ? nullptr : levels[level - 2].data();
+    const glm::ivec3& size = levelSizes[level - 1];
+    std::vector<uint16_t>& cells = levels[level - 1];
+
+    // Keep small edits on the calling thread
+    const uint32_t sliceCells = (cellMax.x - cellMin.x) * (cellMax.y - cellMin.y);
+    const uint32_t grain = std::max(1u, 32768u / std::max(1u, sliceCells));
+
+    Parallel::For(
+        cellMin.z, cellMax.z,
+        [&](uint32_t z) {
+            uint16_t children[8];
+            for (int y = cellMin.y; y < cellMax.y; ++y) {
+                for (int x = cellMin.x; x < cellMax.x; ++x) {
+                    int count = 0;
+                    for (int dz = 0; dz < 2; ++dz) {
+                        int cz = int(z) * 2 + dz;
+                        if (cz >= childSize.z) {
+                            break;
+                        }
+                        for (int dy = 0; dy < 2; ++dy) {
+                            int cy = y * 2 + dy;
+                            if (cy >= childSize.y) {
+                                break;
+                            }
+                            size_t row = (size_t(cz) * childSize.y + cy) *
+                                         childSize.x;
+                            for (int dx = 0; dx < 2; ++dx) {
+                                int cx = x * 2 + dx;
+                                if (cx >= childSize.x) {
+                                    break;
+                                }
+                                children[count++] =
+                                    childLevel ? childLevel[row + cx]
+                                               : VoxelIndex<uint16_t>::Encode(
+                                                     voxels[row + cx]);
+                            }
+                        }
+                    }
+                    cells[(size_t(z) * size.y + y) * size.x + x] =
+                        Dominant(children, count);
+                }
+            }
+        },
+        grain);
+}
+
+void VoxelMipChain::QueueUpload(int level, const glm::ivec3& cellMin,
+                                const glm::ivec3& cellMax) {
+    if (!bgfx::isValid(textureHandle) ||
+        glm::any(glm::greaterThanEqual(cellMin, cellMax))) {
+        return;
+    }
+    const int sliceSize = 32;
+    for (int z = cellMin.z; z < cellMax.z; z += sliceSize) {
+        for (int y = cellMin.y; y < cellMax.y; y += sliceSize) {
+            for (int x = cellMin.x; x < cellMax.x; x += sliceSize) {
+                glm::ivec3 min(x, y, z);
+                pendingSlices.push_back(
+                    {level, min, glm::min(min + sliceSize, cellMax)});
+            }
+        }
+    }
+}
+
+void VoxelMipChain::Flush(UploadScheduler& scheduler) {
+    const uint32_t indexBytes = indexFormat == IndexFormat::U16 ? 2 : 1;
+    while (!pendingSlices.empty()) {
+        const Slice& slice = pendingSlices.front();
+        const glm::ivec3 extent = slice.max - slice.min;
+        const bgfx::Memory* mem =
+            scheduler.Allocate(extent.x * extent.y * extent.z * indexBytes);
+        if (!mem) {
+            break;
+        }
+        DispatchIndex(indexFormat, [&](auto zero) {
+            Upload<decltype(zero)>(slice, mem);
+        });
+        pendingSlices.pop_front();
+    }
+}
+
+template <typename T>
+void VoxelMipChain::Upload(const Slice& slice, const bgfx::Memory* mem) {
+    const int level = slice.level;
+    const glm::ivec3& cellMin = slice.min;
+    const glm::ivec3& cellMax = slice.max;
+    const glm::ivec3& size = levelSizes[level - 1];
+    const glm::ivec3 extent = cellMax - cellMin;
+    // Levels keep 16-bit indices, narrowed for the 8-bit texture
+    T* dst = reinterpret_cast<T*>(mem->data);
+    for (int z = cellMin.z; z < cellMax.z; ++z) {
+        for (int y = cellMin.y; y < cellMax.y; ++y) {
+            const uint16_t* src =
+                &levels[level - 1][(size_t(z) * size.y + y) * size.x +
+                                   cellMin.x];
+            if constexpr (std::is_same_v<T, uint16_t>) {
+                std::memcpy(dst, src, extent.x * sizeof(uint16_t));
+            } else {
+                std::transform(src, src + extent.x, dst, [](uint16_t index) {
+                    return static_cast<T>(std::min<uint16_t>(index, 255));
+                });
+            }
+            dst += extent.x;
+        }
+    }
+    bgfx::updateTexture3D(textureHandle, level - firstTextureLevel, cellMin.x,
+                          cellMin.y, cellMin.z, extent.x, extent.y, extent.z,
+                          mem);
+}